@@ -0,0 +1,124 @@
+
+#include <Arduino.h>
+
+extern "C"
+{
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+}
+
+#include "logging/logging.h"
+
+#include "boot.h"
+
+using namespace creatures;
+
+static Logger l;
+
+static const BootStage *bootStages = NULL;
+static uint8_t bootStageCount = 0;
+static EventGroupHandle_t bootStagesDone = NULL;
+
+static volatile uint32_t bootStageDurations[BOOT_MAX_STAGES];
+static volatile uint32_t firstCorrectDisplayMs = 0;
+
+/**
+ * @brief Runs one stage once its dependencies are done
+ *
+ * pvParameters is the index of the stage to run.
+ */
+static portTASK_FUNCTION(bootStageTask, pvParameters)
+{
+    uint8_t stage = (uint8_t)(uintptr_t)pvParameters;
+    const BootStage &bootStage = bootStages[stage];
+
+    if (bootStage.dependsOn != 0)
+    {
+        xEventGroupWaitBits(bootStagesDone, bootStage.dependsOn, pdFALSE, pdTRUE, portMAX_DELAY);
+    }
+
+    l.debug("boot stage '%s' starting", bootStage.name);
+    unsigned long startedAt = millis();
+
+    bootStage.run();
+
+    bootStageDurations[stage] = millis() - startedAt;
+    l.info("boot stage '%s' done in %ums", bootStage.name, (unsigned int)bootStageDurations[stage]);
+
+    xEventGroupSetBits(bootStagesDone, BOOT_AFTER(stage));
+    vTaskDelete(NULL);
+}
+
+void startBootPipeline(const BootStage *stages, uint8_t count)
+{
+    if (count > BOOT_MAX_STAGES)
+    {
+        l.fatal("too many boot stages! (%d > %d)", count, BOOT_MAX_STAGES);
+        count = BOOT_MAX_STAGES;
+    }
+
+    bootStages = stages;
+    bootStageCount = count;
+    bootStagesDone = xEventGroupCreate();
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        bootStageDurations[i] = 0;
+        xTaskCreate(bootStageTask,
+                    stages[i].name,
+                    BOOT_STAGE_STACK_SIZE,
+                    (void *)(uintptr_t)i,
+                    1,
+                    NULL);
+    }
+}
+
+boolean waitForBootStages(EventBits_t stages, TickType_t timeout)
+{
+    EventBits_t done = xEventGroupWaitBits(bootStagesDone, stages, pdFALSE, pdTRUE, timeout);
+    return (done & stages) == stages;
+}
+
+uint8_t getBootStagesDone()
+{
+    EventBits_t done = xEventGroupGetBits(bootStagesDone);
+
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < bootStageCount; i++)
+    {
+        if (done & BOOT_AFTER(i))
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+uint8_t getBootStageCount()
+{
+    return bootStageCount;
+}
+
+const char *getBootStageName(uint8_t stage)
+{
+    return stage < bootStageCount ? bootStages[stage].name : "";
+}
+
+uint32_t getBootStageDuration(uint8_t stage)
+{
+    return stage < bootStageCount ? bootStageDurations[stage] : 0;
+}
+
+void markFirstCorrectDisplay()
+{
+    if (firstCorrectDisplayMs == 0)
+    {
+        firstCorrectDisplayMs = millis();
+    }
+}
+
+uint32_t getFirstCorrectDisplayMs()
+{
+    return firstCorrectDisplayMs;
+}
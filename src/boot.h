@@ -0,0 +1,79 @@
+
+#pragma once
+
+#include <Arduino.h>
+
+extern "C"
+{
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+}
+
+#include "logging/logging.h"
+
+/*
+    Boot, as a little dependency graph
+
+    Each stage says which other stages need to be done before it can run. Every
+    stage gets its own task, which waits for its dependencies and then runs, so
+    stages that don't depend on each other happen at the same time.
+*/
+
+// Use in BootStage.dependsOn to wait for another stage (by its index)
+#define BOOT_AFTER(stage) ((EventBits_t)1 << (stage))
+
+// FreeRTOS event groups give us 24 bits to play with
+#define BOOT_MAX_STAGES 24
+
+// How much stack each stage's task gets
+#define BOOT_STAGE_STACK_SIZE 8192
+
+struct BootStage
+{
+    const char *name;
+    EventBits_t dependsOn;
+    void (*run)();
+};
+
+/**
+ * @brief Starts all of the boot stages
+ *
+ * @param stages The stages. This needs to stick around until boot is done.
+ * @param count How many stages there are
+ */
+void startBootPipeline(const BootStage *stages, uint8_t count);
+
+/**
+ * @brief Waits for a set of stages to finish
+ *
+ * @param stages Which stages to wait for, from BOOT_AFTER()
+ * @param timeout How long to wait
+ * @return true if all of them are done
+ */
+boolean waitForBootStages(EventBits_t stages, TickType_t timeout);
+
+/**
+ * @brief How many of the stages are done so far
+ */
+uint8_t getBootStagesDone();
+
+uint8_t getBootStageCount();
+const char *getBootStageName(uint8_t stage);
+
+/**
+ * @brief How long a stage took to run, in ms (0 if it hasn't finished)
+ */
+uint32_t getBootStageDuration(uint8_t stage);
+
+/**
+ * @brief Notes that the display is showing the real time for the first time
+ *
+ * Only the first call counts.
+ */
+void markFirstCorrectDisplay();
+
+/**
+ * @brief How long after power on the display first showed the real time, in ms (0 if it hasn't yet)
+ */
+uint32_t getFirstCorrectDisplayMs();
@@ -0,0 +1,151 @@
+
+#include <time.h>
+
+#include "civil_time.h"
+
+CivilTimeZoneStats civilTimeZoneStats;
+
+struct DstTransitions
+{
+    int64_t start;
+    int64_t end;
+};
+
+#define DST_YEAR(year) {dstStartUtc(year), dstEndUtc(year)}
+
+#define DST_DECADE(decade)                                                          \
+    DST_YEAR(decade + 0), DST_YEAR(decade + 1), DST_YEAR(decade + 2),               \
+        DST_YEAR(decade + 3), DST_YEAR(decade + 4), DST_YEAR(decade + 5),           \
+        DST_YEAR(decade + 6), DST_YEAR(decade + 7), DST_YEAR(decade + 8),           \
+        DST_YEAR(decade + 9)
+
+/*
+    Every transition from CIVIL_TIME_FIRST_YEAR to CIVIL_TIME_LAST_YEAR. It's all
+    constexpr, so the compiler works these out and they just sit in flash.
+*/
+static const DstTransitions dstTable[CIVIL_TIME_LAST_YEAR - CIVIL_TIME_FIRST_YEAR + 1] = {
+    DST_DECADE(2020),
+    DST_DECADE(2030),
+    DST_DECADE(2040),
+    DST_DECADE(2050),
+    DST_DECADE(2060),
+    DST_DECADE(2070),
+    DST_DECADE(2080),
+    DST_DECADE(2090),
+};
+
+// The average length of a year, in seconds
+#define SECONDS_PER_YEAR 31556952L
+
+bool isDst(int64_t epoch)
+{
+#if CIVIL_TIME_US_DST == 1
+    /*
+        This can be off by a day or so right around New Year's, but DST is off then no
+        matter which year we look at, so it doesn't matter.
+    */
+    int32_t year = 1970 + (int32_t)(epoch / SECONDS_PER_YEAR);
+
+    if (year >= CIVIL_TIME_FIRST_YEAR && year <= CIVIL_TIME_LAST_YEAR)
+    {
+        const DstTransitions &transitions = dstTable[year - CIVIL_TIME_FIRST_YEAR];
+        return epoch >= transitions.start && epoch < transitions.end;
+    }
+
+    return epoch >= dstStartUtc(year) && epoch < dstEndUtc(year);
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief The local time from our own rules
+ */
+static CivilTime fastCivilTime(int64_t epoch)
+{
+    CivilTime civil;
+    civil.dst = isDst(epoch);
+
+    int64_t local = epoch + CIVIL_TIME_UTC_OFFSET + (civil.dst ? 3600 : 0);
+    uint32_t secondOfDay = (uint32_t)(local % SECONDS_PER_DAY);
+
+    civil.hour = secondOfDay / 3600;
+    civil.minute = (secondOfDay / 60) % 60;
+    civil.second = secondOfDay % 60;
+
+    return civil;
+}
+
+/**
+ * @brief The local time the slow way, from libc and TZ
+ */
+static CivilTime libcCivilTime(int64_t epoch)
+{
+    time_t seconds = (time_t)epoch;
+    struct tm tm;
+    localtime_r(&seconds, &tm);
+
+    CivilTime civil;
+    civil.hour = tm.tm_hour;
+    civil.minute = tm.tm_min;
+    civil.second = tm.tm_sec;
+    civil.dst = tm.tm_isdst > 0;
+    return civil;
+}
+
+CivilTime toCivilTime(int64_t epoch)
+{
+    if (civilTimeZoneStats.checked && !civilTimeZoneStats.agrees)
+    {
+        return libcCivilTime(epoch);
+    }
+
+    return fastCivilTime(epoch);
+}
+
+/**
+ * @brief Tries one moment both ways, and counts it if they're different
+ */
+static void checkCivilTimeAt(int64_t epoch)
+{
+    CivilTime fast = fastCivilTime(epoch);
+    CivilTime libc = libcCivilTime(epoch);
+
+    if (fast.hour != libc.hour || fast.minute != libc.minute || fast.second != libc.second || fast.dst != libc.dst)
+    {
+        if (civilTimeZoneStats.mismatches == 0)
+        {
+            civilTimeZoneStats.firstMismatch = epoch;
+        }
+        civilTimeZoneStats.mismatches++;
+    }
+}
+
+bool checkCivilTimeZone(int64_t now)
+{
+    civilTimeZoneStats.mismatches = 0;
+    civilTimeZoneStats.firstMismatch = 0;
+
+    checkCivilTimeAt(now);
+
+    // Right around the changes is where a different rule would show up
+    int32_t year = 1970 + (int32_t)(now / SECONDS_PER_YEAR);
+    for (int32_t y = year; y <= year + 1; y++)
+    {
+        const int64_t changes[2] = {dstStartUtc(y), dstEndUtc(y)};
+        for (uint8_t i = 0; i < 2; i++)
+        {
+            checkCivilTimeAt(changes[i] - 1);
+            checkCivilTimeAt(changes[i]);
+            checkCivilTimeAt(changes[i] + 1);
+        }
+
+        // And the middle of summer and winter, for a zone with a different offset
+        checkCivilTimeAt((int64_t)daysFromCivil(y, 1, 15) * SECONDS_PER_DAY);
+        checkCivilTimeAt((int64_t)daysFromCivil(y, 7, 15) * SECONDS_PER_DAY);
+    }
+
+    civilTimeZoneStats.checked = true;
+    civilTimeZoneStats.agrees = civilTimeZoneStats.mismatches == 0;
+    return civilTimeZoneStats.agrees;
+}
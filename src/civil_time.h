@@ -0,0 +1,149 @@
+
+#pragma once
+
+#include <stdint.h>
+
+/*
+    Epoch seconds to the time on the wall, without libc
+
+    localtime_r() has to find the timezone rules, work out the date, the day of
+    the week, the day of the year, and so on, just for us to throw most of it
+    away. All the clock needs is the hour, minute and second, so this does just
+    that with a few integer divides.
+
+    Daylight saving time comes from a table of the US transitions, worked out at
+    compile time (see civil_time.cpp). Like clock_face.h, this doesn't touch any
+    hardware (or even Arduino.h) so it can be built and run anywhere.
+
+    The zone here is set at compile time, but the TZ that libc uses comes from
+    the time library. checkCivilTimeZone() makes sure they agree once TZ is set,
+    and if they don't, toCivilTime() goes back to asking localtime_r().
+*/
+
+// Standard time's offset from UTC, in seconds. Defaults to Pacific time.
+#ifndef CIVIL_TIME_UTC_OFFSET
+#define CIVIL_TIME_UTC_OFFSET (-8 * 3600)
+#endif
+
+// Does the zone follow US daylight saving time? (Second Sunday in March to the first Sunday in November)
+#ifndef CIVIL_TIME_US_DST
+#define CIVIL_TIME_US_DST 1
+#endif
+
+// The years in the transition table. Anything outside of it is worked out the slow way.
+#define CIVIL_TIME_FIRST_YEAR 2020
+#define CIVIL_TIME_LAST_YEAR 2099
+
+#define SECONDS_PER_DAY 86400L
+
+struct CivilTime
+{
+    uint8_t hour;   // 0-23
+    uint8_t minute; // 0-59
+    uint8_t second; // 0-59
+    bool dst;       // Is daylight saving time on?
+};
+
+/*
+    Date math, all constexpr so the DST table can be built by the compiler. C++11
+    only lets a constexpr function be one return statement, so it's split up into
+    a few small ones. This is Howard Hinnant's days_from_civil(), for years >= 0.
+*/
+
+constexpr int32_t civilMarchYear(int32_t year, uint32_t month)
+{
+    return year - (month <= 2 ? 1 : 0);
+}
+
+constexpr uint32_t civilMarchDayOfYear(uint32_t month, uint32_t day)
+{
+    return (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+}
+
+constexpr uint32_t civilDayOfEra(uint32_t yearOfEra, uint32_t dayOfYear)
+{
+    return yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+}
+
+/**
+ * @brief Days since 1970-01-01 for a date
+ */
+constexpr int32_t daysFromCivil(int32_t year, uint32_t month, uint32_t day)
+{
+    return (civilMarchYear(year, month) / 400) * 146097 +
+           (int32_t)civilDayOfEra(civilMarchYear(year, month) % 400, civilMarchDayOfYear(month, day)) -
+           719468;
+}
+
+/**
+ * @brief Day of the week (0 is Sunday) for days since 1970-01-01, which was a Thursday
+ */
+constexpr uint32_t weekdayFromDays(int32_t days)
+{
+    return (uint32_t)(days + 4) % 7;
+}
+
+/**
+ * @brief Days since 1970-01-01 of the nth Sunday of a month
+ */
+constexpr int32_t nthSunday(int32_t year, uint32_t month, uint32_t n)
+{
+    return daysFromCivil(year, month, 1) + (7 - weekdayFromDays(daysFromCivil(year, month, 1))) % 7 + 7 * (n - 1);
+}
+
+/**
+ * @brief When DST starts (2am standard time on the second Sunday in March), in UTC
+ */
+constexpr int64_t dstStartUtc(int32_t year)
+{
+    return (int64_t)nthSunday(year, 3, 2) * SECONDS_PER_DAY + 2 * 3600 - CIVIL_TIME_UTC_OFFSET;
+}
+
+/**
+ * @brief When DST ends (2am daylight time on the first Sunday in November), in UTC
+ */
+constexpr int64_t dstEndUtc(int32_t year)
+{
+    return (int64_t)nthSunday(year, 11, 1) * SECONDS_PER_DAY + 2 * 3600 - (CIVIL_TIME_UTC_OFFSET + 3600);
+}
+
+/**
+ * @brief Whether our zone rules match libc's
+ */
+struct CivilTimeZoneStats
+{
+    bool checked;          // Has checkCivilTimeZone() run?
+    bool agrees;           // Did everything it tried match localtime_r()?
+    uint32_t mismatches;   // How many of the times it tried didn't
+    int64_t firstMismatch; // The first one that didn't, in epoch seconds
+};
+
+extern CivilTimeZoneStats civilTimeZoneStats;
+
+/**
+ * @brief Is daylight saving time on at a moment?
+ *
+ * @param epoch Seconds since the epoch, in UTC
+ */
+bool isDst(int64_t epoch);
+
+/**
+ * @brief Turns a time into the local hour, minute and second
+ *
+ * @param epoch Seconds since the epoch, in UTC (after 1970-01-02)
+ * @return CivilTime the local time
+ */
+CivilTime toCivilTime(int64_t epoch);
+
+/**
+ * @brief Checks our zone against the TZ libc is using
+ *
+ * Tries the time right now and a second either side of every DST change this
+ * year and next, with both toCivilTime() and localtime_r(). If any of them
+ * disagree, toCivilTime() uses localtime_r() from then on. Call it after TZ
+ * is set.
+ *
+ * @param now Seconds since the epoch, in UTC
+ * @return true if they agree
+ */
+bool checkCivilTimeZone(int64_t now);
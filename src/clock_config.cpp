@@ -0,0 +1,52 @@
+
+#include <Arduino.h>
+
+#include <atomic>
+
+#include "clock_config.h"
+
+static ClockConfig currentConfig = {
+    1,    // screenBrightness
+    true, // blinkColon
+    true, // displayOn
+    10,   // pixelBrightness
+    242,  // pixelSaturation
+    0,     // ringEffect (RING_EFFECT_WIPE)
+    false, // ringDither
+    false  // ringFleetSync
+};
+
+// Odd while a write is in progress. The generation is half of this.
+static std::atomic<uint32_t> configSequence(0);
+
+uint32_t getClockConfig(ClockConfig &config)
+{
+    uint32_t before;
+    uint32_t after;
+    do
+    {
+        before = configSequence.load(std::memory_order_acquire);
+        config = currentConfig;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = configSequence.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+
+    return before >> 1;
+}
+
+uint32_t getClockConfigGeneration()
+{
+    return configSequence.load(std::memory_order_acquire) >> 1;
+}
+
+void setClockConfig(const ClockConfig &config)
+{
+    uint32_t sequence = configSequence.load(std::memory_order_relaxed);
+
+    configSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    currentConfig = config;
+
+    configSequence.store(sequence + 2, std::memory_order_release);
+}
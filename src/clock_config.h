@@ -0,0 +1,56 @@
+
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @brief Everything about the clock that can be configured
+ */
+struct ClockConfig
+{
+    uint8_t screenBrightness; // 0 - 15, 15 is brightest
+    boolean blinkColon;       // Should the colon blink?
+    boolean displayOn;        // Should the display be on? (So I can turn it off while we're watching movies!)
+    uint8_t pixelBrightness;  // 0 - 254
+    uint8_t pixelSaturation;  // 0 - 254
+    uint8_t ringEffect;       // Which RingEffect is on the ring
+    boolean ringDither;       // Run the ring at a high frame rate with temporal dithering?
+    boolean ringFleetSync;    // Follow the fleet's ring sync messages, so every clock in the room matches?
+};
+
+/*
+    The config is written by the message reader on core 0 and read by the renderers
+    on both cores. Rather than reading globals one at a time (and maybe seeing half
+    of an update), readers take a whole copy at once.
+
+    It's a seqlock: the writer bumps a sequence number before and after it changes
+    anything, and a reader retries if the number was odd (a write in progress) or
+    changed while it was copying. Nobody ever blocks, and readers never see a mix
+    of old and new settings.
+
+    The generation goes up by one on every write, so a reader can tell if anything
+    changed since the last time it looked without comparing every field.
+*/
+
+/**
+ * @brief Takes a consistent copy of the current config
+ *
+ * @param config Where to put the copy
+ * @return uint32_t The generation of the copy
+ */
+uint32_t getClockConfig(ClockConfig &config);
+
+/**
+ * @brief The generation of the current config
+ */
+uint32_t getClockConfigGeneration();
+
+/**
+ * @brief Replaces the current config
+ *
+ * There can only be one writer at a time. In practice that's setup() (before
+ * anything else is running) and then the message reader task.
+ *
+ * @param config The new config
+ */
+void setClockConfig(const ClockConfig &config);
@@ -0,0 +1,24 @@
+
+#include "clock_face.h"
+
+ClockFace makeClockFace(int hour, int minute, int second, bool blinkColon)
+{
+    ClockFace face;
+
+    // I like the time in 12 hour time, so 0 -> 12, 13 -> 1, and so on
+    bool isAm = hour < 12;
+    int hour12 = (hour + 11) % 12 + 1;
+
+    face.time = hour12 * 100 + minute;
+
+    // Which light for AM/PM?
+    face.colonSegments = isAm ? CLOCK_FACE_AM : CLOCK_FACE_PM;
+
+    // Flip the colon every second
+    if (!blinkColon || (second % 2) == 0)
+    {
+        face.colonSegments |= CLOCK_FACE_COLON;
+    }
+
+    return face;
+}
@@ -0,0 +1,33 @@
+
+#pragma once
+
+#include <stdint.h>
+
+/*
+    What goes on the 7-segment display for a given time
+
+    This is kept apart from showTimeTask and doesn't touch any hardware (or even
+    Arduino.h), so the logic can be built and run anywhere.
+*/
+
+// The raw segments at position 2 (the colons and the AM/PM dots)
+#define CLOCK_FACE_COLON 0x02
+#define CLOCK_FACE_AM 0x04
+#define CLOCK_FACE_PM 0x08
+
+struct ClockFace
+{
+    int time;              // The time as HHMM, in 12 hour time
+    uint8_t colonSegments; // What to write to position 2
+};
+
+/**
+ * @brief Works out what the display should show
+ *
+ * @param hour The hour (0-23)
+ * @param minute The minute (0-59)
+ * @param second The second (0-59), used to blink the colon
+ * @param blinkColon Should the colon blink?
+ * @return ClockFace what to show
+ */
+ClockFace makeClockFace(int hour, int minute, int second, bool blinkColon);
@@ -0,0 +1,215 @@
+
+#pragma once
+
+#include <Arduino.h>
+#include <Adafruit_NeoPixel.h>
+
+/*
+    Fixed-point HSV -> RGB for the LED ring
+
+    Adafruit's ColorHSV() applies the brightness before anything else, so at the
+    low brightness we run the ring at there are only a handful of levels left to
+    fade through. These do the colour math at full scale, run it through a 16 bit
+    gamma table, and only then scale it down to the requested brightness.
+
+    Everything is integer math, and the renderers are templated on the pixel count
+    and the NeoPixel type (NEO_GRB, etc) so the loops and byte offsets are fixed
+    at compile time. They write straight into a NeoPixel-style byte buffer.
+*/
+
+// The gamma curve, 8 bit in -> 16 bit linear out
+extern const uint16_t gammaTable[256];
+
+/**
+ * @brief Turns a hue and saturation into gamma-corrected 16 bit channels
+ *
+ * This is always computed at full value. Use scaleChannel() to bring it
+ * down to the brightness you want.
+ *
+ * @param hue The hue (0-65535, same as Adafruit_NeoPixel::ColorHSV())
+ * @param saturation The saturation (0-255)
+ * @param r Red, 0-65535
+ * @param g Green, 0-65535
+ * @param b Blue, 0-65535
+ */
+inline void hsvToRgb16(uint16_t hue, uint8_t saturation, uint16_t &r, uint16_t &g, uint16_t &b)
+{
+    uint8_t r8, g8, b8;
+
+    // Same six sextants as ColorHSV(), 1530 steps around the wheel
+    uint16_t wheel = ((uint32_t)hue * 1530L + 32768) / 65536;
+
+    if (wheel < 510)
+    {
+        b8 = 0;
+        if (wheel < 255)
+        {
+            r8 = 255;
+            g8 = wheel;
+        }
+        else
+        {
+            r8 = 510 - wheel;
+            g8 = 255;
+        }
+    }
+    else if (wheel < 1020)
+    {
+        r8 = 0;
+        if (wheel < 765)
+        {
+            g8 = 255;
+            b8 = wheel - 510;
+        }
+        else
+        {
+            g8 = 1020 - wheel;
+            b8 = 255;
+        }
+    }
+    else if (wheel < 1530)
+    {
+        g8 = 0;
+        if (wheel < 1275)
+        {
+            r8 = wheel - 1020;
+            b8 = 255;
+        }
+        else
+        {
+            r8 = 255;
+            b8 = 1530 - wheel;
+        }
+    }
+    else
+    {
+        r8 = 255;
+        g8 = 0;
+        b8 = 0;
+    }
+
+    // Pull everything towards white as the saturation drops
+    uint16_t s1 = 1 + saturation;
+    uint8_t s2 = 255 - saturation;
+
+    r = gammaTable[((r8 * s1) >> 8) + s2];
+    g = gammaTable[((g8 * s1) >> 8) + s2];
+    b = gammaTable[((b8 * s1) >> 8) + s2];
+}
+
+/**
+ * @brief Scales a 16 bit linear channel down to an 8 bit one at a brightness
+ *
+ * @param channel The linear channel (0-65535)
+ * @param brightness The brightness (0-255)
+ * @return uint8_t What to send to the LED
+ */
+inline uint8_t scaleChannel(uint16_t channel, uint8_t brightness)
+{
+    return ((uint32_t)channel * (brightness + 1)) >> 16;
+}
+
+/**
+ * @brief Scales a 16 bit linear channel down to 8.8 fixed point at a brightness
+ *
+ * The top byte is the same thing scaleChannel() gives you, and the bottom byte
+ * is what got rounded off. Temporal dithering uses that to show levels in
+ * between the 8 bit ones.
+ *
+ * @param channel The linear channel (0-65535)
+ * @param brightness The brightness (0-255)
+ * @return uint16_t The level, in 1/256ths of an LED step
+ */
+inline uint16_t scaleChannel16(uint16_t channel, uint8_t brightness)
+{
+    return ((uint32_t)channel * (brightness + 1)) >> 8;
+}
+
+/**
+ * @brief Renders a hue for each pixel into a NeoPixel byte buffer
+ *
+ * @tparam PIXELS How many pixels to render
+ * @tparam TYPE The NeoPixel type flags (NEO_GRB + NEO_KHZ800, etc)
+ * @param pixels The byte buffer to write (3 * PIXELS bytes)
+ * @param hues One hue per pixel
+ * @param saturation Saturation for every pixel
+ * @param brightness Brightness for every pixel
+ */
+template <uint16_t PIXELS, uint16_t TYPE>
+inline void renderHsv(uint8_t *pixels, const uint16_t *hues, uint8_t saturation, uint8_t brightness)
+{
+    // Where each colour lives in a pixel, the same way Adafruit_NeoPixel works it out
+    const uint8_t rOffset = (TYPE >> 4) & 0x03;
+    const uint8_t gOffset = (TYPE >> 2) & 0x03;
+    const uint8_t bOffset = TYPE & 0x03;
+
+#pragma GCC unroll 4
+    for (uint16_t i = 0; i < PIXELS; i++)
+    {
+        uint16_t r, g, b;
+        hsvToRgb16(hues[i], saturation, r, g, b);
+
+        uint8_t *pixel = pixels + (i * 3);
+        pixel[rOffset] = scaleChannel(r, brightness);
+        pixel[gOffset] = scaleChannel(g, brightness);
+        pixel[bOffset] = scaleChannel(b, brightness);
+    }
+}
+
+/**
+ * @brief Renders a hue for each pixel as 8.8 fixed point levels
+ *
+ * Same as renderHsv(), but keeps the fraction (see scaleChannel16()). The levels
+ * are in the strip's byte order, three per pixel.
+ *
+ * @tparam PIXELS How many pixels to render
+ * @tparam TYPE The NeoPixel type flags (NEO_GRB + NEO_KHZ800, etc)
+ * @param levels Where to put the levels (3 * PIXELS of them)
+ * @param hues One hue per pixel
+ * @param saturation Saturation for every pixel
+ * @param brightness Brightness for every pixel
+ */
+template <uint16_t PIXELS, uint16_t TYPE>
+inline void renderHsvLevels(uint16_t *levels, const uint16_t *hues, uint8_t saturation, uint8_t brightness)
+{
+    const uint8_t rOffset = (TYPE >> 4) & 0x03;
+    const uint8_t gOffset = (TYPE >> 2) & 0x03;
+    const uint8_t bOffset = TYPE & 0x03;
+
+#pragma GCC unroll 4
+    for (uint16_t i = 0; i < PIXELS; i++)
+    {
+        uint16_t r, g, b;
+        hsvToRgb16(hues[i], saturation, r, g, b);
+
+        uint16_t *level = levels + (i * 3);
+        level[rOffset] = scaleChannel16(r, brightness);
+        level[gOffset] = scaleChannel16(g, brightness);
+        level[bOffset] = scaleChannel16(b, brightness);
+    }
+}
+
+/**
+ * @brief Fills a NeoPixel byte buffer with one hue
+ *
+ * The colour is only worked out once and then copied to every pixel.
+ *
+ * @tparam PIXELS How many pixels to fill
+ * @tparam TYPE The NeoPixel type flags (NEO_GRB + NEO_KHZ800, etc)
+ * @param pixels The byte buffer to write (3 * PIXELS bytes)
+ * @param hue The hue to fill with
+ * @param saturation The saturation to use
+ * @param brightness The brightness to use
+ */
+template <uint16_t PIXELS, uint16_t TYPE>
+inline void fillHsv(uint8_t *pixels, uint16_t hue, uint8_t saturation, uint8_t brightness)
+{
+    uint8_t colour[3];
+    renderHsv<1, TYPE>(colour, &hue, saturation, brightness);
+
+#pragma GCC unroll 4
+    for (uint16_t i = 0; i < PIXELS; i++)
+    {
+        memcpy(pixels + (i * 3), colour, 3);
+    }
+}
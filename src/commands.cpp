@@ -0,0 +1,60 @@
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#include "esp_sntp.h"
+
+#include "logging/logging.h"
+
+#include "commands.h"
+#include "message_router.h"
+#include "seconds_ring.h"
+#include "show_time.h"
+
+using namespace creatures;
+
+static Logger l;
+
+/**
+ * @brief Is the payload exactly this command?
+ *
+ * The hash already matched, this makes sure it wasn't a collision.
+ */
+static boolean isCommand(const char *payload, size_t length, const char *command)
+{
+    return strlen(command) == length && strncmp(payload, command, length) == 0;
+}
+
+void handleCommand(const char *payload, size_t length)
+{
+    l.info("Got a command from MQTT: %.*s", (int)length, payload);
+
+    switch (boundedTopicHash(payload, length))
+    {
+    case topicHash("restartRing"):
+        if (isCommand(payload, length, "restartRing"))
+        {
+            restartSecondRing();
+            return;
+        }
+        break;
+
+    case topicHash("showIp"):
+        if (isCommand(payload, length, "showIp"))
+        {
+            showIpAddress(WiFi.localIP());
+            return;
+        }
+        break;
+
+    case topicHash("resyncTime"):
+        if (isCommand(payload, length, "resyncTime"))
+        {
+            sntp_restart();
+            return;
+        }
+        break;
+    }
+
+    l.warning("unknown command: %.*s", (int)length, payload);
+}
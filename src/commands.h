@@ -0,0 +1,20 @@
+
+#pragma once
+
+#include <Arduino.h>
+
+/*
+    Things that can be done to the clock by sending their name to the cmd topic
+
+        restartRing - start the second ring's minute over from right now
+        showIp      - show our IP address on the display, one number at a time
+        resyncTime  - ask SNTP for the time right now instead of waiting
+*/
+
+/**
+ * @brief Handles a message on the cmd topic
+ *
+ * @param payload The name of the command (doesn't need to be null terminated)
+ * @param length How long the payload is
+ */
+void handleCommand(const char *payload, size_t length);
@@ -1,8 +1,14 @@
 
 #include <Arduino.h>
-#include <ArduinoJson.h>
 
 #include "logging/logging.h"
+#include "log_macros.h"
+
+#include "clock_config.h"
+#include "config_parser.h"
+#include "config_store.h"
+#include "frame_stats.h"
+#include "ring_effects.h"
 
 using namespace creatures;
 
@@ -17,192 +23,131 @@ using namespace creatures;
 #define LED_RING_SATURATION_MIN 0
 #define LED_RING_SATURATION_MAX 254
 
-// Defined in main.cpp
-extern uint8_t gScreenBrightness;
-extern boolean gBlinkColon;
-extern boolean gDisplayOn;
-extern uint8_t gPixelRingSaturation;
-extern uint8_t gPixelBrightness;
 
 static Logger l;
 
+/*
+    Everything that can be set from the config topic
+*/
+static const ConfigField configSchema[] = {
+    {"brightness", CONFIG_FIELD_UINT8, BRIGHTNESS_MIN, BRIGHTNESS_MAX, offsetof(ClockConfig, screenBrightness), NULL},
+    {"blinkingColon", CONFIG_FIELD_ON_OFF, 0, 1, offsetof(ClockConfig, blinkColon), NULL},
+    {"displayOn", CONFIG_FIELD_ON_OFF, 0, 1, offsetof(ClockConfig, displayOn), NULL},
+    {"ledRingBrightness", CONFIG_FIELD_UINT8, LED_RING_BRIGHTNESS_MIN, LED_RING_BRIGHTNESS_MAX, offsetof(ClockConfig, pixelBrightness), NULL},
+    {"ledRingSaturation", CONFIG_FIELD_UINT8, LED_RING_SATURATION_MIN, LED_RING_SATURATION_MAX, offsetof(ClockConfig, pixelSaturation), NULL},
+    {"ledRingEffect", CONFIG_FIELD_CHOICE, 0, RING_EFFECT_COUNT - 1, offsetof(ClockConfig, ringEffect), ringEffectNames},
+    {"ledRingDither", CONFIG_FIELD_ON_OFF, 0, 1, offsetof(ClockConfig, ringDither), NULL},
+    {"ledRingFleetSync", CONFIG_FIELD_ON_OFF, 0, 1, offsetof(ClockConfig, ringFleetSync), NULL},
+};
+
+#define CONFIG_FIELD_COUNT (sizeof(configSchema) / sizeof(configSchema[0]))
+
+ConfigFormatStats configFormatStats[CONFIG_FORMAT_COUNT];
+
 /**
  * @brief Update the configuration of the device from MQTT
  *
- * The config isn't persisted anywhere on the MCU. It's config it's kept in a retained MQTT topic
- * which will be read when it boots.
+ * The config of record is kept in a retained MQTT topic which will be read when it boots. Once
+ * anything changes, a copy is saved to NVS (see config_store.h) so the next boot doesn't have to
+ * wait for MQTT to get it right.
+ *
+ * The payload is parsed in place against configSchema, and nothing is applied unless
+ * the whole thing parses. All of the fields are applied to a copy of the config, which
+ * is then published in one go so the renderers never see half of an update.
+ *
+ * It can be JSON or MessagePack. The first byte tells us which.
  *
- * @param incomingJson a String with JSON from MQTT
+ * @param payload the config from MQTT (doesn't need to be null terminated)
+ * @param length how long the payload is (or could be, for MessagePack)
+ * @return true if anything actually changed
  */
-void updateConfig(String incomingJson)
+boolean updateConfig(const char *payload, size_t length)
 {
-    l.debug("Incoming config message: %s", incomingJson.c_str());
+    ConfigFormat format = detectConfigFormat(payload, length);
+    ConfigValue values[CONFIG_FIELD_COUNT];
 
-    // Let's put this on the stack so it goes poof when we leave
-    StaticJsonDocument<512> json;
-
-    DeserializationError error = deserializeJson(json, incomingJson);
-
-    if (error)
+    uint32_t parseStart = FrameStats::startTimer();
+    boolean parsed;
+    size_t used = length;
+    if (format == CONFIG_FORMAT_MSGPACK)
     {
-        l.error("Unable to deserialize config from MQTT: %s", error.c_str());
+        LOG_DEBUG(l, "Incoming MessagePack config message");
+        parsed = parseMsgPackConfig(payload, length, configSchema, CONFIG_FIELD_COUNT, values, used);
     }
     else
     {
-        l.debug("decode was good!");
-
-        /*
-            Brightness
-        */
-
-        String brightness = json["brightness"];
-        l.debug("'brightness' was %s", brightness.c_str());
+        LOG_DEBUG(l, "Incoming config message: %.*s", (int)length, payload);
+        parsed = parseJsonConfig(payload, length, configSchema, CONFIG_FIELD_COUNT, values);
+    }
+    uint32_t parseUs = FrameStats::cyclesSince(parseStart) / ESP.getCpuFreqMHz();
 
-        // Don't look at an empty string
-        if (brightness != NULL && !brightness.isEmpty() && !brightness.equals("null"))
-        {
+    ConfigFormatStats &stats = configFormatStats[format];
+    stats.messages++;
+    stats.lastBytes = used;
+    stats.lastParseUs = parseUs;
+    if (parseUs > stats.maxParseUs)
+    {
+        stats.maxParseUs = parseUs;
+    }
 
-            uint8_t decodedBrightness = atoi(brightness.c_str());
-
-            // Make sure that the brightness is in range
-            if (decodedBrightness >= BRIGHTNESS_MIN && decodedBrightness <= BRIGHTNESS_MAX)
-            {
-                l.debug("setting brightness to %d", decodedBrightness);
-                gScreenBrightness = decodedBrightness;
-            }
-            else
-            {
-                l.error("Got an out-of-range brightness request: %d", decodedBrightness);
-            }
-        }
-        else
-        {
-            l.warning("'brightness' was missing from the config");
-        }
+    if (!parsed)
+    {
+        l.error("Unable to deserialize config from MQTT");
+        return false;
+    }
 
-        /*
-            Blinking Colon
+    LOG_DEBUG(l, "decode was good!");
 
-            Parameter: blinkingColon
+    ClockConfig config;
+    getClockConfig(config);
+    uint8_t *configBytes = (uint8_t *)&config;
 
-        */
+    boolean changed = false;
 
-        String blinkingColon = json["blinkingColon"];
-        l.debug("'blinkingColon' was %s", blinkingColon);
+    for (uint8_t i = 0; i < CONFIG_FIELD_COUNT; i++)
+    {
+        const ConfigField &field = configSchema[i];
+        const ConfigValue &value = values[i];
 
-        // Don't do a dumb thing :)
-        if (blinkingColon != NULL && !blinkingColon.isEmpty() && !blinkingColon.equals("null"))
+        // Don't make an adjustment on a missing value (partial configs are normal)
+        if (!value.present)
         {
-            const char *blinkValue = blinkingColon.c_str();
-
-            // Make sure that the brightness is in range
-            if (strncmp("on", blinkValue, strlen(blinkValue)) == 0)
-            {
-                gBlinkColon = true;
-            }
-            else
-            {
-                gBlinkColon = false;
-            }
-            l.info("set 'gBlinkColon' to %d", gBlinkColon);
+            LOG_DEBUG(l, "'%s' was missing from the config", field.key);
+            continue;
         }
-        else
-        {
-            l.warning("'blinkingColon' was missing from the config");
-        }
-
-        /*
 
-            Display On?
-
-            Parameter: displayOn
-
-        */
-
-        String displayOn = json["displayOn"];
-        l.debug("'displayOn' was %s", displayOn);
-
-        // Don't make an adjustment on an missing value
-        if (displayOn != NULL && !displayOn.isEmpty() && !displayOn.equals("null"))
-        {
-            const char *displayOnValue = displayOn.c_str();
-
-            // Make sure that the brightness is in range
-            if (strncmp("on", displayOnValue, strlen(displayOnValue)) == 0)
-            {
-                gDisplayOn = true;
-            }
-            else
-            {
-                gDisplayOn = false;
-            }
-            l.info("set 'gDisplayOn' to %d", gDisplayOn);
-        }
-        else
+        // Make sure that it's in range
+        if (!value.valid || value.value < field.min || value.value > field.max)
         {
-            l.warning("'displayOn' was missing in the config object, not changing anything");
+            l.error("Got an out-of-range '%s' request: %d", field.key, value.value);
+            continue;
         }
 
-        /*
-            LED Ring Brightness
-
-            Parameter: ledRingBrightness
-        */
-
-        String ledRingBrightness = json["ledRingBrightness"];
-        l.debug("'ledRingBrightness' was %s", brightness.c_str());
-
-        // Don't look at an empty string
-        if (ledRingBrightness != NULL && !ledRingBrightness.isEmpty() && !ledRingBrightness.equals("null"))
-        {
-
-            uint8_t decodedLedRingBrightness = atoi(ledRingBrightness.c_str());
-
-            // Make sure that the brightness is in range
-            if (decodedLedRingBrightness >= LED_RING_BRIGHTNESS_MIN && decodedLedRingBrightness <= LED_RING_BRIGHTNESS_MAX)
-            {
-                l.debug("setting LED ring brightness to %d", decodedLedRingBrightness);
-                gPixelBrightness = decodedLedRingBrightness;
-            }
-            else
-            {
-                l.error("Got an out-of-range LED ring brightness request: %d", decodedLedRingBrightness);
-            }
-        }
-        else
+        switch (field.type)
         {
-            l.warning("'ledRingBrightness' was missing from the config");
+        case CONFIG_FIELD_UINT8:
+        case CONFIG_FIELD_CHOICE:
+            changed |= *(uint8_t *)(configBytes + field.offset) != (uint8_t)value.value;
+            *(uint8_t *)(configBytes + field.offset) = (uint8_t)value.value;
+            break;
+        case CONFIG_FIELD_ON_OFF:
+            changed |= *(boolean *)(configBytes + field.offset) != (value.value != 0);
+            *(boolean *)(configBytes + field.offset) = value.value != 0;
+            break;
+        case CONFIG_FIELD_INT32:
+            changed |= *(int32_t *)(configBytes + field.offset) != value.value;
+            *(int32_t *)(configBytes + field.offset) = value.value;
+            break;
         }
 
-        /*
-            LED Ring Saturation
-
-            Parameter: ledRingSaturation
-        */
-
-        String saturation = json["ledRingSaturation"];
-        l.debug("'ledRingSaturation' was %s", saturation.c_str());
-
-        // Don't look at an empty string
-        if (saturation != NULL && !saturation.isEmpty() && !saturation.equals("null"))
-        {
+        LOG_DEBUG(l, "set '%s' to %d", field.key, value.value);
+    }
 
-            uint8_t decodedSaturation = atoi(saturation.c_str());
-
-            // Make sure that the brightness is in range
-            if (decodedSaturation >= LED_RING_SATURATION_MIN && decodedSaturation <= LED_RING_SATURATION_MAX)
-            {
-                l.debug("setting LED saturation to %d", decodedSaturation);
-                gPixelRingSaturation = decodedSaturation;
-            }
-            else
-            {
-                l.error("Got an out-of-range LED saturation request: %d", decodedSaturation);
-            }
-        }
-        else
-        {
-            l.warning("'ledRingSaturation' was missing from the config");
-        }
+    if (changed)
+    {
+        setClockConfig(config);
+        markConfigChanged();
     }
-}
\ No newline at end of file
+
+    return changed;
+}
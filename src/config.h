@@ -2,11 +2,10 @@
 #pragma once
 
 #include <Arduino.h>
-#include <ArduinoJson.h>
 #include <Preferences.h>
 
 #include "logging/logging.h"
 
 #include "creature.h"
 
-void updateConfig(String incomingJson);
+boolean updateConfig(const char *payload, size_t length);
@@ -0,0 +1,763 @@
+
+#include <Arduino.h>
+
+#include "config_parser.h"
+
+// How deep can an object or array that we're skipping go?
+#define CONFIG_PARSER_MAX_DEPTH 8
+
+/**
+ * @brief Walks a buffer of JSON one token at a time
+ */
+struct JsonCursor
+{
+    const char *p;
+    const char *end;
+
+    boolean atEnd()
+    {
+        return p >= end;
+    }
+
+    void skipWhitespace()
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+        {
+            p++;
+        }
+    }
+
+    boolean consume(char c)
+    {
+        skipWhitespace();
+        if (p < end && *p == c)
+        {
+            p++;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Reads a string, leaving start and length pointing at what's between the quotes
+     *
+     * Escapes are skipped over, not decoded. None of our keys or values need them.
+     */
+    boolean readString(const char *&start, size_t &length)
+    {
+        if (!consume('"'))
+        {
+            return false;
+        }
+
+        start = p;
+        while (p < end && *p != '"')
+        {
+            if (*p == '\\')
+            {
+                p++;
+            }
+            p++;
+        }
+
+        if (p >= end)
+        {
+            return false;
+        }
+
+        length = p - start;
+        p++;
+        return true;
+    }
+
+    /**
+     * @brief Reads a number, keeping the integer part
+     *
+     * Anything too big to fit is clamped, which the range check will catch.
+     */
+    boolean readNumber(int32_t &value)
+    {
+        skipWhitespace();
+
+        boolean negative = false;
+        if (p < end && *p == '-')
+        {
+            negative = true;
+            p++;
+        }
+
+        if (p >= end || *p < '0' || *p > '9')
+        {
+            return false;
+        }
+
+        int32_t result = 0;
+        while (p < end && *p >= '0' && *p <= '9')
+        {
+            if (result < 100000000)
+            {
+                result = result * 10 + (*p - '0');
+            }
+            p++;
+        }
+
+        // Drop any fraction or exponent
+        if (p < end && *p == '.')
+        {
+            p++;
+            while (p < end && *p >= '0' && *p <= '9')
+            {
+                p++;
+            }
+        }
+        if (p < end && (*p == 'e' || *p == 'E'))
+        {
+            p++;
+            if (p < end && (*p == '+' || *p == '-'))
+            {
+                p++;
+            }
+            while (p < end && *p >= '0' && *p <= '9')
+            {
+                p++;
+            }
+        }
+
+        value = negative ? -result : result;
+        return true;
+    }
+
+    boolean readLiteral(const char *literal)
+    {
+        size_t length = strlen(literal);
+        if ((size_t)(end - p) < length || strncmp(p, literal, length) != 0)
+        {
+            return false;
+        }
+        p += length;
+        return true;
+    }
+
+    /**
+     * @brief Skips over a value we don't care about
+     */
+    boolean skipValue()
+    {
+        skipWhitespace();
+        if (p >= end)
+        {
+            return false;
+        }
+
+        const char *start;
+        size_t length;
+        int32_t number;
+
+        switch (*p)
+        {
+        case '"':
+            return readString(start, length);
+        case 't':
+            return readLiteral("true");
+        case 'f':
+            return readLiteral("false");
+        case 'n':
+            return readLiteral("null");
+        case '{':
+        case '[':
+            return skipContainer();
+        default:
+            return readNumber(number);
+        }
+    }
+
+    /**
+     * @brief Skips a whole object or array, without recursing
+     */
+    boolean skipContainer()
+    {
+        uint8_t depth = 0;
+        do
+        {
+            if (p >= end)
+            {
+                return false;
+            }
+
+            const char *start;
+            size_t length;
+
+            switch (*p)
+            {
+            case '"':
+                if (!readString(start, length))
+                {
+                    return false;
+                }
+                continue;
+            case '{':
+            case '[':
+                if (++depth > CONFIG_PARSER_MAX_DEPTH)
+                {
+                    return false;
+                }
+                break;
+            case '}':
+            case ']':
+                depth--;
+                break;
+            }
+            p++;
+        } while (depth > 0);
+
+        return true;
+    }
+};
+
+/**
+ * @brief Works out a field's value from a string, the same way for JSON and MessagePack
+ */
+static void readStringValue(const ConfigField &field, const char *start, size_t length, ConfigValue &value)
+{
+    if (field.type == CONFIG_FIELD_ON_OFF)
+    {
+        value.value = (length == 2 && memcmp(start, "on", 2) == 0) ? 1 : 0;
+        value.valid = true;
+    }
+    else if (field.type == CONFIG_FIELD_CHOICE)
+    {
+        // Which one is it?
+        for (int32_t i = 0; field.choices[i] != NULL; i++)
+        {
+            if (strlen(field.choices[i]) == length && memcmp(field.choices[i], start, length) == 0)
+            {
+                value.value = i;
+                value.valid = true;
+                break;
+            }
+        }
+    }
+    else
+    {
+        // A number in a string
+        JsonCursor inner = {start, start + length};
+        value.valid = inner.readNumber(value.value);
+        inner.skipWhitespace();
+        value.valid = value.valid && inner.atEnd();
+    }
+}
+
+/**
+ * @brief Finds the field for a key
+ *
+ * @return uint8_t The index of the field, or fieldCount if it isn't one of ours
+ */
+static uint8_t findField(const ConfigField *schema, uint8_t fieldCount, const char *key, size_t keyLength)
+{
+    uint8_t i = 0;
+    while (i < fieldCount && !(strlen(schema[i].key) == keyLength && memcmp(schema[i].key, key, keyLength) == 0))
+    {
+        i++;
+    }
+    return i;
+}
+
+/**
+ * @brief Decodes a field's value at the cursor
+ */
+static boolean readFieldValue(JsonCursor &json, const ConfigField &field, ConfigValue &value)
+{
+    json.skipWhitespace();
+    if (json.atEnd())
+    {
+        return false;
+    }
+
+    // A null is the same as not being there at all
+    if (*json.p == 'n')
+    {
+        value.present = false;
+        return json.readLiteral("null");
+    }
+
+    value.present = true;
+    value.valid = false;
+
+    const char *start;
+    size_t length;
+
+    switch (*json.p)
+    {
+    case '"':
+        if (!json.readString(start, length))
+        {
+            return false;
+        }
+
+        readStringValue(field, start, length, value);
+        return true;
+
+    case 't':
+        value.value = 1;
+        value.valid = field.type == CONFIG_FIELD_ON_OFF;
+        return json.readLiteral("true");
+
+    case 'f':
+        value.value = 0;
+        value.valid = field.type == CONFIG_FIELD_ON_OFF;
+        return json.readLiteral("false");
+
+    case '{':
+    case '[':
+        return json.skipContainer();
+
+    default:
+        if (!json.readNumber(value.value))
+        {
+            return false;
+        }
+        value.valid = field.type != CONFIG_FIELD_ON_OFF;
+        return true;
+    }
+}
+
+boolean parseJsonConfig(const char *payload, size_t length,
+                        const ConfigField *schema, uint8_t fieldCount,
+                        ConfigValue *values)
+{
+    memset(values, 0, sizeof(ConfigValue) * fieldCount);
+
+    JsonCursor json = {payload, payload + length};
+
+    if (!json.consume('{'))
+    {
+        return false;
+    }
+
+    // An empty object is fine
+    if (json.consume('}'))
+    {
+        return true;
+    }
+
+    do
+    {
+        const char *key;
+        size_t keyLength;
+        if (!json.readString(key, keyLength) || !json.consume(':'))
+        {
+            return false;
+        }
+
+        // Is this one of ours?
+        uint8_t i = findField(schema, fieldCount, key, keyLength);
+
+        boolean ok = (i < fieldCount) ? readFieldValue(json, schema[i], values[i]) : json.skipValue();
+        if (!ok)
+        {
+            return false;
+        }
+
+    } while (json.consume(','));
+
+    return json.consume('}');
+}
+
+/**
+ * @brief Walks a buffer of MessagePack one item at a time
+ */
+struct MsgPackCursor
+{
+    const uint8_t *p;
+    const uint8_t *end;
+
+    boolean atEnd()
+    {
+        return p >= end;
+    }
+
+    size_t remaining()
+    {
+        return end - p;
+    }
+
+    boolean skip(uint32_t count)
+    {
+        if (count > remaining())
+        {
+            return false;
+        }
+        p += count;
+        return true;
+    }
+
+    /**
+     * @brief Reads a big endian unsigned number that's 1, 2, 4 or 8 bytes long
+     */
+    boolean readUnsigned(uint8_t size, uint64_t &value)
+    {
+        if (size > remaining())
+        {
+            return false;
+        }
+
+        value = 0;
+        for (uint8_t i = 0; i < size; i++)
+        {
+            value = (value << 8) | *p++;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Reads how many items are in something, and makes sure there's room for them
+     *
+     * Every item is at least one byte, so a count bigger than what's left is garbage.
+     */
+    boolean readCount(uint8_t size, uint32_t &count)
+    {
+        uint64_t value;
+        if (!readUnsigned(size, value) || value > remaining())
+        {
+            return false;
+        }
+        count = value;
+        return true;
+    }
+
+    boolean readMapHeader(uint32_t &count)
+    {
+        if (atEnd())
+        {
+            return false;
+        }
+
+        uint8_t type = *p++;
+        if ((type & 0xF0) == 0x80)
+        {
+            count = type & 0x0F;
+            return true;
+        }
+        if (type == 0xDE)
+        {
+            return readCount(2, count);
+        }
+        if (type == 0xDF)
+        {
+            return readCount(4, count);
+        }
+        return false;
+    }
+
+    static boolean isString(uint8_t type)
+    {
+        return (type & 0xE0) == 0xA0 || (type >= 0xD9 && type <= 0xDB);
+    }
+
+    static boolean isInteger(uint8_t type)
+    {
+        return type <= 0x7F || type >= 0xE0 || (type >= 0xCC && type <= 0xD3);
+    }
+
+    /**
+     * @brief Reads a string, leaving start and length pointing at the bytes in it
+     */
+    boolean readString(const char *&start, size_t &length)
+    {
+        if (atEnd() || !isString(*p))
+        {
+            return false;
+        }
+
+        uint8_t type = *p++;
+        uint32_t count;
+        if ((type & 0xE0) == 0xA0)
+        {
+            count = type & 0x1F;
+        }
+        else if (!readCount(type == 0xD9 ? 1 : (type == 0xDA ? 2 : 4), count))
+        {
+            return false;
+        }
+
+        start = (const char *)p;
+        length = count;
+        return skip(count);
+    }
+
+    /**
+     * @brief Reads any kind of integer
+     *
+     * Anything too big to fit is clamped, which the range check will catch.
+     */
+    boolean readInteger(int32_t &value)
+    {
+        if (atEnd() || !isInteger(*p))
+        {
+            return false;
+        }
+
+        uint8_t type = *p++;
+        if (type <= 0x7F)
+        {
+            value = type;
+            return true;
+        }
+        if (type >= 0xE0)
+        {
+            value = (int8_t)type;
+            return true;
+        }
+
+        // 0xCC - 0xCF are unsigned and 0xD0 - 0xD3 are signed, 1, 2, 4 and 8 bytes long
+        boolean isSigned = type >= 0xD0;
+        uint8_t size = 1 << ((type - 0xCC) & 0x03);
+
+        uint64_t raw;
+        if (!readUnsigned(size, raw))
+        {
+            return false;
+        }
+
+        int64_t number;
+        if (isSigned)
+        {
+            // Sign extend it from however many bytes it was
+            uint8_t shift = 64 - (size * 8);
+            number = (int64_t)(raw << shift) >> shift;
+        }
+        else
+        {
+            number = raw > INT32_MAX ? INT32_MAX : (int64_t)raw;
+        }
+
+        value = number > INT32_MAX ? INT32_MAX : (number < INT32_MIN ? INT32_MIN : (int32_t)number);
+        return true;
+    }
+
+    /**
+     * @brief Skips over a value we don't care about, without recursing
+     *
+     * Maps and arrays just add how many items they have to what's left to skip.
+     */
+    boolean skipValue()
+    {
+        uint32_t pending = 1;
+        while (pending > 0)
+        {
+            if (atEnd())
+            {
+                return false;
+            }
+
+            uint8_t type = *p++;
+            pending--;
+
+            uint64_t size;
+            uint32_t count = 0;
+
+            // Positive and negative fixint, nil, false and true are just the one byte
+            if (type <= 0x7F || type >= 0xE0 || type == 0xC0 || type == 0xC2 || type == 0xC3)
+            {
+                continue;
+            }
+
+            // fixmap, fixarray and fixstr
+            if ((type & 0xF0) == 0x80)
+            {
+                pending += (type & 0x0F) * 2;
+                continue;
+            }
+            if ((type & 0xF0) == 0x90)
+            {
+                pending += type & 0x0F;
+                continue;
+            }
+            if ((type & 0xE0) == 0xA0)
+            {
+                if (!skip(type & 0x1F))
+                {
+                    return false;
+                }
+                continue;
+            }
+
+            boolean ok;
+            switch (type)
+            {
+            case 0xC4: // bin 8, 16 and 32
+            case 0xC5:
+            case 0xC6:
+            case 0xD9: // str 8, 16 and 32
+            case 0xDA:
+            case 0xDB:
+            {
+                uint8_t lengthSize = (type <= 0xC6) ? 1 << (type - 0xC4) : 1 << (type - 0xD9);
+                ok = readUnsigned(lengthSize, size) && size <= remaining() && skip(size);
+                break;
+            }
+            case 0xC7: // ext 8, 16 and 32 (there's a type byte after the length)
+            case 0xC8:
+            case 0xC9:
+                ok = readUnsigned(1 << (type - 0xC7), size) && size < remaining() && skip(size + 1);
+                break;
+            case 0xCA: // float 32 and 64
+                ok = skip(4);
+                break;
+            case 0xCB:
+                ok = skip(8);
+                break;
+            case 0xCC: // uint and int 8, 16, 32 and 64
+            case 0xCD:
+            case 0xCE:
+            case 0xCF:
+            case 0xD0:
+            case 0xD1:
+            case 0xD2:
+            case 0xD3:
+                ok = skip(1 << ((type - 0xCC) & 0x03));
+                break;
+            case 0xD4: // fixext 1, 2, 4, 8 and 16 (plus the type byte)
+            case 0xD5:
+            case 0xD6:
+            case 0xD7:
+            case 0xD8:
+                ok = skip((1 << (type - 0xD4)) + 1);
+                break;
+            case 0xDC: // array 16 and 32
+            case 0xDD:
+                ok = readCount(type == 0xDC ? 2 : 4, count);
+                pending += count;
+                break;
+            case 0xDE: // map 16 and 32
+            case 0xDF:
+                ok = readCount(type == 0xDE ? 2 : 4, count);
+                pending += count * 2;
+                break;
+            default: // 0xC1 is never used
+                ok = false;
+                break;
+            }
+
+            if (!ok || pending > remaining())
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+};
+
+/**
+ * @brief Decodes a field's value at the cursor
+ */
+static boolean readFieldValue(MsgPackCursor &msgpack, const ConfigField &field, ConfigValue &value)
+{
+    if (msgpack.atEnd())
+    {
+        return false;
+    }
+
+    uint8_t type = *msgpack.p;
+
+    // A nil is the same as not being there at all
+    if (type == 0xC0)
+    {
+        msgpack.p++;
+        value.present = false;
+        return true;
+    }
+
+    value.present = true;
+    value.valid = false;
+
+    if (MsgPackCursor::isString(type))
+    {
+        const char *start;
+        size_t length;
+        if (!msgpack.readString(start, length))
+        {
+            return false;
+        }
+
+        readStringValue(field, start, length, value);
+        return true;
+    }
+
+    if (type == 0xC2 || type == 0xC3)
+    {
+        msgpack.p++;
+        value.value = type == 0xC3 ? 1 : 0;
+        value.valid = field.type == CONFIG_FIELD_ON_OFF;
+        return true;
+    }
+
+    if (MsgPackCursor::isInteger(type))
+    {
+        if (!msgpack.readInteger(value.value))
+        {
+            return false;
+        }
+        value.valid = field.type != CONFIG_FIELD_ON_OFF;
+        return true;
+    }
+
+    // Floats, maps, arrays and such are there, but not something we can use
+    return msgpack.skipValue();
+}
+
+ConfigFormat detectConfigFormat(const char *payload, size_t length)
+{
+    if (length == 0)
+    {
+        return CONFIG_FORMAT_JSON;
+    }
+
+    // A fixmap, map 16 or map 32. None of those can start a JSON object.
+    uint8_t first = payload[0];
+    if ((first & 0xF0) == 0x80 || first == 0xDE || first == 0xDF)
+    {
+        return CONFIG_FORMAT_MSGPACK;
+    }
+
+    return CONFIG_FORMAT_JSON;
+}
+
+boolean parseMsgPackConfig(const char *payload, size_t length,
+                           const ConfigField *schema, uint8_t fieldCount,
+                           ConfigValue *values, size_t &used)
+{
+    used = 0;
+    memset(values, 0, sizeof(ConfigValue) * fieldCount);
+
+    MsgPackCursor msgpack = {(const uint8_t *)payload, (const uint8_t *)payload + length};
+
+    uint32_t count;
+    if (!msgpack.readMapHeader(count))
+    {
+        return false;
+    }
+
+    for (uint32_t entry = 0; entry < count; entry++)
+    {
+        const char *key;
+        size_t keyLength;
+        if (!msgpack.readString(key, keyLength))
+        {
+            return false;
+        }
+
+        // Is this one of ours?
+        uint8_t i = findField(schema, fieldCount, key, keyLength);
+
+        boolean ok = (i < fieldCount) ? readFieldValue(msgpack, schema[i], values[i]) : msgpack.skipValue();
+        if (!ok)
+        {
+            return false;
+        }
+    }
+
+    used = msgpack.p - (const uint8_t *)payload;
+    return true;
+}
@@ -0,0 +1,104 @@
+
+#pragma once
+
+#include <Arduino.h>
+
+/*
+    A tiny, declarative config parser
+
+    Each thing we know how to configure is described by a ConfigField in a
+    table. The parser walks the payload once, in place, and fills in one
+    ConfigValue per field. It never allocates anything, and it doesn't touch
+    the config. It's up to the caller to check the values and apply them.
+
+    The config can be JSON (what Home Assistant sends) or a MessagePack map
+    with the same keys (smaller and cheaper, for automations that talk to a
+    lot of clocks at once). Both go through the same schema.
+*/
+
+enum ConfigFieldType
+{
+    CONFIG_FIELD_UINT8,  // A number (or a string with a number in it) between min and max
+    CONFIG_FIELD_ON_OFF, // "on" or "off" (or true or false)
+    CONFIG_FIELD_CHOICE, // One of a list of names, kept as a uint8_t index into the list
+    CONFIG_FIELD_INT32   // A number between min and max that's too big for a uint8_t, kept as an int32_t
+};
+
+struct ConfigField
+{
+    const char *key;
+    ConfigFieldType type;
+    int32_t min;
+    int32_t max;
+    size_t offset;              // Where it lives in ClockConfig, a boolean for CONFIG_FIELD_ON_OFF, an int32_t for CONFIG_FIELD_INT32 or a uint8_t otherwise
+    const char *const *choices; // The names for a CONFIG_FIELD_CHOICE, ending with a NULL
+};
+
+enum ConfigFormat
+{
+    CONFIG_FORMAT_JSON,
+    CONFIG_FORMAT_MSGPACK,
+    CONFIG_FORMAT_COUNT
+};
+
+/**
+ * @brief How much work each format has been, kept up by updateConfig()
+ */
+struct ConfigFormatStats
+{
+    uint32_t messages;
+    uint32_t lastBytes;
+    uint32_t lastParseUs;
+    uint32_t maxParseUs;
+};
+
+extern ConfigFormatStats configFormatStats[CONFIG_FORMAT_COUNT];
+
+struct ConfigValue
+{
+    boolean present; // Was it in the payload, and not null?
+    boolean valid;   // Could we make sense of it?
+    int32_t value;
+};
+
+/**
+ * @brief Parses a flat JSON object against a config schema
+ *
+ * Keys that aren't in the schema are skipped over, even if they're objects
+ * or arrays.
+ *
+ * @param payload The JSON (doesn't need to be null terminated)
+ * @param length How long the JSON is
+ * @param schema The fields we're looking for
+ * @param fieldCount How many fields are in the schema
+ * @param values One value per field in the schema, filled in by the parser
+ * @return true if the payload was a JSON object we could read all the way through
+ */
+boolean parseJsonConfig(const char *payload, size_t length,
+                        const ConfigField *schema, uint8_t fieldCount,
+                        ConfigValue *values);
+
+/**
+ * @brief Works out if a payload is JSON or MessagePack from its first byte
+ */
+ConfigFormat detectConfigFormat(const char *payload, size_t length);
+
+/**
+ * @brief Parses a flat MessagePack map against a config schema
+ *
+ * Keys have to be strings. Values can be integers, booleans, strings (the same
+ * as they'd be in JSON) or nil. Keys that aren't in the schema are skipped
+ * over, whatever they are. Anything after the map is ignored, so it's fine to
+ * pass the whole buffer the message came in.
+ *
+ * @param payload The MessagePack
+ * @param length How many bytes it could be
+ * @param schema The fields we're looking for
+ * @param fieldCount How many fields are in the schema
+ * @param values One value per field in the schema, filled in by the parser
+ * @param used How many bytes the map actually took up
+ * @return true if the payload was a map we could read all the way through
+ */
+boolean parseMsgPackConfig(const char *payload, size_t length,
+                           const ConfigField *schema, uint8_t fieldCount,
+                           ConfigValue *values, size_t &used);
@@ -0,0 +1,178 @@
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+#include "esp32/rom/crc.h"
+
+#include "logging/logging.h"
+
+#include "clock_config.h"
+#include "config_store.h"
+
+using namespace creatures;
+
+static Logger l;
+
+// What's in the flash right now, so we don't write the same thing twice
+static StoredConfig lastStored;
+static boolean lastStoredValid = false;
+
+static volatile boolean configDirty = false;
+static volatile unsigned long configChangedAt = 0;
+
+static uint32_t storedConfigCrc(const StoredConfig &config)
+{
+    return crc32_le(0, (const uint8_t *)&config, offsetof(StoredConfig, crc));
+}
+
+static uint32_t storedConfigV1Crc(const StoredConfigV1 &config)
+{
+    return crc32_le(0, (const uint8_t *)&config, offsetof(StoredConfigV1, crc));
+}
+
+/**
+ * @brief Brings a version 1 config up to date
+ *
+ * Everything it had means the same thing now. Fleet sync didn't exist yet, so
+ * it's off, just like a clock that's never been sent ledRingFleetSync.
+ */
+static void migrateStoredConfigV1(const StoredConfigV1 &old, StoredConfig &config)
+{
+    memset(&config, 0, sizeof(config));
+    config.version = CONFIG_STORE_VERSION;
+    config.screenBrightness = old.screenBrightness;
+    config.blinkColon = old.blinkColon;
+    config.displayOn = old.displayOn;
+    config.pixelBrightness = old.pixelBrightness;
+    config.pixelSaturation = old.pixelSaturation;
+    config.ringEffect = old.ringEffect;
+    config.ringDither = old.ringDither;
+    config.ringFleetSync = false;
+    config.crc = storedConfigCrc(config);
+}
+
+StoredConfigStatus loadStoredConfig()
+{
+    Preferences preferences;
+    if (!preferences.begin(CONFIG_STORE_NAMESPACE, true))
+    {
+        return STORED_CONFIG_MISSING;
+    }
+
+    // Big enough for any version, since the old ones are smaller
+    uint8_t stored[sizeof(StoredConfig)];
+    size_t length = preferences.getBytes(CONFIG_STORE_KEY, stored, sizeof(stored));
+    preferences.end();
+
+    if (length == 0)
+    {
+        return STORED_CONFIG_MISSING;
+    }
+
+    StoredConfig config;
+    boolean migrated = false;
+    if (length == sizeof(StoredConfig) && stored[0] == CONFIG_STORE_VERSION)
+    {
+        memcpy(&config, stored, sizeof(config));
+        if (config.crc != storedConfigCrc(config))
+        {
+            return STORED_CONFIG_BAD_CRC;
+        }
+    }
+    else if (length == sizeof(StoredConfigV1) && stored[0] == 1)
+    {
+        StoredConfigV1 old;
+        memcpy(&old, stored, sizeof(old));
+        if (old.crc != storedConfigV1Crc(old))
+        {
+            return STORED_CONFIG_BAD_CRC;
+        }
+        migrateStoredConfigV1(old, config);
+        migrated = true;
+    }
+    else
+    {
+        return STORED_CONFIG_WRONG_VERSION;
+    }
+
+    ClockConfig clockConfig;
+    clockConfig.screenBrightness = config.screenBrightness;
+    clockConfig.blinkColon = config.blinkColon;
+    clockConfig.displayOn = config.displayOn;
+    clockConfig.pixelBrightness = config.pixelBrightness;
+    clockConfig.pixelSaturation = config.pixelSaturation;
+    clockConfig.ringEffect = config.ringEffect;
+    clockConfig.ringDither = config.ringDither;
+    clockConfig.ringFleetSync = config.ringFleetSync;
+    setClockConfig(clockConfig);
+
+    if (migrated)
+    {
+        // What's in the flash is still the old one, so write the new one out on the next flush
+        markConfigChanged();
+        return STORED_CONFIG_MIGRATED;
+    }
+
+    lastStored = config;
+    lastStoredValid = true;
+
+    return STORED_CONFIG_LOADED;
+}
+
+void markConfigChanged()
+{
+    configChangedAt = millis();
+    configDirty = true;
+}
+
+void flushStoredConfig()
+{
+    if (!configDirty || millis() - configChangedAt < CONFIG_STORE_QUIET_MS)
+    {
+        return;
+    }
+    configDirty = false;
+
+    ClockConfig clockConfig;
+    getClockConfig(clockConfig);
+
+    StoredConfig config;
+    memset(&config, 0, sizeof(config));
+    config.version = CONFIG_STORE_VERSION;
+    config.screenBrightness = clockConfig.screenBrightness;
+    config.blinkColon = clockConfig.blinkColon;
+    config.displayOn = clockConfig.displayOn;
+    config.pixelBrightness = clockConfig.pixelBrightness;
+    config.pixelSaturation = clockConfig.pixelSaturation;
+    config.ringEffect = clockConfig.ringEffect;
+    config.ringDither = clockConfig.ringDither;
+    config.ringFleetSync = clockConfig.ringFleetSync;
+    config.crc = storedConfigCrc(config);
+
+    // Don't wear out the flash writing what's already there
+    if (lastStoredValid && memcmp(&config, &lastStored, sizeof(config)) == 0)
+    {
+        l.debug("config is the same as what's stored, not writing it");
+        return;
+    }
+
+    Preferences preferences;
+    if (!preferences.begin(CONFIG_STORE_NAMESPACE, false))
+    {
+        l.error("unable to open NVS to store the config");
+        return;
+    }
+
+    size_t written = preferences.putBytes(CONFIG_STORE_KEY, &config, sizeof(config));
+    preferences.end();
+
+    if (written != sizeof(config))
+    {
+        l.error("unable to write the config to NVS");
+        return;
+    }
+
+    lastStored = config;
+    lastStoredValid = true;
+    l.info("stored the config in NVS");
+}
@@ -0,0 +1,91 @@
+
+#pragma once
+
+#include <Arduino.h>
+
+/*
+    Keeps the last config we were sent in NVS
+
+    The real config lives in a retained MQTT topic, but that doesn't show up until
+    we've got WiFi, found the broker, and connected. Keeping a copy in flash lets
+    the clock come up with the right settings before any of that happens.
+*/
+
+#define CONFIG_STORE_NAMESPACE "clocky"
+#define CONFIG_STORE_KEY "config"
+
+// Bump this any time StoredConfig changes (and teach loadStoredConfig() to migrate the old one)
+#define CONFIG_STORE_VERSION 2
+
+// Wait for the config to stop changing for this long before writing it
+#define CONFIG_STORE_QUIET_MS (10 * 1000)
+
+/**
+ * @brief What gets written to NVS
+ */
+struct StoredConfig
+{
+    uint8_t version;
+    uint8_t screenBrightness;
+    uint8_t blinkColon;
+    uint8_t displayOn;
+    uint8_t pixelBrightness;
+    uint8_t pixelSaturation;
+    uint8_t ringEffect; // This was reserved (and zero) before, which is RING_EFFECT_WIPE
+    uint8_t ringDither; // Also reserved (and zero) before, which is off
+    uint8_t ringFleetSync;
+    uint8_t reserved[3]; // Keeps the CRC lined up
+    uint32_t crc;        // CRC32 of everything above
+};
+
+/**
+ * @brief What version 1 wrote, before there was a fleet to follow
+ *
+ * Clocks in the field have these in their flash. They get loaded with the new
+ * fields at their defaults, and written back out as the current version.
+ */
+struct StoredConfigV1
+{
+    uint8_t version;
+    uint8_t screenBrightness;
+    uint8_t blinkColon;
+    uint8_t displayOn;
+    uint8_t pixelBrightness;
+    uint8_t pixelSaturation;
+    uint8_t ringEffect;
+    uint8_t ringDither;
+    uint32_t crc; // CRC32 of everything above
+};
+
+enum StoredConfigStatus
+{
+    STORED_CONFIG_LOADED,
+    STORED_CONFIG_MIGRATED,
+    STORED_CONFIG_MISSING,
+    STORED_CONFIG_WRONG_VERSION,
+    STORED_CONFIG_BAD_CRC
+};
+
+/**
+ * @brief Loads the config from NVS and applies it, if there's a good one there
+ *
+ * This doesn't log anything, since it's meant to be called before the logger
+ * is running.
+ *
+ * @return StoredConfigStatus what happened
+ */
+StoredConfigStatus loadStoredConfig();
+
+/**
+ * @brief Lets the store know the config changed and needs to be saved
+ */
+void markConfigChanged();
+
+/**
+ * @brief Writes the config to NVS if it's changed and has settled down
+ *
+ * Call this every now and then. It won't touch the flash until the config
+ * hasn't changed for CONFIG_STORE_QUIET_MS, and only if it's actually
+ * different from what's already there.
+ */
+void flushStoredConfig();
@@ -0,0 +1,121 @@
+
+#include <Arduino.h>
+
+#include <limits.h>
+
+extern "C"
+{
+#include "freertos/FreeRTOS.h"
+}
+
+#include "logging/logging.h"
+
+#include "clock_config.h"
+#include "config_parser.h"
+#include "fleet_sync.h"
+#include "seconds_ring.h"
+
+using namespace creatures;
+
+static Logger l;
+
+FleetSyncStats fleetSyncStats;
+
+/**
+ * @brief The fleet's schedule, as far as we know it
+ */
+struct FleetSchedule
+{
+    int32_t startMinute;
+    int32_t hueSeed;
+};
+
+static const ConfigField fleetSyncSchema[] = {
+    {"startMinute", CONFIG_FIELD_INT32, FLEET_SYNC_MIN_START_MINUTE, FLEET_SYNC_MAX_START_MINUTE, offsetof(FleetSchedule, startMinute), NULL},
+    {"hueSeed", CONFIG_FIELD_INT32, 0, FLEET_SYNC_MAX_HUE_SEED, offsetof(FleetSchedule, hueSeed), NULL},
+};
+
+#define FLEET_SYNC_FIELD_COUNT (sizeof(fleetSyncSchema) / sizeof(fleetSyncSchema[0]))
+
+// Written by the message reader on core 0, read by the ring on core 1
+static FleetSchedule fleetSchedule;
+static boolean fleetScheduleValid = false;
+static portMUX_TYPE fleetScheduleLock = portMUX_INITIALIZER_UNLOCKED;
+
+boolean updateFleetSchedule(const char *payload, size_t length)
+{
+    ConfigValue values[FLEET_SYNC_FIELD_COUNT];
+    if (!parseJsonConfig(payload, length, fleetSyncSchema, FLEET_SYNC_FIELD_COUNT, values))
+    {
+        fleetSyncStats.rejected++;
+        l.error("unable to read a fleet sync message (%u bytes)", (unsigned int)length);
+        return false;
+    }
+
+    // Both have to be there, and make sense, or it's no good to us
+    FleetSchedule schedule;
+    uint8_t *scheduleBytes = (uint8_t *)&schedule;
+    for (uint8_t i = 0; i < FLEET_SYNC_FIELD_COUNT; i++)
+    {
+        const ConfigField &field = fleetSyncSchema[i];
+        const ConfigValue &value = values[i];
+
+        if (!value.present || !value.valid || value.value < field.min || value.value > field.max)
+        {
+            fleetSyncStats.rejected++;
+            l.error("fleet sync message had a missing or out-of-range '%s'", field.key);
+            return false;
+        }
+
+        *(int32_t *)(scheduleBytes + field.offset) = value.value;
+    }
+
+    portENTER_CRITICAL(&fleetScheduleLock);
+    fleetSchedule = schedule;
+    fleetScheduleValid = true;
+    portEXIT_CRITICAL(&fleetScheduleLock);
+
+    fleetSyncStats.received++;
+    fleetSyncStats.startMinute = schedule.startMinute;
+    fleetSyncStats.hueSeed = schedule.hueSeed;
+
+    l.info("fleet sync: hue %d at minute %d", schedule.hueSeed, schedule.startMinute);
+
+    // Don't wait for the next minute to fall in line with everybody else
+    ClockConfig config;
+    getClockConfig(config);
+    return config.ringFleetSync;
+}
+
+boolean getFleetHue(uint32_t minute, uint16_t &hue)
+{
+    ClockConfig config;
+    getClockConfig(config);
+
+    FleetSchedule schedule;
+    boolean valid;
+    portENTER_CRITICAL(&fleetScheduleLock);
+    schedule = fleetSchedule;
+    valid = fleetScheduleValid;
+    portEXIT_CRITICAL(&fleetScheduleLock);
+
+    fleetSyncStats.following = valid && config.ringFleetSync;
+    if (!fleetSyncStats.following)
+    {
+        return false;
+    }
+
+    /*
+        Every minute steps GOLDEN_RATIO_CONJUGATE around a wheel of USHRT_MAX hues,
+        just like getRandomHue(). Going backwards from the start works too, so it
+        doesn't matter if the start is a little in the future.
+    */
+    int64_t steps = ((int64_t)minute - schedule.startMinute) % USHRT_MAX;
+    if (steps < 0)
+    {
+        steps += USHRT_MAX;
+    }
+
+    hue = (schedule.hueSeed + (uint64_t)steps * GOLDEN_RATIO_CONJUGATE) % USHRT_MAX;
+    return true;
+}
@@ -0,0 +1,73 @@
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <limits.h>
+
+/*
+    Keeps a room full of clocks on the same colour at the same time
+
+    Every clock picks its own random hue each minute, so a few of them on one
+    wall never match. When ledRingFleetSync is on, the ring follows a sync
+    message on a global topic instead, which every clock gets at the same time:
+
+        {"startMinute": 29400000, "hueSeed": 12345}
+
+    startMinute is a minute since the epoch (the Unix time divided by 60), and
+    hueSeed is the hue the ring fades to in that minute. Every minute after
+    (or before) it steps around the colour wheel by the golden ratio, the same
+    way getRandomHue() does, so any clock can work out the hue for any minute
+    on its own. A clock that boots later, or misses a message, lands on the
+    same colour as everybody else.
+
+    The ring's frames are already scheduled against the wall clock, so once
+    everybody agrees on which minute is which, the only phase error left
+    between clocks is how far apart their clocks are (which SNTP keeps to a few
+    milliseconds, see time_discipline.h).
+
+    Messages are coalesced, so a burst of them only counts the last one.
+*/
+
+#define FLEET_SYNC_TOPIC "clocky/ringSync"
+
+// Don't take a start from before 2020 or after 2099, it's more likely junk than a real one
+#define FLEET_SYNC_MIN_START_MINUTE 26297280 // 2020-01-01
+#define FLEET_SYNC_MAX_START_MINUTE 68374080 // 2100-01-01
+
+// getRandomHue() wraps at USHRT_MAX, so a seed has to be below it to be on the same wheel
+#define FLEET_SYNC_MAX_HUE_SEED (USHRT_MAX - 1)
+
+/**
+ * @brief How the fleet sync is going
+ */
+struct FleetSyncStats
+{
+    uint32_t received;        // Good sync messages
+    uint32_t rejected;        // Ones we couldn't use
+    uint32_t startMinute;     // The last start we were sent
+    uint16_t hueSeed;         // And its hue
+    boolean following;        // Is the ring following it right now?
+    int32_t lastPhaseErrorUs; // How far off the fleet's schedule the last ring frame went out
+};
+
+extern FleetSyncStats fleetSyncStats;
+
+/**
+ * @brief Takes the schedule from a message on the fleet sync topic
+ *
+ * @param payload the message from MQTT (doesn't need to be null terminated)
+ * @param length how long it is
+ * @return true if the ring should fall in line right away (the message was
+ *         good and the ring is following the fleet)
+ */
+boolean updateFleetSchedule(const char *payload, size_t length);
+
+/**
+ * @brief Works out the hue everybody in the fleet should be fading to in a minute
+ *
+ * @param minute The minute since the epoch
+ * @param hue Where to put the hue
+ * @return true if there's a fleet to follow and it's turned on in the config
+ */
+boolean getFleetHue(uint32_t minute, uint16_t &hue);
@@ -0,0 +1,78 @@
+
+#include <Arduino.h>
+
+#include "frame_stats.h"
+
+// Roughly doubling, from 10us up to past a whole 25Hz frame
+static const int32_t frameStatsEdges[FRAME_STATS_BUCKETS - 1] = {
+    10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 25000};
+
+FrameStats::FrameStats(uint32_t deadlineUs) : lateness(frameStatsEdges),
+                                              render(frameStatsEdges),
+                                              show(frameStatsEdges)
+{
+    this->deadlineUs = deadlineUs;
+    frames = 0;
+    deadlineMisses = 0;
+    busyUs = 0;
+}
+
+void FrameStats::record(int32_t latenessUs, uint32_t renderCycles, uint32_t showCycles)
+{
+    uint32_t cyclesPerUs = ESP.getCpuFreqMHz();
+    uint32_t renderUs = renderCycles / cyclesPerUs;
+    uint32_t showUs = showCycles / cyclesPerUs;
+
+    // Waking up early isn't being late
+    if (latenessUs < 0)
+    {
+        latenessUs = 0;
+    }
+
+    lateness.record(latenessUs);
+    render.record(renderUs);
+    show.record(showUs);
+
+    frames++;
+    busyUs += renderUs + showUs;
+    if ((uint32_t)latenessUs + renderUs + showUs > deadlineUs)
+    {
+        deadlineMisses++;
+    }
+}
+
+uint32_t FrameStats::startTimer()
+{
+    return ESP.getCycleCount();
+}
+
+uint32_t FrameStats::cyclesSince(uint32_t start)
+{
+    // Unsigned math takes care of the counter wrapping
+    return ESP.getCycleCount() - start;
+}
+
+void FrameStats::setDeadlineUs(uint32_t deadlineUs)
+{
+    this->deadlineUs = deadlineUs;
+}
+
+uint32_t FrameStats::getDeadlineUs()
+{
+    return deadlineUs;
+}
+
+uint32_t FrameStats::getFrames()
+{
+    return frames;
+}
+
+uint32_t FrameStats::getDeadlineMisses()
+{
+    return deadlineMisses;
+}
+
+uint32_t FrameStats::getBusyUs()
+{
+    return busyUs;
+}
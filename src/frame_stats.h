@@ -0,0 +1,69 @@
+
+#pragma once
+
+#include <Arduino.h>
+
+#include "histogram.h"
+
+// How many buckets in each of the timing histograms
+#define FRAME_STATS_BUCKETS 12
+
+/**
+ * @brief Timing stats for a loop that has to hit a deadline every frame
+ *
+ * Each frame records how late the task woke up, how long it spent working out
+ * the frame (render), and how long it spent sending it out (show), all in us.
+ * A frame that took longer than the deadline from when it was due to when it
+ * was done counts as a deadline miss.
+ *
+ * It also adds up the time spent on render and show, so the share of the CPU
+ * the loop uses can be worked out without FreeRTOS's run time stats (which
+ * the Arduino core doesn't always build in).
+ *
+ * Times are measured with the CPU's cycle counter, so use startTimer() and
+ * cyclesSince() from the same task (and core).
+ */
+class FrameStats
+{
+public:
+    FrameStats(uint32_t deadlineUs);
+
+    /**
+     * @brief Records one frame
+     *
+     * @param latenessUs How long after it was due the task woke up
+     * @param renderCycles How many cycles building the frame took
+     * @param showCycles How many cycles sending the frame took
+     */
+    void record(int32_t latenessUs, uint32_t renderCycles, uint32_t showCycles);
+
+    static uint32_t startTimer();
+    static uint32_t cyclesSince(uint32_t start);
+
+    /**
+     * @brief Changes the deadline for the frames from here on, for a loop that changes speed
+     */
+    void setDeadlineUs(uint32_t deadlineUs);
+
+    uint32_t getDeadlineUs();
+    uint32_t getFrames();
+    uint32_t getDeadlineMisses();
+
+    /**
+     * @brief How long every frame so far spent in render and show, in us
+     *
+     * This wraps after about 71 minutes of work, so only look at the
+     * difference between two readings.
+     */
+    uint32_t getBusyUs();
+
+    Histogram<FRAME_STATS_BUCKETS> lateness;
+    Histogram<FRAME_STATS_BUCKETS> render;
+    Histogram<FRAME_STATS_BUCKETS> show;
+
+private:
+    volatile uint32_t deadlineUs;
+    volatile uint32_t frames;
+    volatile uint32_t deadlineMisses;
+    volatile uint32_t busyUs;
+};
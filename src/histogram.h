@@ -0,0 +1,91 @@
+
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @brief A fixed-size histogram with fixed bucket edges
+ *
+ * Bucket 0 holds everything below edges[0], bucket i holds [edges[i - 1], edges[i]),
+ * and the last bucket holds everything at or above the last edge.
+ *
+ * It's meant to have one task recording and anyone else reading. Readers might
+ * see a count that's one sample behind, which is fine for stats.
+ *
+ * @tparam BUCKETS How many buckets (there's one less edge than this)
+ */
+template <uint8_t BUCKETS>
+class Histogram
+{
+public:
+    Histogram(const int32_t (&edges)[BUCKETS - 1]) : edges(edges)
+    {
+        reset();
+    }
+
+    void record(int32_t value)
+    {
+        uint8_t bucket = 0;
+        while (bucket < BUCKETS - 1 && value >= edges[bucket])
+        {
+            bucket++;
+        }
+        counts[bucket]++;
+
+        if (samples == 0 || value < minimum)
+        {
+            minimum = value;
+        }
+        if (samples == 0 || value > maximum)
+        {
+            maximum = value;
+        }
+        samples++;
+    }
+
+    void reset()
+    {
+        memset((void *)counts, 0, sizeof(counts));
+        samples = 0;
+        minimum = 0;
+        maximum = 0;
+    }
+
+    uint8_t getBucketCount()
+    {
+        return BUCKETS;
+    }
+
+    int32_t getEdge(uint8_t edge)
+    {
+        return edges[edge];
+    }
+
+    uint32_t getCount(uint8_t bucket)
+    {
+        return counts[bucket];
+    }
+
+    uint32_t getSamples()
+    {
+        return samples;
+    }
+
+    int32_t getMinimum()
+    {
+        return minimum;
+    }
+
+    int32_t getMaximum()
+    {
+        return maximum;
+    }
+
+private:
+    const int32_t (&edges)[BUCKETS - 1];
+
+    volatile uint32_t counts[BUCKETS];
+    volatile uint32_t samples;
+    volatile int32_t minimum;
+    volatile int32_t maximum;
+};
@@ -0,0 +1,43 @@
+
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @brief Something that can send a frame of encoded pixels out to a strip of LEDs
+ *
+ * Transmits are allowed to happen in the background. The buffer passed to
+ * startTransmit() belongs to the driver until isBusy() goes false, so don't
+ * touch it until then.
+ */
+class LedDriver
+{
+public:
+    virtual ~LedDriver() {}
+
+    /**
+     * @brief Gets the hardware ready
+     *
+     * @return true if the driver is ready to go
+     */
+    virtual boolean begin() = 0;
+
+    /**
+     * @brief Starts sending a frame to the LEDs
+     *
+     * @param pixels The encoded pixels, in the strip's byte order
+     * @param length How many bytes to send
+     * @return true if the transmit was started
+     */
+    virtual boolean startTransmit(const uint8_t *pixels, size_t length) = 0;
+
+    /**
+     * @brief Is a frame still on the wire?
+     */
+    virtual boolean isBusy() = 0;
+
+    /**
+     * @brief Blocks until the last frame is done sending
+     */
+    virtual void waitUntilDone() = 0;
+};
@@ -0,0 +1,98 @@
+
+#pragma once
+
+#include <Arduino.h>
+
+#include "logging/logging.h"
+
+/*
+    Compile-time log levels for the hot paths
+
+    A call like l.debug("thing %d", expensive()) still evaluates expensive() and
+    goes through the Logger even when nobody is listening. These macros throw
+    away any call below CLOCKY_LOG_LEVEL in the preprocessor, so those call
+    sites cost nothing at all (their arguments aren't even evaluated).
+
+    Use them in the render loops. Everywhere else, just use the Logger.
+*/
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+#define LOG_LEVEL_VERBOSE 5
+
+// Default to the same level as the rest of the creature
+#ifndef CLOCKY_LOG_LEVEL
+#ifdef CREATURE_DEBUG
+#define CLOCKY_LOG_LEVEL CREATURE_DEBUG
+#else
+#define CLOCKY_LOG_LEVEL LOG_LEVEL_INFO
+#endif
+#endif
+
+// Touches the logger (so a file whose only calls got thrown away doesn't warn about it), but nothing else
+#define LOG_NOTHING(logger) \
+    do                      \
+    {                       \
+        (void)(logger);     \
+    } while (0)
+
+/*
+    Only let a call site through once every interval_ms. Each place this is used
+    gets its own timer.
+*/
+#define LOG_RATE_LIMITED(interval_ms, call)                                    \
+    do                                                                         \
+    {                                                                          \
+        static unsigned long _logLastAt = 0;                                   \
+        static boolean _logEver = false;                                       \
+        unsigned long _logNow = millis();                                      \
+        if (!_logEver || _logNow - _logLastAt >= (unsigned long)(interval_ms)) \
+        {                                                                      \
+            _logEver = true;                                                   \
+            _logLastAt = _logNow;                                              \
+            call;                                                              \
+        }                                                                      \
+    } while (0)
+
+#if CLOCKY_LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(logger, ...) (logger).error(__VA_ARGS__)
+#define LOG_ERROR_EVERY(logger, interval_ms, ...) LOG_RATE_LIMITED(interval_ms, (logger).error(__VA_ARGS__))
+#else
+#define LOG_ERROR(logger, ...) LOG_NOTHING(logger)
+#define LOG_ERROR_EVERY(logger, interval_ms, ...) LOG_NOTHING(logger)
+#endif
+
+#if CLOCKY_LOG_LEVEL >= LOG_LEVEL_WARNING
+#define LOG_WARNING(logger, ...) (logger).warning(__VA_ARGS__)
+#define LOG_WARNING_EVERY(logger, interval_ms, ...) LOG_RATE_LIMITED(interval_ms, (logger).warning(__VA_ARGS__))
+#else
+#define LOG_WARNING(logger, ...) LOG_NOTHING(logger)
+#define LOG_WARNING_EVERY(logger, interval_ms, ...) LOG_NOTHING(logger)
+#endif
+
+#if CLOCKY_LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(logger, ...) (logger).info(__VA_ARGS__)
+#define LOG_INFO_EVERY(logger, interval_ms, ...) LOG_RATE_LIMITED(interval_ms, (logger).info(__VA_ARGS__))
+#else
+#define LOG_INFO(logger, ...) LOG_NOTHING(logger)
+#define LOG_INFO_EVERY(logger, interval_ms, ...) LOG_NOTHING(logger)
+#endif
+
+#if CLOCKY_LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(logger, ...) (logger).debug(__VA_ARGS__)
+#define LOG_DEBUG_EVERY(logger, interval_ms, ...) LOG_RATE_LIMITED(interval_ms, (logger).debug(__VA_ARGS__))
+#else
+#define LOG_DEBUG(logger, ...) LOG_NOTHING(logger)
+#define LOG_DEBUG_EVERY(logger, interval_ms, ...) LOG_NOTHING(logger)
+#endif
+
+#if CLOCKY_LOG_LEVEL >= LOG_LEVEL_VERBOSE
+#define LOG_VERBOSE(logger, ...) (logger).verbose(__VA_ARGS__)
+#define LOG_VERBOSE_EVERY(logger, interval_ms, ...) LOG_RATE_LIMITED(interval_ms, (logger).verbose(__VA_ARGS__))
+#else
+#define LOG_VERBOSE(logger, ...) LOG_NOTHING(logger)
+#define LOG_VERBOSE_EVERY(logger, interval_ms, ...) LOG_NOTHING(logger)
+#endif
@@ -24,102 +24,157 @@ extern "C"
 #include "mdns/magicbroker.h"
 
 #include "creature.h"
+#include "clock_config.h"
 #include "config.h"
+#include "boot.h"
+#include "civil_time.h"
+#include "clock_face.h"
+#include "commands.h"
+#include "config_store.h"
+#include "fleet_sync.h"
+#include "message_router.h"
 #include "ota.h"
 #include "seconds_ring.h"
+#include "shadow_display.h"
+#include "show_time.h"
+#include "telemetry.h"
+#include "time_discipline.h"
+#include "warm_start.h"
 
 using namespace creatures;
 
 extern TaskHandle_t secondRingTaskHandle;
 
-TaskHandle_t showTimeTaskHandler;
-TaskHandle_t timeSyncTaskhandler;
 TaskHandle_t messageReaderTaskHandle;
-portTASK_FUNCTION_PROTO(showTimeTask, pvParameters);
-portTASK_FUNCTION_PROTO(timeSyncTask, pvParameters);
+TaskHandle_t telemetryTaskHandle;
 portTASK_FUNCTION_PROTO(messageQueueReaderTask, pvParameters);
+static void handleConfigMessage(const char *payload, size_t length);
+static void handleFleetSyncMessage(const char *payload, size_t length);
 
 static Logger l = Logger();
 static MQTT mqtt = MQTT(String(CREATURE_NAME));
-Adafruit_7segment display = Adafruit_7segment();
-
-// Configuration
-uint8_t gScreenBrightness = 1; // 0 - 15, 15 is brightest
-boolean gBlinkColon = true;    // Should the colon blink?
-boolean gDisplayOn = true;     // Should the display be on? (So I can turn it off while we're watching movies!)
 
 // Keep track of our mDNS provider
 CreatureMDNS* creatureMDNS;
 
-void setup()
-{
-    /*
-        Since this Creature has it's own display, let's bring it up _before_ we
-        start even logging, and use the display to show what phase of the boot
-        process we're in.
-    */
-
-    int bootPhase = 0;
-    display.begin(0x70);
-    display.setBrightness(gScreenBrightness);
 
-    display.print(bootPhase++);
-    display.writeDisplay();
+/*
+    The boot stages, and what each one needs before it can start
+*/
+enum
+{
+    BOOT_WIFI,
+    BOOT_MDNS,
+    BOOT_TIME,
+    BOOT_BROKER,
+    BOOT_MQTT,
+    BOOT_OTA,
+    BOOT_CLOCK,
+    BOOT_STAGE_COUNT
+};
 
-    l.init();
-    l.debug("Logging running!");
-    display.print(bootPhase++);
-    display.writeDisplay();
+#define BOOT_ALL_STAGES (BOOT_AFTER(BOOT_STAGE_COUNT) - 1)
 
-    pinMode(LED_BUILTIN, OUTPUT);
-    digitalWrite(LED_BUILTIN, HIGH);
-    display.print(bootPhase++);
-    display.writeDisplay();
-
-    l.info("Helllllo! I'm up and running on on %s!", ARDUINO_VARIANT);
+static MagicBroker magicBroker;
 
+static void bootWiFi()
+{
     NetworkConnection network = NetworkConnection();
     network.connectToWiFi();
-    display.print(bootPhase++);
-    display.writeDisplay();
+}
 
+static void bootMDNS()
+{
     // Register ourselves in mDNS
     creatureMDNS = new CreatureMDNS(CREATURE_NAME, CREATURE_POWER);
     creatureMDNS->registerService(666);
     creatureMDNS->addStandardTags();
-    display.print(bootPhase++);
-    display.writeDisplay();
+    creatureMDNS->addServiceText(String("number_of_pixels"), String(NUMBER_OF_PIXELS));
+    creatureMDNS->addServiceText(String("number_of_strips"), String(LED_RING_STRIPS));
+}
+
+static void bootTime()
+{
+    // Keep the clock in line once SNTP gets going, without jumping it around
+    l.debug("starting the time discipline task");
+    xTaskCreatePinnedToCore(timeDisciplineTask,
+                            "timeDisciplineTask",
+                            4096,
+                            NULL,
+                            1,
+                            &timeDisciplineTaskHandle,
+                            0);
 
     // Set the initial time. Important for a clock! :)
     Time time = Time();
     time.init();
     time.obtainTime();
-    display.print(bootPhase++);
-    display.writeDisplay();
 
+    // The display uses its own DST rules, so make sure they match the TZ that just got set
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    if (!checkCivilTimeZone(now.tv_sec))
+    {
+        l.error("CIVIL_TIME_UTC_OFFSET/CIVIL_TIME_US_DST don't match TZ (%u times were off, first at %lld), using localtime_r() instead",
+                civilTimeZoneStats.mismatches,
+                (long long)civilTimeZoneStats.firstMismatch);
+    }
+}
+
+static void bootBroker()
+{
     // Get the location of the magic broker
-    MagicBroker magicBroker;
     magicBroker.find();
-    display.print(bootPhase++);
-    display.writeDisplay();
+}
 
+static void bootMQTT()
+{
     // Connect to MQTT
     mqtt.connect(magicBroker.ipAddress, magicBroker.port);
+    registerTopicHandler("cmd", TOPIC_LOCAL, handleCommand, TOPIC_NO_FLAGS);
+    registerTopicHandler("config", TOPIC_LOCAL, handleConfigMessage, TOPIC_COALESCE);
+    registerTopicHandler("config/msgpack", TOPIC_LOCAL, handleConfigMessage, TOPIC_COALESCE | TOPIC_BINARY);
     mqtt.subscribe(String("cmd"), 0);
     mqtt.subscribe(String("config"), 0);
+    mqtt.subscribe(String("config/msgpack"), 0);
+
+    // Every clock in the room hears this one, so they can all match
+    registerTopicHandler(FLEET_SYNC_TOPIC, TOPIC_GLOBAL, handleFleetSyncMessage, TOPIC_COALESCE);
+    mqtt.subscribeGlobalNamespace(String(FLEET_SYNC_TOPIC), 0);
 
     mqtt.startHeartbeat();
-    display.print(bootPhase++);
-    display.writeDisplay();
 
+    // Start the task to read the queue
+    l.debug("starting the message reader task");
+    xTaskCreatePinnedToCore(messageQueueReaderTask,
+                            "messageQueueReaderTask",
+                            20480,
+                            NULL,
+                            1,
+                            &messageReaderTaskHandle,
+                            0);
+
+    // Publish our stats every now and then
+    l.debug("starting the telemetry task");
+    xTaskCreatePinnedToCore(telemetryTask,
+                            "telemetryTask",
+                            4096,
+                            &mqtt,
+                            1,
+                            &telemetryTaskHandle,
+                            0);
+}
+
+static void bootOTA()
+{
     // Enable OTA
     setup_ota(String(CREATURE_NAME));
     start_ota();
-    display.print(bootPhase++);
-    display.writeDisplay();
-
-    digitalWrite(LED_BUILTIN, LOW);
+}
 
+static void bootClock()
+{
+    // The time is good, so the ring can go. No need to wait on the broker!
     l.debug("starting the second ring task");
     xTaskCreatePinnedToCore(secondRingTask,
                             "secondRingTask",
@@ -128,7 +183,16 @@ void setup()
                             1,
                             &secondRingTaskHandle,
                             1);
+}
 
+/**
+ * @brief Hands the display over to showTimeTask
+ *
+ * The display isn't thread safe, so this only happens once setup() is done
+ * showing the boot progress on it. There's only ever one task writing to it.
+ */
+static void startShowTime()
+{
     l.debug("starting the show time task");
     xTaskCreatePinnedToCore(showTimeTask,
                             "showTimeTask",
@@ -137,188 +201,173 @@ void setup()
                             1,
                             &showTimeTaskHandler,
                             0);
-
-    // Start the task to read the queue
-    l.debug("starting the message reader task");
-    xTaskCreatePinnedToCore(messageQueueReaderTask,
-                            "messageQueueReaderTask",
-                            20480,
-                            NULL,
-                            1,
-                            &messageReaderTaskHandle,
-                            0);
-
-    l.info("All booted!");
 }
 
-void loop()
+/**
+ * @brief Shows how far along the boot is
+ *
+ * If we came back from a reboot with a good guess at the time, show that
+ * instead. SNTP will sort out if it was right once it's up.
+ */
+static void showBootProgress(int phase)
 {
-    vTaskDelete(NULL);
+    if (getWarmStartStatus() != WARM_START_TIME)
+    {
+        display.print(phase);
+        display.writeDisplay();
+        return;
+    }
+
+    ClockConfig config;
+    getClockConfig(config);
+    if (!config.displayOn)
+    {
+        display.print("");
+        display.writeDisplay();
+        return;
+    }
+
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    CivilTime local = toCivilTime(now.tv_sec);
+    ClockFace face = makeClockFace(local.hour, local.minute, local.second, config.blinkColon);
+
+    display.print(face.time);
+    display.writeDigitRaw(2, face.colonSegments);
+    display.writeDisplay();
+    markWarmTimeDisplayed();
 }
 
-portTASK_FUNCTION(showTimeTask, pvParameters)
-{
+static const BootStage bootStages[BOOT_STAGE_COUNT] = {
+    {"wifi", 0, bootWiFi},
+    {"mdns", BOOT_AFTER(BOOT_WIFI), bootMDNS},
+    {"time", BOOT_AFTER(BOOT_WIFI), bootTime},
+    {"broker", BOOT_AFTER(BOOT_MDNS), bootBroker},
+    {"mqtt", BOOT_AFTER(BOOT_BROKER), bootMQTT},
+    {"ota", BOOT_AFTER(BOOT_MDNS), bootOTA},
+    {"clock", BOOT_AFTER(BOOT_TIME) | BOOT_AFTER(BOOT_MDNS), bootClock},
+};
 
-    l.info("Show Time Task started");
+void setup()
+{
+    /*
+        Since this Creature has it's own display, let's bring it up _before_ we
+        start even logging, and use the display to show what phase of the boot
+        process we're in.
+    */
 
-    Time time = Time();
+    /*
+        Pick up where we left off before a reboot if we can. That gets us the config,
+        and maybe a good enough guess at the time to show until SNTP is up. If not,
+        use the last config we were sent until MQTT gives us the current one.
+    */
+    WarmStartStatus warmStartStatus = warmStart();
+    StoredConfigStatus storedConfigStatus = STORED_CONFIG_MISSING;
+    if (warmStartStatus == WARM_START_NONE)
+    {
+        storedConfigStatus = loadStoredConfig();
+    }
 
-    int refreshRate = 100;   // Refresh rate in ms
-    int colonBlinkRate = 10; // How many ticks to flip the colons?
+    ClockConfig config;
+    getClockConfig(config);
 
-    boolean showColon = true;
+    int bootPhase = 0;
+    display.begin(0x70);
+    display.setBrightness(config.screenBrightness);
 
-    // Seed the last time with right now
-    int lastTime = atoi(time.getCurrentTime("%H%M").c_str());
+    showBootProgress(bootPhase++);
 
-    int cycle = 0;
-    for (;;)
+    l.init();
+    l.debug("Logging running!");
+    l.info("warm start status: %d, stored config status: %d", warmStartStatus, storedConfigStatus);
+    if (warmStartStatus == WARM_START_TIME)
     {
-        if (gDisplayOn)
-        {
+        l.info("showing the time from before the reboot, give or take %ums", getWarmStartUncertaintyMs());
+    }
+    showBootProgress(bootPhase++);
 
-            int currentTime = atoi(time.getCurrentTime("%H%M").c_str());
-
-            // Should we signal to the second ring to start?
-            if (currentTime != lastTime)
-            {
-                xTaskNotify(secondRingTaskHandle, 0, eNoAction);
-                lastTime = currentTime;
-                l.debug("signaled to the second ring to go (%d)", currentTime);
-            }
-
-            // If the time is less than 1200, it's AM.
-            boolean isAm = true;
-
-            if (currentTime >= 1200)
-            {
-                isAm = false;
-            }
-
-            // I like the time in 12 hour time, so let's convert
-            if (isAm)
-            {
-                if (currentTime < 100)
-                {
-                    // Normalize 00:xx -> 12:xx
-                    currentTime += 1200;
-                }
-            }
-            else
-            {
-                // And normalize the PM time
-                if (currentTime > 1259)
-                {
-                    currentTime -= 1200;
-                }
-            }
-
-            // Print the time
-            display.print(currentTime);
-
-            uint8_t amPmMarker = 0x00;
-            // Which light for AM/PM?
-            if (isAm)
-            {
-                amPmMarker = 0x04;
-            }
-            else
-            {
-                amPmMarker = 0x08;
-            }
-
-            // Flip the colon on the right interval
-            if (gBlinkColon)
-            {
-                if (cycle++ > colonBlinkRate)
-                {
-                    showColon = !showColon;
-                    cycle = 0;
-                }
-            }
-            else
-            {
-                showColon = true;
-            }
-
-            // Bit 0x02 is the colon, and position 2 is the colons
-            if (showColon)
-            {
-                display.writeDigitRaw(2, amPmMarker | 0x02);
-            }
-            else
-            {
-                display.writeDigitRaw(2, amPmMarker);
-            }
-
-        } // gDisplayOn
-        else
-        {
-            // Show nothing if the display is off
-            display.print("");
-        }
+    pinMode(LED_BUILTIN, OUTPUT);
+    digitalWrite(LED_BUILTIN, HIGH);
+    showBootProgress(bootPhase++);
 
-        display.setBrightness(gScreenBrightness);
-        display.writeDisplay();
+    l.info("Helllllo! I'm up and running on on %s!", ARDUINO_VARIANT);
+
+    startBootPipeline(bootStages, BOOT_STAGE_COUNT);
 
-        vTaskDelay(pdMS_TO_TICKS(refreshRate));
+    // Count up the finished stages on the display (or keep the time going) until the clock can take it over
+    while (!waitForBootStages(BOOT_AFTER(BOOT_CLOCK), pdMS_TO_TICKS(100)))
+    {
+        showBootProgress(bootPhase + getBootStagesDone());
     }
+
+    // Done with the display, so now showTimeTask can have it
+    startShowTime();
+
+    waitForBootStages(BOOT_ALL_STAGES, portMAX_DELAY);
+
+    digitalWrite(LED_BUILTIN, LOW);
+
+    l.info("All booted!");
+}
+
+void loop()
+{
+    vTaskDelete(NULL);
 }
 
 /**
- * @brief Handle incoming messages from MQTT
+ * @brief Handle config messages from MQTT
  *
  * It wouldn't be a network connected clock if I can't update the config on the
  * fly from Home Assistant! :)
  */
-portTASK_FUNCTION(messageQueueReaderTask, pvParameters)
+static void handleConfigMessage(const char *payload, size_t length)
 {
+    l.info("Got a config message from MQTT (%u bytes)", (unsigned int)length);
 
-    QueueHandle_t incomingQueue = mqtt.getIncomingMessageQueue();
-    for (;;)
+    if (updateConfig(payload, length))
     {
-        struct MqttMessage message;
-        if (xQueueReceive(incomingQueue, &message, (TickType_t)5000) == pdPASS)
+        // Let the display pick up the change right away (if it's running yet)
+        if (showTimeTaskHandler != NULL)
         {
-            l.debug("Incoming message! local topic: %s, global topic: %s, payload: %s",
-                    message.topic,
-                    message.topicGlobalNamespace,
-                    message.payload);
-
-            // Is this a config message?
-            if (strncmp("config", message.topic, strlen(message.topic)) == 0)
-            {
-                l.info("Got a config message from MQTT: %s", message.payload);
-                updateConfig(String(message.payload));
-            }
-            else
-            {
-                l.warning("unexpected MQTT message! topic %s", message.topic);
-            }
+            xTaskNotifyGive(showTimeTaskHandler);
         }
     }
 }
 
 /**
- * @brief Ensures the time stays in sync
- *
- * Tells the time class to re-sync itself every now and then to make
- * sure we're set to the exact right time.
+ * @brief Handle the fleet's ring schedule
  *
+ * The ring re-locks to the new schedule right away instead of waiting for the
+ * next minute.
  */
-portTASK_FUNCTION(timeSyncTask, pvParameters)
+static void handleFleetSyncMessage(const char *payload, size_t length)
 {
-    l.debug("starting time sync task");
+    if (updateFleetSchedule(payload, length))
+    {
+        restartSecondRing();
+    }
+}
 
-    uint16_t resyncTimeInMs = 15 * 1000;
+/**
+ * @brief Handle incoming messages from MQTT
+ *
+ * The router works out who gets each message. Config is coalesced, since
+ * dragging a slider in Home Assistant sends a whole pile of them at once and
+ * only the last one matters.
+ *
+ * Config can come in as JSON on config, or as MessagePack on config/msgpack
+ * (a binary topic, since MessagePack has zeros in it).
+ */
+portTASK_FUNCTION(messageQueueReaderTask, pvParameters)
+{
 
-    Time time = Time();
+    QueueHandle_t incomingQueue = mqtt.getIncomingMessageQueue();
     for (;;)
     {
-        vTaskDelay(pdMS_TO_TICKS(resyncTimeInMs));
+        // Save the config to NVS once it's settled down
+        flushStoredConfig();
 
-        l.debug("Refreshing time from SNTP");
-        time.obtainTime();
-        l.info("Refreshed the time from SNTP");
+        routeMessages(incomingQueue, (TickType_t)5000);
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,254 @@
+
+#include <Arduino.h>
+
+extern "C"
+{
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+}
+
+#include "logging/logging.h"
+#include "log_macros.h"
+#include "mqtt/mqtt.h"
+
+#include "message_router.h"
+
+using namespace creatures;
+
+static Logger l;
+
+MessageStats messageStats;
+
+struct TopicRoute
+{
+    const char *topic; // NULL if the slot is empty
+    uint32_t hash;
+    TopicNamespace space;
+    TopicHandler handler;
+    int8_t coalesced; // Which pending slot this topic uses, or -1 if it isn't coalesced
+    boolean binary;
+};
+
+static TopicRoute routes[MESSAGE_ROUTER_SLOTS];
+static uint8_t coalescedTopics = 0;
+
+/*
+    Every coalesced topic might be holding on to a message at the end of a batch, and
+    we need one more to receive the next one into. Holding on to a message is just
+    remembering its index, so nothing big ever gets copied.
+
+    The held messages get handled in the order they showed up, not the order their
+    topics landed in the table. Two topics can share a handler ("config" and
+    "config/msgpack" do), and the newer message has to be the one that sticks.
+*/
+static struct MqttMessage messages[MESSAGE_ROUTER_MAX_COALESCED + 1];
+static int8_t pending[MESSAGE_ROUTER_MAX_COALESCED];
+static const TopicRoute *pendingRoute[MESSAGE_ROUTER_MAX_COALESCED];
+static uint32_t pendingArrival[MESSAGE_ROUTER_MAX_COALESCED];
+static uint32_t arrivals = 0;
+
+uint32_t boundedTopicHash(const char *topic, size_t length)
+{
+    uint32_t hash = FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < length && topic[i] != '\0'; i++)
+    {
+        hash = (hash ^ (uint8_t)topic[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * @brief Finds the route for a topic
+ *
+ * @return TopicRoute* the route, or NULL if nobody registered that topic
+ */
+static TopicRoute *findRoute(const char *topic, size_t length, TopicNamespace space)
+{
+    uint32_t hash = boundedTopicHash(topic, length);
+
+    for (uint8_t probe = 0; probe < MESSAGE_ROUTER_SLOTS; probe++)
+    {
+        TopicRoute &route = routes[(hash + probe) & (MESSAGE_ROUTER_SLOTS - 1)];
+        if (route.topic == NULL)
+        {
+            return NULL;
+        }
+
+        if (route.hash == hash && route.space == space &&
+            strncmp(route.topic, topic, length) == 0 && route.topic[strnlen(topic, length)] == '\0')
+        {
+            return &route;
+        }
+    }
+
+    return NULL;
+}
+
+boolean registerTopicHandler(const char *topic, TopicNamespace space, TopicHandler handler, uint8_t flags)
+{
+    boolean coalesce = (flags & TOPIC_COALESCE) != 0;
+
+    if (findRoute(topic, strlen(topic), space) != NULL)
+    {
+        l.error("'%s' already has a handler", topic);
+        return false;
+    }
+
+    if (coalesce && coalescedTopics >= MESSAGE_ROUTER_MAX_COALESCED)
+    {
+        l.error("too many coalesced topics to add '%s'", topic);
+        return false;
+    }
+
+    uint32_t hash = topicHash(topic);
+    for (uint8_t probe = 0; probe < MESSAGE_ROUTER_SLOTS; probe++)
+    {
+        TopicRoute &route = routes[(hash + probe) & (MESSAGE_ROUTER_SLOTS - 1)];
+        if (route.topic == NULL)
+        {
+            route.topic = topic;
+            route.hash = hash;
+            route.space = space;
+            route.handler = handler;
+            route.coalesced = coalesce ? coalescedTopics++ : -1;
+            route.binary = (flags & TOPIC_BINARY) != 0;
+
+            l.debug("registered a handler for '%s' (%s)", topic, space == TOPIC_LOCAL ? "local" : "global");
+            return true;
+        }
+    }
+
+    l.error("no room in the router for '%s'", topic);
+    return false;
+}
+
+/**
+ * @brief Hands a message to its route's handler
+ */
+static void handleMessage(const TopicRoute &route, const struct MqttMessage &message)
+{
+    size_t length = route.binary ? sizeof(message.payload) : strnlen(message.payload, sizeof(message.payload));
+
+    messageStats.handled++;
+    route.handler(message.payload, length);
+}
+
+/**
+ * @brief Finds a message buffer that nobody's holding on to
+ */
+static uint8_t freeMessage()
+{
+    for (uint8_t i = 0; i < MESSAGE_ROUTER_MAX_COALESCED + 1; i++)
+    {
+        boolean held = false;
+        for (uint8_t j = 0; j < coalescedTopics; j++)
+        {
+            held |= pending[j] == i;
+        }
+
+        if (!held)
+        {
+            return i;
+        }
+    }
+
+    // Can't happen, there's always one more buffer than coalesced topics
+    return 0;
+}
+
+/**
+ * @brief Works out who a message is for, and either handles it or holds on to it
+ */
+static void routeMessage(uint8_t index)
+{
+    struct MqttMessage &message = messages[index];
+    messageStats.received++;
+
+    LOG_DEBUG(l, "Incoming message! local topic: %s, global topic: %s",
+              message.topic,
+              message.topicGlobalNamespace);
+
+    TopicRoute *route = findRoute(message.topic, sizeof(message.topic), TOPIC_LOCAL);
+    if (route == NULL)
+    {
+        route = findRoute(message.topicGlobalNamespace, sizeof(message.topicGlobalNamespace), TOPIC_GLOBAL);
+    }
+
+    if (route == NULL)
+    {
+        messageStats.unrouted++;
+        l.warning("unexpected MQTT message! topic %s", message.topic);
+        return;
+    }
+
+    // Just remember it, a newer one might be right behind it
+    if (route->coalesced >= 0)
+    {
+        if (pending[route->coalesced] >= 0)
+        {
+            messageStats.coalesced++;
+        }
+        pending[route->coalesced] = index;
+        pendingRoute[route->coalesced] = route;
+        pendingArrival[route->coalesced] = arrivals++;
+        return;
+    }
+
+    handleMessage(*route, message);
+}
+
+void routeMessages(QueueHandle_t queue, TickType_t wait)
+{
+    for (uint8_t i = 0; i < MESSAGE_ROUTER_MAX_COALESCED; i++)
+    {
+        pending[i] = -1;
+    }
+    arrivals = 0;
+
+    uint8_t incoming = freeMessage();
+    if (xQueueReceive(queue, &messages[incoming], wait) != pdPASS)
+    {
+        return;
+    }
+
+    messageStats.batches++;
+    TickType_t batchStart = xTaskGetTickCount();
+    TickType_t batchWindow = pdMS_TO_TICKS(MESSAGE_BATCH_WINDOW_MS);
+
+    do
+    {
+        routeMessage(incoming);
+        incoming = freeMessage();
+
+        TickType_t elapsed = xTaskGetTickCount() - batchStart;
+        if (elapsed >= batchWindow)
+        {
+            break;
+        }
+        batchWindow -= elapsed;
+        batchStart += elapsed;
+
+    } while (xQueueReceive(queue, &messages[incoming], batchWindow) == pdPASS);
+
+    // Now handle the newest message on each coalesced topic, oldest first
+    while (true)
+    {
+        int8_t next = -1;
+        for (uint8_t i = 0; i < coalescedTopics; i++)
+        {
+            if (pending[i] >= 0 && (next < 0 || pendingArrival[i] < pendingArrival[next]))
+            {
+                next = i;
+            }
+        }
+
+        if (next < 0)
+        {
+            break;
+        }
+
+        handleMessage(*pendingRoute[next], messages[pending[next]]);
+        pending[next] = -1;
+    }
+}
@@ -0,0 +1,122 @@
+
+#pragma once
+
+#include <Arduino.h>
+
+extern "C"
+{
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+}
+
+#include "mqtt/mqtt.h"
+
+/*
+    Picks what to do with each message that comes in from MQTT
+
+    Modules register a handler for each topic they care about, either in our
+    own namespace (like "config") or in the global one. Topics are FNV-1a
+    hashed into a small open-addressed table, so finding the handler for a
+    message is one pass over the topic and (almost always) one slot, no matter
+    how many topics there are. The whole topic is compared after the hash
+    matches, so "conf" doesn't get mistaken for "config".
+
+    topicHash() is constexpr, so a handler can switch() on a hash worked out
+    at compile time (see commands.cpp). Two strings with the same hash in one
+    switch won't even compile.
+*/
+
+// How many topics can have handlers (needs to be a power of two)
+#define MESSAGE_ROUTER_SLOTS 16
+
+// How many topics can be coalesced (see registerTopicHandler())
+#define MESSAGE_ROUTER_MAX_COALESCED 3
+
+// Once a message shows up, keep collecting more for this long before acting on them
+#define MESSAGE_BATCH_WINDOW_MS 50
+
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+/**
+ * @brief FNV-1a hash of a null terminated string, at compile time if it can be
+ */
+constexpr uint32_t topicHash(const char *topic, uint32_t hash = FNV_OFFSET_BASIS)
+{
+    return *topic == '\0' ? hash : topicHash(topic + 1, (hash ^ (uint8_t)*topic) * FNV_PRIME);
+}
+
+/**
+ * @brief FNV-1a hash of a string that might not be null terminated
+ *
+ * Gives the same answer as topicHash() for the same characters. (It can't be an
+ * overload of it, size_t and uint32_t are the same type on the ESP32.)
+ */
+uint32_t boundedTopicHash(const char *topic, size_t length);
+
+enum TopicNamespace
+{
+    TOPIC_LOCAL, // Under our creature name
+    TOPIC_GLOBAL // Shared with everyone else
+};
+
+// How to handle a topic (see registerTopicHandler())
+#define TOPIC_NO_FLAGS 0x00
+#define TOPIC_COALESCE 0x01 // Only the newest message in each batch is handled
+#define TOPIC_BINARY 0x02   // The payload isn't text, so hand over the whole buffer
+
+/**
+ * @brief Something that handles messages on a topic
+ *
+ * @param payload The message (doesn't need to be null terminated)
+ * @param length How long the message is, or how big the buffer it's in is for a TOPIC_BINARY topic
+ */
+typedef void (*TopicHandler)(const char *payload, size_t length);
+
+/**
+ * @brief How much work the incoming MQTT messages are making
+ *
+ * Messages on coalesced topics that show up in a burst get collapsed into one,
+ * so handled is usually a lot smaller than received.
+ */
+struct MessageStats
+{
+    uint32_t received;  // Every message off the queue
+    uint32_t batches;   // How many times the reader woke up and drained the queue
+    uint32_t coalesced; // Messages that were replaced by a newer one on the same topic
+    uint32_t handled;   // Messages that got passed to a handler
+    uint32_t unrouted;  // Messages on a topic nobody registered
+};
+
+extern MessageStats messageStats;
+
+/**
+ * @brief Registers a handler for a topic
+ *
+ * Register everything before starting routeMessages().
+ *
+ * @param topic The topic (needs to stick around, a string literal is perfect)
+ * @param space Which namespace the topic is in
+ * @param handler What to call with each message
+ * @param flags Any of the TOPIC_ flags. TOPIC_COALESCE is good for things like
+ *              config, where only the last one matters. TOPIC_BINARY is for
+ *              things like MessagePack that can have zeros in them, so the
+ *              length can't come from strlen(). The handler needs to be able
+ *              to tell where its message ends on its own.
+ * @return true if it was registered
+ * @return false if the table is full or the topic already has a handler
+ */
+boolean registerTopicHandler(const char *topic, TopicNamespace space, TopicHandler handler, uint8_t flags);
+
+/**
+ * @brief Waits for messages and hands them to their handlers
+ *
+ * Once a message shows up, this keeps draining the queue for
+ * MESSAGE_BATCH_WINDOW_MS. Messages on normal topics are handled as they come
+ * in, and only the newest one on each coalesced topic is handled at the end,
+ * in the order those messages arrived.
+ *
+ * @param queue The MQTT incoming message queue
+ * @param wait How long to wait for the first message
+ */
+void routeMessages(QueueHandle_t queue, TickType_t wait);
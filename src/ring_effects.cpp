@@ -0,0 +1,66 @@
+
+#include <Arduino.h>
+
+#include "logging/logging.h"
+#include "log_macros.h"
+
+#include "ring_effects.h"
+
+using namespace creatures;
+
+static Logger l;
+
+const char *const ringEffectNames[RING_EFFECT_COUNT + 1] = {
+    "wipe",
+    "comet",
+    "breathing",
+    "gradient",
+    NULL};
+
+volatile uint32_t ringEffectFramesOverBudget = 0;
+
+/**
+ * @brief Builds the colour of every step in a fade between two hues
+ *
+ * The result is one pixel of 8.8 fixed point levels (3 of them, in the ring's
+ * byte order) per step, so step `n` starts at `frames + (n * 3)`. Steps 1 through STEPS_PER_PIXEL line
+ * up with the `currentStep` values in the ring task, and step 0 is the starting
+ * colour.
+ *
+ * @param frames Where to put the levels ((STEPS_PER_PIXEL + 1) * 3 of them)
+ * @param oldHue Starting hue
+ * @param newHue Finishing hue
+ * @param saturation Saturation to use for every step
+ * @param brightness Brightness to use for every step
+ */
+void buildFadeSchedule(uint16_t *frames, uint16_t oldHue, uint16_t newHue, uint8_t saturation, uint8_t brightness)
+{
+    uint16_t hues[STEPS_PER_PIXEL + 1];
+    for (uint8_t step = 0; step <= STEPS_PER_PIXEL; step++)
+    {
+        hues[step] = interpolateHue(oldHue, newHue, STEPS_PER_PIXEL, step);
+    }
+
+    renderHsvLevels<STEPS_PER_PIXEL + 1, LED_RING_TYPE>(frames, hues, saturation, brightness);
+}
+
+/**
+ * @brief Returns the requested step in a fade between two hues
+ *
+ * @param oldColor Starting hue
+ * @param newColor Finishing hue
+ * @param totalSteps How many steps are we fading
+ * @param currentStep Which one to get
+ * @return uint16_t The hue requested
+ */
+uint16_t interpolateHue(uint16_t oldHue, uint16_t newHue, uint8_t totalSteps, uint8_t currentStep)
+{
+    // How far is it, and which way?
+    int32_t distance = (int32_t)newHue - oldHue;
+
+    // Scale before dividing, so the rounding can't leave the last step short
+    uint16_t stepHue = oldHue + (distance * currentStep) / totalSteps;
+    LOG_VERBOSE(l, "old: %d, new: %d, distance: %d, current: %d", oldHue, newHue, (int)distance, stepHue);
+
+    return stepHue;
+}
@@ -0,0 +1,301 @@
+
+#pragma once
+
+#include <Arduino.h>
+
+#include "color.h"
+#include "frame_stats.h"
+#include "seconds_ring.h"
+
+/*
+    Animations for the second ring
+
+    Each effect is a struct with two static functions, specialized on the number
+    of pixels so everything is sized at compile time:
+
+        begin()  - called when a minute starts (or the settings change). Do any
+                   expensive work (tables, colours) here.
+        render() - called every frame to draw the ring. redraw is true when the
+                   levels can't be trusted to still have the last frame in them
+                   (like after skipping frames), so draw everything.
+
+    Effects draw 8.8 fixed point levels (see scaleChannel16()), three per pixel
+    in the strip's byte order, not bytes. The ring turns them into bytes, and
+    can dither the fractions when it's running fast enough.
+
+    Each one also says how many CPU cycles render() can take on the board, with
+    every frame a redraw. The budgets come from timing the effects on the host
+    (see test_ring_effects, which holds them to it), scaled up to the ESP32 and
+    with half again on top. Build with RING_EFFECT_CHECK_BUDGET to have the ring
+    count the frames that go over on the board too. That's off normally, since
+    it's two more trips to the cycle counter every frame.
+
+    There's no virtual dispatch and nothing is allocated; renderRingEffect()
+    picks the effect with a switch, and the compiler can inline all of it.
+*/
+
+enum RingEffect
+{
+    RING_EFFECT_WIPE,      // Each pixel fades to a new colour, one per second
+    RING_EFFECT_COMET,     // A bright head goes around once a minute with a fading tail
+    RING_EFFECT_BREATHING, // The whole ring slowly breathes in the new colour
+    RING_EFFECT_GRADIENT,  // A gradient from the old colour to the new, with a bright seconds hand
+    RING_EFFECT_COUNT
+};
+
+// The names used in the config, in the same order as RingEffect, ending with NULL
+extern const char *const ringEffectNames[RING_EFFECT_COUNT + 1];
+
+// How long the comet's tail is, in pixels
+#define COMET_TAIL_PIXELS 8
+
+// How long one breath is, in frames
+#define BREATH_FRAMES (4 * STEPS_PER_PIXEL)
+
+/**
+ * @brief What the effects need to know, and what they keep between frames
+ */
+template <uint16_t PIXELS>
+struct RingEffectState
+{
+    // Set before begin()
+    uint16_t oldHue;
+    uint16_t newHue;
+    uint8_t saturation;
+    uint8_t brightness;
+
+    // Wipe
+    uint16_t schedule[(STEPS_PER_PIXEL + 1) * 3];
+    uint16_t lastPixel;
+
+    // Comet and breathing, the new colour at full brightness
+    uint16_t red;
+    uint16_t green;
+    uint16_t blue;
+
+    // Gradient
+    uint16_t dim[PIXELS * 3];
+    uint16_t bright[PIXELS * 3];
+};
+
+uint16_t interpolateHue(uint16_t oldHue, uint16_t newHue, uint8_t totalSteps, uint8_t currentStep);
+void buildFadeSchedule(uint16_t *frames, uint16_t oldHue, uint16_t newHue, uint8_t saturation, uint8_t brightness);
+
+// How many bytes of levels one pixel takes
+#define RING_PIXEL_LEVEL_BYTES (3 * sizeof(uint16_t))
+
+/**
+ * @brief Writes one pixel's levels from 16 bit linear channels at a brightness
+ */
+inline void setRingLevel(uint16_t *level, uint16_t red, uint16_t green, uint16_t blue, uint8_t brightness)
+{
+    level[(LED_RING_TYPE >> 4) & 0x03] = scaleChannel16(red, brightness);
+    level[(LED_RING_TYPE >> 2) & 0x03] = scaleChannel16(green, brightness);
+    level[LED_RING_TYPE & 0x03] = scaleChannel16(blue, brightness);
+}
+
+/**
+ * @brief The golden-ratio hue wipe, one pixel per second
+ */
+template <uint16_t PIXELS>
+struct WipeEffect
+{
+    static const uint32_t CYCLE_BUDGET = 3500;
+
+    static void begin(RingEffectState<PIXELS> &state)
+    {
+        buildFadeSchedule(state.schedule, state.oldHue, state.newHue, state.saturation, state.brightness);
+    }
+
+    static void render(RingEffectState<PIXELS> &state, uint16_t *levels, uint16_t frame, boolean redraw)
+    {
+        uint16_t pixel = frame / STEPS_PER_PIXEL;
+        uint8_t currentStep = (frame % STEPS_PER_PIXEL) + 1;
+
+        if (redraw)
+        {
+            // Everything before this pixel is done, everything after hasn't started
+            for (uint16_t i = 0; i < PIXELS; i++)
+            {
+                const uint16_t *colour = state.schedule + (i < pixel ? STEPS_PER_PIXEL * 3 : 0);
+                memcpy(levels + (i * 3), colour, RING_PIXEL_LEVEL_BYTES);
+            }
+        }
+        else if (pixel != state.lastPixel)
+        {
+            // Make sure the pixel we just left finished its fade, even if we skipped its last step
+            memcpy(levels + (state.lastPixel * 3), state.schedule + (STEPS_PER_PIXEL * 3), RING_PIXEL_LEVEL_BYTES);
+        }
+        state.lastPixel = pixel;
+
+        memcpy(levels + (pixel * 3), state.schedule + (currentStep * 3), RING_PIXEL_LEVEL_BYTES);
+    }
+};
+
+/**
+ * @brief A comet that goes around once a minute
+ */
+template <uint16_t PIXELS>
+struct CometEffect
+{
+    static const uint32_t CYCLE_BUDGET = 9000;
+
+    static void begin(RingEffectState<PIXELS> &state)
+    {
+        hsvToRgb16(state.newHue, state.saturation, state.red, state.green, state.blue);
+    }
+
+    static void render(RingEffectState<PIXELS> &state, uint16_t *levels, uint16_t frame, boolean)
+    {
+        const int32_t tail = COMET_TAIL_PIXELS * STEPS_PER_PIXEL;
+        const int32_t lap = PIXELS * STEPS_PER_PIXEL;
+
+        // Everything is in steps, so the head moves smoothly between pixels
+        for (uint16_t i = 0; i < PIXELS; i++)
+        {
+            int32_t behind = (int32_t)frame - (int32_t)(i * STEPS_PER_PIXEL);
+            if (behind < 0)
+            {
+                behind += lap;
+            }
+
+            uint8_t level = behind < tail ? (uint8_t)(((uint32_t)state.brightness * (tail - behind)) / tail) : 0;
+            setRingLevel(levels + (i * 3), state.red, state.green, state.blue, level);
+        }
+    }
+};
+
+/**
+ * @brief The whole ring breathing in the new colour
+ */
+template <uint16_t PIXELS>
+struct BreathingEffect
+{
+    static const uint32_t CYCLE_BUDGET = 3500;
+
+    static void begin(RingEffectState<PIXELS> &state)
+    {
+        hsvToRgb16(state.newHue, state.saturation, state.red, state.green, state.blue);
+    }
+
+    static void render(RingEffectState<PIXELS> &state, uint16_t *levels, uint16_t frame, boolean)
+    {
+        // A triangle wave from a quarter brightness up to full and back
+        const uint16_t half = BREATH_FRAMES / 2;
+        uint16_t phase = frame % BREATH_FRAMES;
+        uint16_t rise = phase < half ? phase : BREATH_FRAMES - phase;
+
+        uint8_t dimmest = state.brightness / 4;
+        uint8_t level = dimmest + ((uint32_t)(state.brightness - dimmest) * rise) / half;
+
+        uint16_t colour[3];
+        setRingLevel(colour, state.red, state.green, state.blue, level);
+        for (uint16_t i = 0; i < PIXELS; i++)
+        {
+            memcpy(levels + (i * 3), colour, RING_PIXEL_LEVEL_BYTES);
+        }
+    }
+};
+
+/**
+ * @brief A dim gradient from the old hue to the new one, with a bright seconds hand
+ */
+template <uint16_t PIXELS>
+struct GradientEffect
+{
+    static const uint32_t CYCLE_BUDGET = 800;
+
+    static void begin(RingEffectState<PIXELS> &state)
+    {
+        uint16_t hues[PIXELS];
+        uint16_t distance = state.newHue - state.oldHue;
+        for (uint16_t i = 0; i < PIXELS; i++)
+        {
+            hues[i] = state.oldHue + ((uint32_t)distance * i) / PIXELS;
+        }
+
+        uint8_t dimBrightness = state.brightness / 4;
+        if (dimBrightness == 0 && state.brightness > 0)
+        {
+            dimBrightness = 1;
+        }
+
+        renderHsvLevels<PIXELS, LED_RING_TYPE>(state.dim, hues, state.saturation, dimBrightness);
+        renderHsvLevels<PIXELS, LED_RING_TYPE>(state.bright, hues, state.saturation, state.brightness);
+    }
+
+    static void render(RingEffectState<PIXELS> &state, uint16_t *levels, uint16_t frame, boolean)
+    {
+        uint16_t hand = frame / STEPS_PER_PIXEL;
+
+        memcpy(levels, state.dim, sizeof(state.dim));
+        memcpy(levels + (hand * 3), state.bright + (hand * 3), RING_PIXEL_LEVEL_BYTES);
+    }
+};
+
+// How many frames went over their effect's cycle budget (always 0 without RING_EFFECT_CHECK_BUDGET)
+extern volatile uint32_t ringEffectFramesOverBudget;
+
+/**
+ * @brief Runs one effect's begin()
+ */
+template <uint16_t PIXELS>
+inline void beginRingEffect(uint8_t effect, RingEffectState<PIXELS> &state)
+{
+    switch (effect)
+    {
+    case RING_EFFECT_COMET:
+        CometEffect<PIXELS>::begin(state);
+        break;
+    case RING_EFFECT_BREATHING:
+        BreathingEffect<PIXELS>::begin(state);
+        break;
+    case RING_EFFECT_GRADIENT:
+        GradientEffect<PIXELS>::begin(state);
+        break;
+    default:
+        WipeEffect<PIXELS>::begin(state);
+        break;
+    }
+}
+
+/**
+ * @brief Renders one frame of an effect (and checks it against the effect's budget, if that's on)
+ */
+template <typename EFFECT, uint16_t PIXELS>
+inline void renderWithBudget(RingEffectState<PIXELS> &state, uint16_t *levels, uint16_t frame, boolean redraw)
+{
+#ifdef RING_EFFECT_CHECK_BUDGET
+    uint32_t start = FrameStats::startTimer();
+    EFFECT::render(state, levels, frame, redraw);
+    if (FrameStats::cyclesSince(start) > EFFECT::CYCLE_BUDGET)
+    {
+        ringEffectFramesOverBudget++;
+    }
+#else
+    EFFECT::render(state, levels, frame, redraw);
+#endif
+}
+
+/**
+ * @brief Renders one frame of whichever effect is selected
+ */
+template <uint16_t PIXELS>
+inline void renderRingEffect(uint8_t effect, RingEffectState<PIXELS> &state, uint16_t *levels, uint16_t frame, boolean redraw)
+{
+    switch (effect)
+    {
+    case RING_EFFECT_COMET:
+        renderWithBudget<CometEffect<PIXELS> >(state, levels, frame, redraw);
+        break;
+    case RING_EFFECT_BREATHING:
+        renderWithBudget<BreathingEffect<PIXELS> >(state, levels, frame, redraw);
+        break;
+    case RING_EFFECT_GRADIENT:
+        renderWithBudget<GradientEffect<PIXELS> >(state, levels, frame, redraw);
+        break;
+    default:
+        renderWithBudget<WipeEffect<PIXELS> >(state, levels, frame, redraw);
+        break;
+    }
+}
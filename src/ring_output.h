@@ -0,0 +1,227 @@
+
+#pragma once
+
+#include <Arduino.h>
+
+#include "led_driver.h"
+
+/**
+ * @brief One strip of LEDs that makes up part of the ring
+ *
+ * A ring can be split over a few strips (like a minute ring and an hour ring,
+ * or one long ring wired up in sections), each with its own driver. The strips
+ * are laid end to end in the order they're listed, so the first strip gets the
+ * first pixels in the frame.
+ */
+struct RingStrip
+{
+    LedDriver *driver;
+    uint16_t pixels;
+};
+
+/**
+ * @brief Adds up the pixels in a strip layout, at compile time if it can
+ */
+constexpr uint16_t countRingPixels(const uint16_t *stripPixels, uint8_t strips)
+{
+    return strips == 0 ? 0 : stripPixels[0] + countRingPixels(stripPixels + 1, strips - 1);
+}
+
+/**
+ * @brief The most pixels on any one strip, at compile time if it can
+ */
+constexpr uint16_t longestRingStrip(const uint16_t *stripPixels, uint8_t strips)
+{
+    return strips == 0                                                    ? 0
+           : stripPixels[0] > longestRingStrip(stripPixels + 1, strips - 1) ? stripPixels[0]
+                                                                            : longestRingStrip(stripPixels + 1, strips - 1);
+}
+
+// A WS2812 takes 24 bits a pixel, at 1.25us a bit, plus a reset of at least 280us (on the newer ones) after the frame
+#define WS2812_BIT_NS 1250
+#define WS2812_RESET_US 280
+
+/**
+ * @brief How long a strip of WS2812s takes to send a frame, in us
+ */
+constexpr uint32_t ws2812WireTimeUs(uint16_t pixels)
+{
+    return (uint32_t)pixels * 24 * WS2812_BIT_NS / 1000 + WS2812_RESET_US;
+}
+
+/**
+ * @brief Double-buffered, change-only output for the LED ring
+ *
+ * Frames are drawn into a back buffer while the front buffer (the last frame
+ * that went out) is still being clocked out by the drivers in the background.
+ * show() hands the back buffer to the drivers and swaps them, so the task can
+ * go build frame N+1 while frame N is on the wire.
+ *
+ * Pushing a frame to a strip of WS2812s isn't free, and a lot of the steps in
+ * a slow fade come out as the exact same bytes, so show() only sends a strip
+ * its part of the frame when it's actually different from the last one that
+ * went out.
+ *
+ * Each strip has its own driver (and RMT channel), so the strips all get sent
+ * at the same time. A frame takes as long as the longest strip, not all of
+ * them added up.
+ *
+ * After a swap the new back buffer starts out as a copy of what was just sent,
+ * so it's fine to only redraw the pixels that changed.
+ *
+ * @tparam PIXELS How many pixels are in the whole ring
+ * @tparam STRIPS How many strips the pixels are split over
+ */
+template <uint16_t PIXELS, uint8_t STRIPS = 1>
+class RingOutput
+{
+public:
+    /**
+     * @brief A ring that's all on one strip
+     */
+    RingOutput(LedDriver &driver)
+    {
+        static_assert(STRIPS == 1, "a ring with more than one strip needs a strip layout");
+
+        strips[0].driver = &driver;
+        strips[0].pixels = PIXELS;
+        init();
+    }
+
+    /**
+     * @brief A ring that's split over a few strips
+     *
+     * @param layout Each strip, in order. Their pixels have to add up to PIXELS.
+     */
+    RingOutput(const RingStrip (&layout)[STRIPS])
+    {
+        memcpy(strips, layout, sizeof(strips));
+        init();
+    }
+
+    /**
+     * @brief The buffer to draw the next frame into
+     *
+     * @return uint8_t* PIXELS * 3 bytes, in the strip's byte order
+     */
+    uint8_t *getPixels()
+    {
+        return buffers[back];
+    }
+
+    /**
+     * @brief Sends the frame to the strips that changed
+     *
+     * @return true if the frame was pushed to any of them
+     * @return false if it was the same as the last one
+     */
+    boolean show()
+    {
+        uint8_t *front = buffers[back ^ 1];
+        boolean pushed[STRIPS];
+        boolean any = false;
+
+        size_t offset = 0;
+        for (uint8_t i = 0; i < STRIPS; i++)
+        {
+            size_t length = strips[i].pixels * 3;
+            pushed[i] = !hasPushed || memcmp(buffers[back] + offset, front + offset, length) != 0;
+            if (pushed[i])
+            {
+                // The front buffer belongs to the driver until it's done with it
+                if (strips[i].driver->isBusy())
+                {
+                    framesWaited++;
+                    strips[i].driver->waitUntilDone();
+                }
+
+                strips[i].driver->startTransmit(buffers[back] + offset, length);
+                stripsPushed++;
+                any = true;
+            }
+            offset += length;
+        }
+
+        if (!any)
+        {
+            framesSkipped++;
+            return false;
+        }
+
+        /*
+            A strip that didn't change this time might still be sending from the
+            buffer that's about to be the back one, so let it finish before we
+            start drawing over it.
+        */
+        for (uint8_t i = 0; i < STRIPS; i++)
+        {
+            if (!pushed[i] && strips[i].driver->isBusy())
+            {
+                framesWaited++;
+                strips[i].driver->waitUntilDone();
+            }
+        }
+
+        // Swap, and start the next frame off from the one that's going out now
+        back ^= 1;
+        memcpy(buffers[back], buffers[back ^ 1], PIXELS * 3);
+
+        hasPushed = true;
+        framesPushed++;
+        return true;
+    }
+
+    uint8_t getStripCount()
+    {
+        return STRIPS;
+    }
+
+    uint32_t getFramesPushed()
+    {
+        return framesPushed;
+    }
+
+    uint32_t getFramesSkipped()
+    {
+        return framesSkipped;
+    }
+
+    /**
+     * @brief How many times show() had to wait on a previous frame
+     */
+    uint32_t getFramesWaited()
+    {
+        return framesWaited;
+    }
+
+    /**
+     * @brief How many strips got sent something, over all of the frames
+     */
+    uint32_t getStripsPushed()
+    {
+        return stripsPushed;
+    }
+
+private:
+    void init()
+    {
+        back = 0;
+        framesPushed = 0;
+        framesSkipped = 0;
+        framesWaited = 0;
+        stripsPushed = 0;
+        hasPushed = false;
+        memset(buffers, 0, sizeof(buffers));
+    }
+
+    RingStrip strips[STRIPS];
+
+    uint8_t buffers[2][PIXELS * 3];
+    uint8_t back;
+    boolean hasPushed;
+
+    volatile uint32_t framesPushed;
+    volatile uint32_t framesSkipped;
+    volatile uint32_t framesWaited;
+    volatile uint32_t stripsPushed;
+};
@@ -0,0 +1,149 @@
+
+#include <Arduino.h>
+
+#include "driver/rmt.h"
+
+#include "logging/logging.h"
+
+#include "rmt_led_driver.h"
+
+using namespace creatures;
+
+static Logger l;
+
+/*
+    WS2812 bit timings, in RMT ticks
+
+    The RMT runs off the 80MHz APB clock, and we divide it by 2, so each tick
+    is 25ns.
+*/
+#define WS2812_RMT_CLOCK_DIVIDER 2
+#define WS2812_T0H_TICKS 14 // 0.35us
+#define WS2812_T0L_TICKS 32 // 0.80us
+#define WS2812_T1H_TICKS 28 // 0.70us
+#define WS2812_T1L_TICKS 24 // 0.60us
+
+/*
+    How many of the RMT's 64-item memory blocks each channel gets
+
+    One block is only 64 bits (under 3 pixels), so the ISR has to refill it
+    every ~40us and a late refill glitches the strip. Two blocks give it twice
+    as long. A channel with two blocks borrows the next channel's memory, so
+    strips have to use every other channel (0, 2, 4, 6).
+*/
+#define WS2812_RMT_MEM_BLOCKS 2
+
+/**
+ * @brief Turns the pixel bytes into RMT items, one per bit
+ *
+ * The RMT driver calls this from its ISR as it needs more items, so it
+ * needs to live in IRAM.
+ */
+static void IRAM_ATTR ws2812ToRmt(const void *src, rmt_item32_t *dest, size_t src_size,
+                                  size_t wanted_num, size_t *translated_size, size_t *item_num)
+{
+    if (src == NULL || dest == NULL)
+    {
+        *translated_size = 0;
+        *item_num = 0;
+        return;
+    }
+
+    rmt_item32_t bit0;
+    bit0.duration0 = WS2812_T0H_TICKS;
+    bit0.level0 = 1;
+    bit0.duration1 = WS2812_T0L_TICKS;
+    bit0.level1 = 0;
+
+    rmt_item32_t bit1;
+    bit1.duration0 = WS2812_T1H_TICKS;
+    bit1.level0 = 1;
+    bit1.duration1 = WS2812_T1L_TICKS;
+    bit1.level1 = 0;
+
+    const uint8_t *psrc = (const uint8_t *)src;
+    size_t size = 0;
+    size_t num = 0;
+    while (size < src_size && num + 8 <= wanted_num)
+    {
+        // Most significant bit goes out first
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            dest[num++].val = (*psrc & (0x80 >> bit)) ? bit1.val : bit0.val;
+        }
+        size++;
+        psrc++;
+    }
+
+    *translated_size = size;
+    *item_num = num;
+}
+
+RmtLedDriver::RmtLedDriver(uint8_t pin, rmt_channel_t channel)
+{
+    this->pin = pin;
+    this->channel = channel;
+    this->started = false;
+}
+
+boolean RmtLedDriver::begin()
+{
+    rmt_config_t config = RMT_DEFAULT_CONFIG_TX((gpio_num_t)pin, channel);
+    config.clk_div = WS2812_RMT_CLOCK_DIVIDER;
+    config.mem_block_num = WS2812_RMT_MEM_BLOCKS;
+
+    esp_err_t err = rmt_config(&config);
+    if (err != ESP_OK)
+    {
+        l.error("unable to configure RMT channel %d: %s", channel, esp_err_to_name(err));
+        return false;
+    }
+
+    err = rmt_driver_install(channel, 0, 0);
+    if (err != ESP_OK)
+    {
+        l.error("unable to install the RMT driver on channel %d: %s", channel, esp_err_to_name(err));
+        return false;
+    }
+
+    err = rmt_translator_init(channel, ws2812ToRmt);
+    if (err != ESP_OK)
+    {
+        l.error("unable to set up the WS2812 translator on channel %d: %s", channel, esp_err_to_name(err));
+        return false;
+    }
+
+    started = true;
+    l.debug("RMT channel %d is driving LEDs on GPIO %d", channel, pin);
+    return true;
+}
+
+boolean RmtLedDriver::startTransmit(const uint8_t *pixels, size_t length)
+{
+    if (!started)
+    {
+        return false;
+    }
+
+    // Don't wait for it to finish, that's the whole point!
+    return rmt_write_sample(channel, pixels, length, false) == ESP_OK;
+}
+
+boolean RmtLedDriver::isBusy()
+{
+    if (!started)
+    {
+        return false;
+    }
+
+    // A zero timeout just asks if it's done yet
+    return rmt_wait_tx_done(channel, 0) != ESP_OK;
+}
+
+void RmtLedDriver::waitUntilDone()
+{
+    if (started)
+    {
+        rmt_wait_tx_done(channel, portMAX_DELAY);
+    }
+}
@@ -0,0 +1,30 @@
+
+#pragma once
+
+#include <Arduino.h>
+
+#include "driver/rmt.h"
+
+#include "led_driver.h"
+
+/**
+ * @brief Drives a strip of WS2812s from one of the ESP32's RMT channels
+ *
+ * The RMT peripheral clocks the bits out on its own, so startTransmit() returns
+ * right away and the calling task is free to go build the next frame.
+ */
+class RmtLedDriver : public LedDriver
+{
+public:
+    RmtLedDriver(uint8_t pin, rmt_channel_t channel);
+
+    boolean begin();
+    boolean startTransmit(const uint8_t *pixels, size_t length);
+    boolean isBusy();
+    void waitUntilDone();
+
+private:
+    uint8_t pin;
+    rmt_channel_t channel;
+    boolean started;
+};
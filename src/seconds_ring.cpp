@@ -1,5 +1,6 @@
 #include <Arduino.h>
-#include <ArduinoJson.h>
+
+#include <sys/time.h>
 
 extern "C"
 {
@@ -8,27 +9,61 @@ extern "C"
 }
 
 #include "logging/logging.h"
-#include "mdns/creature-mdns.h"
-
+#include "log_macros.h"
+
+#include "clock_config.h"
+#include "color.h"
+#include "fleet_sync.h"
+#include "rmt_led_driver.h"
+#include "ring_effects.h"
+#include "ring_output.h"
 #include "seconds_ring.h"
+#include "temporal_dither.h"
+#include "warm_start.h"
 
 using namespace creatures;
 
 static Logger l;
 
-#define NUMBER_OF_PIXELS 60
+/*
+    The ring's strips, in order around the ring. To build a bigger clock, bump
+    LED_RING_STRIPS and NUMBER_OF_PIXELS, and give each new strip its own pin
+    and an even RMT channel here.
+*/
+static constexpr uint16_t ringStripPixels[LED_RING_STRIPS] = {NUMBER_OF_PIXELS};
+static_assert(countRingPixels(ringStripPixels, LED_RING_STRIPS) == NUMBER_OF_PIXELS,
+              "the strips have to add up to NUMBER_OF_PIXELS");
+
+// High frame-rate mode's ticks are the shortest, so if the longest strip fits in one, it fits in a frame too
+static_assert(ws2812WireTimeUs(longestRingStrip(ringStripPixels, LED_RING_STRIPS)) <
+                  RING_FRAME_PERIOD_US / RING_DITHER_TICKS_PER_FRAME,
+              "the longest strip takes longer to send than a tick, so split it up or turn STEPS_PER_PIXEL down");
 
-Adafruit_NeoPixel strip = Adafruit_NeoPixel(NUMBER_OF_PIXELS, LED_RING_PIN, NEO_GRB + NEO_KHZ800);
+static RmtLedDriver ringDrivers[LED_RING_STRIPS] = {
+    RmtLedDriver(LED_RING_PIN, LED_RING_RMT_CHANNEL),
+};
 
+static const RingStrip ringStrips[LED_RING_STRIPS] = {
+    {&ringDrivers[0], ringStripPixels[0]},
+};
 
-extern CreatureMDNS* creatureMDNS;
+RingOutput<NUMBER_OF_PIXELS, LED_RING_STRIPS> ringOutput = RingOutput<NUMBER_OF_PIXELS, LED_RING_STRIPS>(ringStrips);
 
-// Config vars
-uint8_t gPixelRingSaturation;
-uint8_t gPixelBrightness;
 
 TaskHandle_t secondRingTaskHandle;
 
+// How far off the wall clock each ring frame was when it went out, in us
+static const int32_t ringPhaseEdges[RING_PHASE_BUCKETS - 1] = {-50000, -10000, -2000, 2000, 10000, 50000};
+Histogram<RING_PHASE_BUCKETS> ringPhaseHistogram = Histogram<RING_PHASE_BUCKETS>(ringPhaseEdges);
+
+/*
+    Render time, show time and wake up lateness for every frame (every tick in
+    high frame-rate mode). The deadline follows the tick period that's in use.
+*/
+FrameStats ringFrameStats = FrameStats(RING_FRAME_PERIOD_US);
+
+RingDitherStats ringDitherStats;
+
 // Seed this with a random number
 uint16_t colorNumber = random(1, USHRT_MAX);
 uint16_t getRandomHue()
@@ -39,108 +74,314 @@ uint16_t getRandomHue()
     uint32_t tempColor = colorNumber + GOLDEN_RATIO_CONJUGATE;
     colorNumber = tempColor %= USHRT_MAX;
 
-    l.debug("hue is now: %d", colorNumber);
+    LOG_DEBUG(l, "hue is now: %d", colorNumber);
     return colorNumber;
 }
 
+/**
+ * @brief The wall clock, in microseconds since the epoch
+ */
+static int64_t wallClockUs()
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (int64_t)now.tv_sec * 1000000LL + now.tv_usec;
+}
+
 /**
  * @brief A task to update the LED second hand
  *
  * This is kinda fun experiment on how to show seconds with a digital
  * clock in a non-annoying way.
  *
+ * The ring is phase locked to the wall clock. Each frame has a time it's due
+ * (counted from the minute that showTimeTask tells us about), and we sleep
+ * until then rather than just counting ticks. If the clock moves under us,
+ * or the signal shows up late, we catch up (or slow down) a little at a time
+ * instead of jumping, unless it's off by so much that jumping is the only
+ * sane thing to do.
+ *
+ * What actually gets drawn is up to whichever effect is picked in the config
+ * (see ring_effects.h). This just keeps time and tells it which frame to draw.
+ *
+ * In high frame-rate mode each frame goes out RING_DITHER_TICKS_PER_FRAME times,
+ * temporally dithered, so slow fades at low brightness don't move in jumps.
  */
 portTASK_FUNCTION(secondRingTask, pvParameters)
 {
 
-    // Default to this for now, make this a config var later
-    gPixelRingSaturation = 242;
-    gPixelBrightness = 10;
-    strip.begin();
-    strip.clear();
-    strip.show();
-    l.debug("started up the LED ring on GPIO %d", LED_RING_PIN);
+    for (uint8_t i = 0; i < LED_RING_STRIPS; i++)
+    {
+        ringDrivers[i].begin();
+    }
+    ringOutput.show();
+    l.debug("started up the LED ring (%d pixels on %d strips)", NUMBER_OF_PIXELS, LED_RING_STRIPS);
 
-    creatureMDNS->addServiceText(String("number_of_pixels"), String(NUMBER_OF_PIXELS));
+    l.debug("frame period is %dus", RING_FRAME_PERIOD_US);
 
-    // How many ticks per step? 60000 ms in a minute / NUMBER_OF_PIXELS pixels / how many steps per pixel
-    const int stepsPerPixel = 40; // One second per pixel  (25 = 25Hz)
-    const TickType_t xFrequency = pdMS_TO_TICKS(60000 / NUMBER_OF_PIXELS / stepsPerPixel);
-    l.debug("frequency is %d", xFrequency);
+    // Everything the effects need. Static so it doesn't eat up the task's stack.
+    static RingEffectState<NUMBER_OF_PIXELS> effectState;
 
-    uint16_t oldHue = getRandomHue();
+    // What the effect drew, in 8.8 fixed point, and what turns it into bytes for the LEDs
+    static uint16_t levels[NUMBER_OF_PIXELS * 3];
+    static TemporalDither<NUMBER_OF_PIXELS * 3> ditherer;
 
-    // Fill the strip with the oldHue
-    l.debug("filling the ring with the 'old' hue");
-    for(uint8_t i = 0; i < NUMBER_OF_PIXELS; i++)
+    // Our copy of the config, and which generation of it we have
+    ClockConfig config;
+    uint32_t configGeneration = getClockConfig(config);
+
+    // Carry on with the colour from before a reboot, if there was one
+    uint16_t oldHue;
+    if (getWarmRingHue(oldHue))
+    {
+        colorNumber = oldHue;
+    }
+    else
     {
-        strip.setPixelColor(i, strip.ColorHSV(oldHue, gPixelRingSaturation, gPixelBrightness));
+        oldHue = getRandomHue();
     }
-    strip.show();
+
+    // Fill the strip with the oldHue
+    l.debug("filling the ring with the 'old' hue");
+    fillHsv<NUMBER_OF_PIXELS, LED_RING_TYPE>(ringOutput.getPixels(), oldHue, config.pixelSaturation, config.pixelBrightness);
+    ringOutput.show();
+
+    uint8_t effect = config.ringEffect;
+
+    // How many more minutes to wait before trying high frame-rate mode again
+    uint8_t ditherBackoff = 0;
 
     uint16_t newHue = oldHue;
     uint32_t ulNotifiedValue;
-    TickType_t xLastWakeTime; // Keep track of the last time we woke up so we can be ultra precise
+    boolean started = false;
     for (;;)
     {
 
-        // Wait for a our cue to start
-        l.debug("waiting for a signal to start");
-        xTaskNotifyWait(0x00, ULONG_MAX, &ulNotifiedValue, portMAX_DELAY);
-        xLastWakeTime = xTaskGetTickCount();
-        l.debug("got the signal, starting!");
+        // Wait for a our cue to start (unless we already got it). We get sent the epoch of the minute that just started.
+        if (!started)
+        {
+            LOG_DEBUG(l, "waiting for a signal to start");
+            xTaskNotifyWait(0x00, UINT32_MAX, &ulNotifiedValue, portMAX_DELAY);
+        }
+        started = false;
+        int64_t minuteStartUs = (int64_t)ulNotifiedValue * 1000000LL;
+        LOG_DEBUG(l, "got the signal, starting!");
+
+        /*
+            Save the old color and get the new one. If there's a fleet to follow, both
+            come from its schedule instead, so we match everybody else even if we
+            just started (or missed a minute).
+        */
+        uint32_t minute = ulNotifiedValue / 60;
+        boolean fleet = getFleetHue(minute - 1, oldHue) && getFleetHue(minute, newHue);
+        if (fleet)
+        {
+            colorNumber = newHue;
+        }
+        else
+        {
+            oldHue = newHue;
+            newHue = getRandomHue();
+        }
+        saveWarmRingHue(newHue);
+        LOG_DEBUG(l, "oldHue: %d, newHue: %d", oldHue, newHue);
+
+        /*
+            Let the effect do all of its heavy lifting (like the HSV math) now instead
+            of on the frame deadline. Each frame after this should be cheap.
+        */
+        configGeneration = getClockConfig(config);
+        effect = config.ringEffect;
+        effectState.oldHue = oldHue;
+        effectState.newHue = newHue;
+        effectState.saturation = config.pixelSaturation;
+        effectState.brightness = config.pixelBrightness;
+        beginRingEffect(effect, effectState);
+
+        /*
+            In high frame-rate mode each of the effect's frames is shown a few times
+            (ticks), dithered a little differently each time. Otherwise there's one
+            tick per frame. Only try it if it hasn't fallen back recently.
+        */
+        boolean dither = config.ringDither && ditherBackoff == 0;
+        if (ditherBackoff > 0)
+        {
+            ditherBackoff--;
+        }
+        uint8_t ticksPerFrame = dither ? RING_DITHER_TICKS_PER_FRAME : 1;
+        ringFrameStats.setDeadlineUs(RING_FRAME_PERIOD_US / ticksPerFrame);
+        ringDitherStats.active = dither;
+        ditherer.reset();
+
+        uint32_t tick = 0;
+        int32_t lastFrame = -1;
+        boolean redraw = true;
 
-        // Save the old color and get the new one
-        oldHue = newHue;
-        newHue = getRandomHue();
-        l.debug("oldHue: %d, newHue: %d", oldHue, newHue);
+        // How busy we've been and how many ticks were late since windowStartUs
+        int64_t windowStartUs = wallClockUs();
+        uint32_t busyCycles = 0;
+        uint16_t lateTicks = 0;
 
-        uint8_t currentStep = 0;
-        for (uint8_t pixel = 0; pixel < NUMBER_OF_PIXELS; pixel++)
+        while (tick < (uint32_t)RING_FRAMES_PER_MINUTE * ticksPerFrame)
         {
-            l.debug("now doing pixel %d", pixel);
-            for (uint8_t currentStep = 1; currentStep - 1 < stepsPerPixel; currentStep++)
+            int32_t tickPeriodUs = RING_FRAME_PERIOD_US / ticksPerFrame;
+
+            // The last tick is due right at the top of the next minute
+            int64_t dueUs = minuteStartUs + (int64_t)(tick + 1) * tickPeriodUs;
+
+            // Wait until it's due, but if we're way ahead, just slow down instead of stopping
+            int64_t waitUs = dueUs - wallClockUs();
+            if (waitUs > 0)
             {
-                // Wait until the right number of ticks
-                vTaskDelayUntil(&xLastWakeTime, xFrequency);
+                if (waitUs > RING_MAX_WAIT_FRAMES * tickPeriodUs)
+                {
+                    waitUs = RING_MAX_WAIT_FRAMES * tickPeriodUs;
+                }
+                vTaskDelay(pdMS_TO_TICKS((waitUs + 999) / 1000));
+            }
 
-                /*
-                    The FreeRTOS ticker is pretty good, and this is a real time OS, but one the last one,
-                    let's skip a few steps to allow time for the singaling to get lined up for the top of the
-                    minute.
-                */
-                if (pixel == NUMBER_OF_PIXELS - 1 && currentStep == 1)
-                    currentStep += 2;
+            /*
+                How far off are we? If we're a whole tick (or more) behind, skip ahead a
+                little bit each tick until we're caught up. If we're off by more than the
+                resync limit either way, just jump to where we should be.
+            */
+            int64_t errorUs = wallClockUs() - dueUs;
+            if (fleet)
+            {
+                fleetSyncStats.lastPhaseErrorUs = errorUs > INT32_MAX ? INT32_MAX : (errorUs < INT32_MIN ? INT32_MIN : (int32_t)errorUs);
+            }
+            uint32_t renderStart = FrameStats::startTimer();
+            uint32_t ticksPerMinute = (uint32_t)RING_FRAMES_PER_MINUTE * ticksPerFrame;
+            if (errorUs >= RING_PHASE_RESYNC_US || errorUs <= -RING_PHASE_RESYNC_US)
+            {
+                int64_t shouldBe = (wallClockUs() - minuteStartUs) / tickPeriodUs - 1;
+                tick = shouldBe < 0 ? 0 : (shouldBe >= ticksPerMinute ? ticksPerMinute - 1 : shouldBe);
+                LOG_DEBUG(l, "ring was off by %dus, jumping to tick %u", (int32_t)errorUs, tick);
+            }
+            else if (errorUs >= tickPeriodUs)
+            {
+                int64_t behind = errorUs / tickPeriodUs;
+                tick += behind < RING_MAX_CATCHUP_FRAMES ? behind : RING_MAX_CATCHUP_FRAMES;
+                if (tick >= ticksPerMinute)
+                {
+                    tick = ticksPerMinute - 1;
+                }
+                lateTicks++;
+            }
 
-                l.verbose("now doing step %d", currentStep);
+            // Keep track of how close the ring is to the real time
+            int64_t shownDueUs = minuteStartUs + (int64_t)(tick + 1) * tickPeriodUs;
+            ringPhaseHistogram.record((int32_t)(wallClockUs() - shownDueUs));
 
-                strip.setPixelColor(pixel, strip.ColorHSV(interpolateHue(oldHue, newHue, stepsPerPixel, currentStep),
-                                                          gPixelRingSaturation,
-                                                          gPixelBrightness));
+            uint16_t frame = tick / ticksPerFrame;
 
+            /*
+                If the config changed, start the effect over with the new settings (it
+                might be a different effect entirely). Checking the generation is just
+                one load, so this costs nothing when nothing changed.
+            */
+            if (getClockConfigGeneration() != configGeneration)
+            {
+                configGeneration = getClockConfig(config);
+                effect = config.ringEffect;
+                effectState.saturation = config.pixelSaturation;
+                effectState.brightness = config.pixelBrightness;
+                beginRingEffect(effect, effectState);
+                redraw = true;
+            }
+            else if (lastFrame >= 0 && frame != lastFrame && frame != lastFrame + 1)
+            {
+                // We skipped over a frame (or went backwards), so the effect can't count on the levels
+                redraw = true;
+            }
 
-                strip.show();
+            // The extra ticks in high frame-rate mode only need to be dithered again
+            if (redraw || frame != lastFrame)
+            {
+                renderRingEffect(effect, effectState, levels, frame, redraw);
+                lastFrame = frame;
+                redraw = false;
+            }
+
+            /*
+                Without dithering, a lot of frames come out the same as the last one
+                (most of the time the wipe only moves a little bit between steps).
+                ringOutput only pushes the frame out to the LEDs if it's actually
+                different.
+            */
+            if (dither)
+            {
+                ditherer.render(levels, ringOutput.getPixels());
+            }
+            else
+            {
+                TemporalDither<NUMBER_OF_PIXELS * 3>::truncate(levels, ringOutput.getPixels());
+            }
+            uint32_t renderCycles = FrameStats::cyclesSince(renderStart);
+
+            uint32_t showStart = FrameStats::startTimer();
+            ringOutput.show();
+            uint32_t showCycles = FrameStats::cyclesSince(showStart);
+            ringFrameStats.record(errorUs > INT32_MAX ? INT32_MAX : (int32_t)errorUs,
+                                  renderCycles,
+                                  showCycles);
+
+            busyCycles += renderCycles + showCycles;
+            tick++;
+
+            // If we got told to start again (a restart, or the next minute showed up early), go do it
+            if (xTaskNotifyWait(0x00, UINT32_MAX, &ulNotifiedValue, 0) == pdPASS)
+            {
+                LOG_DEBUG(l, "starting over at tick %u", tick);
+                started = true;
+                break;
+            }
+
+            /*
+                Once a second, see how much of the core we're using. If high frame-rate
+                mode is using more than its budget, or keeps waking up late, go back to
+                the normal rate for the rest of this minute and a few more.
+            */
+            int64_t windowUs = wallClockUs() - windowStartUs;
+            if (windowUs >= 1000000LL)
+            {
+                uint32_t busyPercent = ((uint64_t)busyCycles * 100) / ((uint64_t)windowUs * ESP.getCpuFreqMHz());
+                ringDitherStats.lastBusyPercent = busyPercent;
+
+                if (dither && (busyPercent > RING_DITHER_CPU_BUDGET_PERCENT || lateTicks > RING_DITHER_MAX_LATE_TICKS))
+                {
+                    LOG_WARNING_EVERY(l, 10 * 60 * 1000, "high frame-rate mode is falling back (%u%% busy, %u late ticks)",
+                                      busyPercent, lateTicks);
+
+                    dither = false;
+                    ditherBackoff = RING_DITHER_BACKOFF_MINUTES;
+                    tick /= ticksPerFrame;
+                    ticksPerFrame = 1;
+                    ringFrameStats.setDeadlineUs(RING_FRAME_PERIOD_US);
+
+                    ringDitherStats.active = false;
+                    ringDitherStats.fallbacks++;
+                }
+
+                windowStartUs += windowUs;
+                busyCycles = 0;
+                lateTicks = 0;
             }
         }
     }
 }
 
 /**
- * @brief Returns the requested step in a fade between two hues
- *
- * @param oldColor Starting hue
- * @param newColor Finishing hue
- * @param totalSteps How many steps are we fading
- * @param currentStep Which one to get
- * @return uint16_t The hue requested
+ * @brief Starts the ring's minute over from right now, with a new colour
  */
-uint16_t interpolateHue(uint16_t oldHue, uint16_t newHue, uint8_t totalSteps, uint8_t currentStep)
+void restartSecondRing()
 {
-    // How much is each step?
-    uint16_t differentialStep = (newHue - oldHue) / totalSteps;
-
-    uint16_t stepHue = oldHue + (differentialStep * currentStep);
-    l.verbose("old: %d, new: %d, differential: %d, current: %d", oldHue, newHue, differentialStep, stepHue);
+    if (secondRingTaskHandle == NULL)
+    {
+        return;
+    }
 
-    return stepHue;
-}
\ No newline at end of file
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    xTaskNotify(secondRingTaskHandle, (uint32_t)(now.tv_sec / 60 * 60), eSetValueWithOverwrite);
+}
@@ -14,12 +14,85 @@ extern "C"
 
 #include "logging/logging.h"
 
+#include "frame_stats.h"
+#include "histogram.h"
+#include "ring_output.h"
+
+#define LED_RING_TYPE (NEO_GRB + NEO_KHZ800)
+#define NUMBER_OF_PIXELS 60
+
+/*
+    The strips that make up the ring. Each one gets its own pin and RMT channel
+    (see ringStrips in seconds_ring.cpp), and they all get sent at the same
+    time. The effects just see one long ring of NUMBER_OF_PIXELS.
+
+    Each RMT channel uses two memory blocks (see rmt_led_driver.cpp), so use
+    even channels only. That's up to four strips.
+
+    The longest strip has to be done sending before the next tick, or frames
+    would back up behind each other. A WS2812 pixel takes 30us on the wire, so
+    at RING_DITHER_TICKS_PER_FRAME ticks a frame that's about 200 pixels a strip
+    (seconds_ring.cpp checks this at compile time). For more than that, add a
+    strip or turn STEPS_PER_PIXEL down.
+*/
+#define LED_RING_STRIPS 1
 #define LED_RING_PIN 13
+#define LED_RING_RMT_CHANNEL RMT_CHANNEL_0
 
 // This is 0.618033988749895 * (2**16)
 #define GOLDEN_RATIO_CONJUGATE 40503
 
+// How many steps does each pixel take to fade to the new hue? (40 = 25Hz)
+#define STEPS_PER_PIXEL 40
+
+// How many frames in a minute, and how long each one is
+#define RING_FRAMES_PER_MINUTE (NUMBER_OF_PIXELS * STEPS_PER_PIXEL)
+#define RING_FRAME_PERIOD_US (60000000L / RING_FRAMES_PER_MINUTE)
+
+static_assert(RING_FRAMES_PER_MINUTE <= 65535, "the ring counts frames in a uint16_t");
+
+// When we're behind, how many extra frames can we skip each frame to catch up?
+#define RING_MAX_CATCHUP_FRAMES 1
+
+// When we're ahead, don't wait longer than this many frames for one (so we run at half speed)
+#define RING_MAX_WAIT_FRAMES 2
+
+// If we're off by more than this, give up on being smooth and just jump
+#define RING_PHASE_RESYNC_US 2000000L
+
+// How many buckets in the ring's phase error histogram
+#define RING_PHASE_BUCKETS 7
+
+/*
+    High frame-rate mode
+
+    Shows each frame a few times with temporal dithering (4 = 160Hz). If the ring
+    uses more than its share of core 1, or keeps waking up late, it falls back to
+    the normal rate and waits a while before trying again.
+*/
+#define RING_DITHER_TICKS_PER_FRAME 4
+#define RING_DITHER_CPU_BUDGET_PERCENT 30
+#define RING_DITHER_MAX_LATE_TICKS 8 // In one second
+#define RING_DITHER_BACKOFF_MINUTES 10
+
+/**
+ * @brief What high frame-rate mode is up to
+ */
+struct RingDitherStats
+{
+    boolean active;           // Is it running right now?
+    uint32_t fallbacks;       // How many times did it have to give up?
+    uint32_t lastBusyPercent; // How much of core 1 the ring used in the last second
+};
+
+extern RingDitherStats ringDitherStats;
+
 uint16_t getRandomHue();
-uint16_t interpolateHue(uint16_t oldHue, uint16_t newHue, uint8_t totalSteps, uint8_t currentStep);
+
+extern RingOutput<NUMBER_OF_PIXELS, LED_RING_STRIPS> ringOutput;
+extern Histogram<RING_PHASE_BUCKETS> ringPhaseHistogram;
+extern FrameStats ringFrameStats;
+
+void restartSecondRing();
 
 portTASK_FUNCTION_PROTO(secondRingTask, pvParameters);
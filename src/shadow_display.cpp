@@ -0,0 +1,105 @@
+
+#include <Arduino.h>
+#include <Adafruit_LEDBackpack.h>
+
+#include "shadow_display.h"
+
+// The HT16K33's brightness command, and it's max value
+#define HT16K33_BRIGHTNESS_COMMAND 0xE0
+#define HT16K33_BRIGHTNESS_MAX 15
+
+ShadowDisplay::ShadowDisplay() : Adafruit_7segment()
+{
+    transactionsSent = 0;
+    transactionsAvoided = 0;
+    invalidate();
+}
+
+boolean ShadowDisplay::begin(uint8_t address)
+{
+    boolean result = Adafruit_7segment::begin(address);
+
+    // begin() writes to the chip on its own, so we don't know what's on it
+    invalidate();
+    return result;
+}
+
+void ShadowDisplay::invalidate()
+{
+    shadowValid = false;
+    brightnessValid = false;
+}
+
+void ShadowDisplay::setBrightness(uint8_t brightness)
+{
+    if (brightness > HT16K33_BRIGHTNESS_MAX)
+    {
+        brightness = HT16K33_BRIGHTNESS_MAX;
+    }
+
+    if (brightnessValid && brightness == this->brightness)
+    {
+        transactionsAvoided++;
+        return;
+    }
+
+    uint8_t command = HT16K33_BRIGHTNESS_COMMAND | brightness;
+    i2c_dev->write(&command, 1);
+    transactionsSent++;
+
+    this->brightness = brightness;
+    brightnessValid = true;
+}
+
+void ShadowDisplay::writeDisplay()
+{
+    // Lay it out the same way it lives in the chip's RAM
+    uint8_t ram[SHADOW_DISPLAY_RAM_SIZE];
+    for (uint8_t i = 0; i < SHADOW_DISPLAY_RAM_SIZE / 2; i++)
+    {
+        ram[2 * i] = displaybuffer[i] & 0xFF;
+        ram[2 * i + 1] = displaybuffer[i] >> 8;
+    }
+
+    // Which bytes changed?
+    uint8_t first = 0;
+    uint8_t last = SHADOW_DISPLAY_RAM_SIZE - 1;
+    if (shadowValid)
+    {
+        while (first < SHADOW_DISPLAY_RAM_SIZE && ram[first] == shadow[first])
+        {
+            first++;
+        }
+
+        if (first == SHADOW_DISPLAY_RAM_SIZE)
+        {
+            transactionsAvoided++;
+            return;
+        }
+
+        while (ram[last] == shadow[last])
+        {
+            last--;
+        }
+    }
+
+    // The chip auto-increments, so send the start address and then just the changed run
+    uint8_t buffer[SHADOW_DISPLAY_RAM_SIZE + 1];
+    buffer[0] = first;
+    memcpy(buffer + 1, ram + first, last - first + 1);
+    i2c_dev->write(buffer, last - first + 2);
+    transactionsSent++;
+
+    memcpy(shadow, ram, SHADOW_DISPLAY_RAM_SIZE);
+    shadowValid = true;
+}
+
+uint32_t ShadowDisplay::getTransactionsSent()
+{
+    return transactionsSent;
+}
+
+uint32_t ShadowDisplay::getTransactionsAvoided()
+{
+    return transactionsAvoided;
+}
@@ -0,0 +1,44 @@
+
+#pragma once
+
+#include <Arduino.h>
+#include <Adafruit_LEDBackpack.h>
+
+// The HT16K33 has 16 bytes of display RAM
+#define SHADOW_DISPLAY_RAM_SIZE 16
+
+/**
+ * @brief An Adafruit_7segment that only talks on the I2C bus when it has to
+ *
+ * Keeps a copy of what was last written to the HT16K33, and only sends the
+ * bytes that changed (and only sends the brightness when it changes). The
+ * display gets redrawn a lot more often than it actually changes, so this
+ * saves a lot of time on the bus.
+ */
+class ShadowDisplay : public Adafruit_7segment
+{
+public:
+    ShadowDisplay();
+
+    boolean begin(uint8_t address = 0x70);
+    void setBrightness(uint8_t brightness);
+    void writeDisplay();
+
+    /**
+     * @brief Forget what's on the display so the next write sends everything
+     */
+    void invalidate();
+
+    uint32_t getTransactionsSent();
+    uint32_t getTransactionsAvoided();
+
+private:
+    uint8_t shadow[SHADOW_DISPLAY_RAM_SIZE];
+    boolean shadowValid;
+
+    uint8_t brightness;
+    boolean brightnessValid;
+
+    volatile uint32_t transactionsSent;
+    volatile uint32_t transactionsAvoided;
+};
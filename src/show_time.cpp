@@ -0,0 +1,243 @@
+
+#include <Arduino.h>
+
+#include <sys/time.h>
+#include <time.h>
+
+extern "C"
+{
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+}
+
+#include "logging/logging.h"
+#include "log_macros.h"
+
+#include "boot.h"
+#include "civil_time.h"
+#include "clock_config.h"
+#include "clock_face.h"
+#include "frame_stats.h"
+#include "shadow_display.h"
+#include "show_time.h"
+#include "time_discipline.h"
+#include "warm_start.h"
+
+using namespace creatures;
+
+static Logger l;
+
+// Defined in seconds_ring.cpp
+extern TaskHandle_t secondRingTaskHandle;
+
+TaskHandle_t showTimeTaskHandler;
+ShadowDisplay display = ShadowDisplay();
+
+MinuteSignalStats minuteSignalStats;
+FrameStats displayFrameStats = FrameStats(DISPLAY_DEADLINE_US);
+
+// Complain if the ring gets kicked off more than this long after the minute
+#define MINUTE_SIGNAL_LATE_US 5000
+
+// How long to show each number of the IP address for
+#define SHOW_IP_OCTET_MS 1500
+
+// An IP address somebody asked to see, and if they're still waiting on it
+static volatile uint8_t ipAddressToShow[4];
+static volatile boolean ipAddressPending = false;
+
+/**
+ * @brief Which number of the IP address should be up at a time, or -1 if it's done
+ *
+ * @param startedUs When it started showing the IP address
+ * @param nowUs The wall clock
+ */
+static int8_t ipOctetAt(int64_t startedUs, int64_t nowUs)
+{
+    int64_t octet = (nowUs - startedUs) / (SHOW_IP_OCTET_MS * 1000LL);
+    return octet >= 0 && octet < 4 ? (int8_t)octet : -1;
+}
+
+void showIpAddress(IPAddress address)
+{
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        ipAddressToShow[i] = address[i];
+    }
+    ipAddressPending = true;
+
+    if (showTimeTaskHandler != NULL)
+    {
+        xTaskNotifyGive(showTimeTaskHandler);
+    }
+}
+
+/**
+ * @brief How long until a wall clock time, in ticks
+ *
+ * Always rounds up so we never wake up before the edge we're waiting for.
+ */
+static TickType_t ticksUntil(const struct timeval &now, int64_t targetUs)
+{
+    int64_t nowUs = (int64_t)now.tv_sec * 1000000LL + now.tv_usec;
+    int64_t waitUs = targetUs - nowUs;
+
+    if (waitUs <= 0)
+    {
+        return 0;
+    }
+
+    int64_t waitMs = (waitUs + 999) / 1000;
+    return pdMS_TO_TICKS(waitMs) + 1;
+}
+
+portTASK_FUNCTION(showTimeTask, pvParameters)
+{
+
+    l.info("Show Time Task started");
+
+    struct timeval now;
+    CivilTime local;
+    ClockConfig config;
+
+    // Seed the last minute with right now
+    gettimeofday(&now, NULL);
+    time_t lastMinute = now.tv_sec / 60;
+    bool displayWasOn = true;
+
+    // When we were supposed to wake up
+    int64_t dueUs = (int64_t)now.tv_sec * 1000000LL + now.tv_usec;
+
+    // When we started showing an IP address
+    int64_t ipStartedUs = 0;
+
+    for (;;)
+    {
+        gettimeofday(&now, NULL);
+        time_t thisMinute = now.tv_sec / 60;
+        int64_t nowUs = (int64_t)now.tv_sec * 1000000LL + now.tv_usec;
+
+        /*
+            Only four digits, so the IP address goes up one number at a time, in
+            place of the time. We come back for each number like any other edge,
+            so the minute signal never has to wait on it.
+        */
+        if (ipAddressPending)
+        {
+            ipAddressPending = false;
+            ipStartedUs = nowUs;
+        }
+        int8_t ipOctet = ipOctetAt(ipStartedUs, nowUs);
+
+        int32_t latenessUs = (int32_t)(nowUs - dueUs);
+        uint32_t renderStart = FrameStats::startTimer();
+
+        // One copy of the config for this whole redraw
+        getClockConfig(config);
+
+        if (config.displayOn)
+        {
+            /*
+                Should we signal to the second ring to start? While the display is off
+                the ring doesn't hear about minutes at all, so when it comes back on
+                the ring gets told about the one it's in right away.
+            */
+            if (thisMinute != lastMinute)
+            {
+                int64_t edgeUs = (int64_t)thisMinute * 60 * 1000000LL;
+                lastMinute = thisMinute;
+                xTaskNotify(secondRingTaskHandle, (uint32_t)(thisMinute * 60), eSetValueWithOverwrite);
+
+                // How late was that? Catching up after the display was off doesn't count
+                if (displayWasOn)
+                {
+                    struct timeval signaled;
+                    gettimeofday(&signaled, NULL);
+                    int32_t latencyUs = (int32_t)((int64_t)signaled.tv_sec * 1000000LL + signaled.tv_usec - edgeUs);
+
+                    minuteSignalStats.signals++;
+                    minuteSignalStats.lastLatencyUs = latencyUs;
+                    if (latencyUs > minuteSignalStats.maxLatencyUs)
+                    {
+                        minuteSignalStats.maxLatencyUs = latencyUs;
+                    }
+
+                    LOG_DEBUG(l, "signaled to the second ring to go (%dus after the minute)", latencyUs);
+                    if (latencyUs > MINUTE_SIGNAL_LATE_US)
+                    {
+                        LOG_WARNING_EVERY(l, 10 * 60 * 1000, "the minute signal was late by %dus", latencyUs);
+                    }
+                }
+            }
+        }
+
+        if (ipOctet >= 0)
+        {
+            display.print((int)ipAddressToShow[ipOctet]);
+            display.writeDigitRaw(2, 0);
+        }
+        else if (config.displayOn)
+        {
+            local = toCivilTime(now.tv_sec);
+            ClockFace face = makeClockFace(local.hour, local.minute, local.second, config.blinkColon);
+
+            // Print the time
+            display.print(face.time);
+
+            // If SNTP has checked the time, it's right, and it's worth keeping for a warm start
+            if (timeDisciplineStats.syncs > 0)
+            {
+                markFirstCorrectDisplay();
+                saveWarmTime();
+            }
+
+            // Position 2 is the colons and the AM/PM lights
+            display.writeDigitRaw(2, face.colonSegments);
+
+        } // config.displayOn
+        else
+        {
+            // Show nothing if the display is off
+            display.print("");
+        }
+
+        uint32_t renderCycles = FrameStats::cyclesSince(renderStart);
+
+        // These only go out on the I2C bus if something actually changed
+        uint32_t showStart = FrameStats::startTimer();
+        display.setBrightness(config.screenBrightness);
+        display.writeDisplay();
+        displayFrameStats.record(latenessUs, renderCycles, FrameStats::cyclesSince(showStart));
+
+        displayWasOn = config.displayOn;
+
+        /*
+            Sleep until the next thing that changes what's on the display. That's the
+            next number of the IP address if it's up, the next second if the colon is
+            blinking, or the top of the next minute if not. A notification (like a
+            config change) wakes us up early.
+        */
+        int64_t nextEdgeUs = (int64_t)(thisMinute + 1) * 60 * 1000000LL;
+        if (ipOctet >= 0)
+        {
+            int64_t nextOctetUs = ipStartedUs + (ipOctet + 1) * SHOW_IP_OCTET_MS * 1000LL;
+            nextEdgeUs = nextOctetUs < nextEdgeUs ? nextOctetUs : nextEdgeUs;
+        }
+        else if (config.displayOn && config.blinkColon)
+        {
+            nextEdgeUs = (int64_t)(now.tv_sec + 1) * 1000000LL;
+        }
+
+        gettimeofday(&now, NULL);
+        if (ulTaskNotifyTake(pdTRUE, ticksUntil(now, nextEdgeUs)) == 0)
+        {
+            dueUs = nextEdgeUs;
+        }
+        else
+        {
+            // Somebody poked us, so we're right on time by definition
+            gettimeofday(&now, NULL);
+            dueUs = (int64_t)now.tv_sec * 1000000LL + now.tv_usec;
+        }
+    }
+}
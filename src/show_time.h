@@ -0,0 +1,54 @@
+
+#pragma once
+
+#include <Arduino.h>
+
+extern "C"
+{
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+}
+
+#include "logging/logging.h"
+
+#include "frame_stats.h"
+#include "shadow_display.h"
+
+/**
+ * @brief How well the minute signal to the second ring is lining up
+ *
+ * The latency is how long after the real minute edge the second ring was
+ * notified, in microseconds.
+ */
+struct MinuteSignalStats
+{
+    uint32_t signals;
+    int32_t lastLatencyUs;
+    int32_t maxLatencyUs;
+};
+
+extern MinuteSignalStats minuteSignalStats;
+
+// A redraw that finishes more than this long after its edge is a deadline miss
+#define DISPLAY_DEADLINE_US 20000
+
+extern FrameStats displayFrameStats;
+
+extern TaskHandle_t showTimeTaskHandler;
+
+// The display belongs to showTimeTask once setup() is done with it
+extern ShadowDisplay display;
+
+/**
+ * @brief Shows an IP address on the display for a few seconds, then goes back to the time
+ */
+void showIpAddress(IPAddress address);
+
+/**
+ * @brief Keeps the time on the display and tells the second ring when the minute changes
+ *
+ * Instead of polling the time, this works out when the next thing it cares about
+ * happens (the next colon blink or the next minute) and sleeps until then. Notify
+ * the task to make it redraw right away, like after a config change.
+ */
+portTASK_FUNCTION_PROTO(showTimeTask, pvParameters);
@@ -0,0 +1,367 @@
+
+#include <Arduino.h>
+
+#include <stdarg.h>
+
+extern "C"
+{
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+}
+
+#include "logging/logging.h"
+#include "mqtt/mqtt.h"
+#include "mdns/creature-mdns.h"
+
+#include "boot.h"
+#include "civil_time.h"
+#include "clock_config.h"
+#include "config_parser.h"
+#include "fleet_sync.h"
+#include "frame_stats.h"
+#include "message_router.h"
+#include "ring_effects.h"
+#include "seconds_ring.h"
+#include "shadow_display.h"
+#include "show_time.h"
+#include "telemetry.h"
+#include "time_discipline.h"
+#include "warm_start.h"
+
+using namespace creatures;
+
+// Defined in main.cpp
+extern ShadowDisplay display;
+extern CreatureMDNS *creatureMDNS;
+
+static Logger l;
+
+/**
+ * @brief printf() onto the end of what's already in a buffer
+ *
+ * @param buffer The buffer
+ * @param size How big the buffer is
+ * @param used How much of it is used now
+ * @param format printf() format
+ * @return size_t How much of it is used after this, never more than size - 1
+ */
+static size_t appendf(char *buffer, size_t size, size_t used, const char *format, ...)
+{
+    if (used >= size - 1)
+    {
+        return used;
+    }
+
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(buffer + used, size - used, format, args);
+    va_end(args);
+
+    if (written < 0)
+    {
+        return used;
+    }
+
+    used += written;
+    return used < size - 1 ? used : size - 1;
+}
+
+/**
+ * @brief Adds a histogram to the stats as `,"name":{...}`
+ */
+template <uint8_t BUCKETS>
+static size_t appendHistogram(char *buffer, size_t size, size_t used, const char *name, Histogram<BUCKETS> &histogram)
+{
+    used = appendf(buffer, size, used, ",\"%s\":{\"samples\":%u,\"min\":%d,\"max\":%d,\"edges\":[",
+                   name,
+                   histogram.getSamples(),
+                   histogram.getMinimum(),
+                   histogram.getMaximum());
+
+    for (uint8_t i = 0; i < BUCKETS - 1; i++)
+    {
+        used = appendf(buffer, size, used, i == 0 ? "%d" : ",%d", histogram.getEdge(i));
+    }
+
+    used = appendf(buffer, size, used, "],\"counts\":[");
+    for (uint8_t i = 0; i < BUCKETS; i++)
+    {
+        used = appendf(buffer, size, used, i == 0 ? "%u" : ",%u", histogram.getCount(i));
+    }
+
+    return appendf(buffer, size, used, "]}");
+}
+
+/**
+ * @brief Adds a loop's frame timing to the stats as `,"name":{...}`
+ */
+static size_t appendFrameStats(char *buffer, size_t size, size_t used, const char *name, FrameStats &stats)
+{
+    used = appendf(buffer, size, used, ",\"%s\":{\"frames\":%u,\"deadlineUs\":%u,\"deadlineMisses\":%u",
+                   name,
+                   stats.getFrames(),
+                   stats.getDeadlineUs(),
+                   stats.getDeadlineMisses());
+    used = appendHistogram(buffer, size, used, "latenessUs", stats.lateness);
+    used = appendHistogram(buffer, size, used, "renderUs", stats.render);
+    used = appendHistogram(buffer, size, used, "showUs", stats.show);
+    return appendf(buffer, size, used, "}");
+}
+
+/**
+ * @brief Puts the short version of a loop's stats in our mDNS service text
+ */
+static void updateFrameStatsServiceText(const char *name, FrameStats &stats)
+{
+    char value[32];
+    snprintf(value, sizeof(value), "%u/%u", stats.getDeadlineMisses(), stats.getFrames());
+    creatureMDNS->addServiceText(String(name) + "_deadline_misses", String(value));
+
+    snprintf(value, sizeof(value), "%d", stats.render.getMaximum() + stats.show.getMaximum());
+    creatureMDNS->addServiceText(String(name) + "_max_frame_us", String(value));
+}
+
+#if configUSE_TRACE_FACILITY == 1
+
+static TaskStatus_t taskStatus[TELEMETRY_MAX_TASKS];
+
+/**
+ * @brief Adds every task's stack high water mark to the stats as `,"tasks":{...}`
+ */
+static size_t appendTaskStats(char *buffer, size_t size, size_t used)
+{
+    UBaseType_t taskCount = uxTaskGetSystemState(taskStatus, TELEMETRY_MAX_TASKS, NULL);
+
+    used = appendf(buffer, size, used, ",\"tasks\":{");
+    for (UBaseType_t i = 0; i < taskCount; i++)
+    {
+        const TaskStatus_t &task = taskStatus[i];
+
+        // Stacks are measured in bytes on the ESP32
+        used = appendf(buffer, size, used, "%s\"%s\":{\"stackFree\":%u",
+                       i == 0 ? "" : ",",
+                       task.pcTaskName,
+                       (unsigned int)task.usStackHighWaterMark);
+
+#if configTASKLIST_INCLUDE_COREID == 1
+        used = appendf(buffer, size, used, ",\"core\":%d", task.xCoreID == tskNO_AFFINITY ? -1 : (int)task.xCoreID);
+#endif
+
+        used = appendf(buffer, size, used, "}");
+    }
+    return appendf(buffer, size, used, "}");
+}
+
+#endif
+
+/**
+ * @brief How much of its core a loop used since the last time this was called
+ *
+ * @param lastBusyUs The loop's busy time the last time, updated to now
+ * @param elapsedUs How long it's been
+ */
+static uint32_t loopBusyPercent(FrameStats &stats, uint32_t &lastBusyUs, uint32_t elapsedUs)
+{
+    uint32_t busyUs = stats.getBusyUs();
+    uint32_t ran = busyUs - lastBusyUs;
+    lastBusyUs = busyUs;
+
+    return elapsedUs == 0 ? 0 : (uint32_t)((uint64_t)ran * 100 / elapsedUs);
+}
+
+/**
+ * @brief Closes off a stats payload and publishes it, as long as it all fit
+ *
+ * appendf() stops at the end of the buffer, so a payload that ran out of room
+ * isn't valid JSON anymore. That gets logged and dropped instead of sent.
+ *
+ * @param topic Where to publish it, under "stats/"
+ * @return boolean true if it went out
+ */
+static boolean publishStats(MQTT *mqtt, const char *topic, char *payload, size_t size, size_t used)
+{
+    used = appendf(payload, size, used, "}");
+    if (used >= size - 1)
+    {
+        l.error("the %s stats don't fit in %u bytes, not publishing them", topic, (unsigned int)size);
+        return false;
+    }
+
+    l.debug("publishing %s stats: %s", topic, payload);
+    mqtt->publish(String("stats/") + topic, String(payload), 0, false);
+    return true;
+}
+
+portTASK_FUNCTION(telemetryTask, pvParameters)
+{
+    MQTT *mqtt = (MQTT *)pvParameters;
+
+    l.info("Telemetry task started");
+
+    // Static so it doesn't eat up the task's stack
+    static char payload[4096];
+
+    // Where the ring and the display's busy time were the last time around
+    uint32_t lastStatsUs = micros();
+    uint32_t lastRingBusyUs = ringFrameStats.getBusyUs();
+    uint32_t lastDisplayBusyUs = displayFrameStats.getBusyUs();
+
+    TickType_t xLastWakeTime = xTaskGetTickCount();
+    for (;;)
+    {
+        vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(TELEMETRY_INTERVAL_MS));
+
+        /*
+            Each part of the clock gets its own topic, so none of them can push the
+            others out of the buffer, and adding stats to one doesn't risk the rest.
+        */
+        size_t used;
+
+        // How many frames did the ring actually push out vs skip because nothing changed?
+        // How many strips did those frames have to send?
+        // Which effect is it running, and how often did it go over its budget?
+        // And how close to the real time was each frame, in us?
+        ClockConfig config;
+        getClockConfig(config);
+        used = appendf(payload, sizeof(payload), 0,
+                       "{\"output\":{\"framesPushed\":%u,\"framesSkipped\":%u,\"framesWaited\":%u,\"stripsPushed\":%u,\"effect\":\"%s\",\"framesOverBudget\":%u}",
+                       ringOutput.getFramesPushed(),
+                       ringOutput.getFramesSkipped(),
+                       ringOutput.getFramesWaited(),
+                       ringOutput.getStripsPushed(),
+                       config.ringEffect < RING_EFFECT_COUNT ? ringEffectNames[config.ringEffect] : "unknown",
+                       ringEffectFramesOverBudget);
+        used = appendHistogram(payload, sizeof(payload), used, "phaseErrorUs", ringPhaseHistogram);
+
+        // Is high frame-rate mode on, and is it keeping up?
+        used = appendf(payload, sizeof(payload), used,
+                       ",\"dither\":{\"active\":%s,\"fallbacks\":%u,\"busyPercent\":%u}",
+                       ringDitherStats.active ? "true" : "false",
+                       ringDitherStats.fallbacks,
+                       ringDitherStats.lastBusyPercent);
+
+        // Is the ring keeping up?
+        used = appendFrameStats(payload, sizeof(payload), used, "frames", ringFrameStats);
+
+        // How close to the real top of the minute is the second ring getting kicked off?
+        used = appendf(payload, sizeof(payload), used,
+                       ",\"minuteSignal\":{\"signals\":%u,\"lastLatencyUs\":%d,\"maxLatencyUs\":%d}",
+                       minuteSignalStats.signals,
+                       minuteSignalStats.lastLatencyUs,
+                       minuteSignalStats.maxLatencyUs);
+
+        /*
+            Is the ring following the fleet, and how far off its schedule is it? Compare
+            this (plus the time offset) between clocks to see how far apart they are.
+        */
+        used = appendf(payload, sizeof(payload), used,
+                       ",\"fleetSync\":{\"following\":%s,\"received\":%u,\"rejected\":%u,\"startMinute\":%u,\"hueSeed\":%u,\"lastPhaseErrorUs\":%d}",
+                       fleetSyncStats.following ? "true" : "false",
+                       fleetSyncStats.received,
+                       fleetSyncStats.rejected,
+                       fleetSyncStats.startMinute,
+                       fleetSyncStats.hueSeed,
+                       fleetSyncStats.lastPhaseErrorUs);
+        publishStats(mqtt, "ring", payload, sizeof(payload), used);
+
+        // How much I2C traffic did the display's shadow buffer save, and is it keeping up?
+        used = appendf(payload, sizeof(payload), 0,
+                       "{\"i2cSent\":%u,\"i2cAvoided\":%u",
+                       display.getTransactionsSent(),
+                       display.getTransactionsAvoided());
+        used = appendFrameStats(payload, sizeof(payload), used, "frames", displayFrameStats);
+        publishStats(mqtt, "display", payload, sizeof(payload), used);
+
+        // How well is the clock being kept?
+        used = appendf(payload, sizeof(payload), 0,
+                       "{\"discipline\":{\"syncs\":%u,\"steps\":%u,\"firstOffsetUs\":%d,\"lastOffsetUs\":%d,\"maxOffsetUs\":%d,\"driftPpb\":%d,\"pollIntervalS\":%u}",
+                       timeDisciplineStats.syncs,
+                       timeDisciplineStats.steps,
+                       timeDisciplineStats.firstOffsetUs,
+                       timeDisciplineStats.lastOffsetUs,
+                       timeDisciplineStats.maxOffsetUs,
+                       timeDisciplineStats.driftPpb,
+                       timeDisciplineStats.pollInterval);
+
+        // Do the display's DST rules match TZ? (If not, it's using localtime_r())
+        used = appendf(payload, sizeof(payload), used,
+                       ",\"civilTime\":{\"checked\":%s,\"agrees\":%s,\"mismatches\":%u}",
+                       civilTimeZoneStats.checked ? "true" : "false",
+                       civilTimeZoneStats.agrees ? "true" : "false",
+                       civilTimeZoneStats.mismatches);
+        publishStats(mqtt, "time", payload, sizeof(payload), used);
+
+        // How many MQTT messages came in, and how many of them did anything get done with?
+        used = appendf(payload, sizeof(payload), 0,
+                       "{\"received\":%u,\"batches\":%u,\"coalesced\":%u,\"handled\":%u,\"unrouted\":%u",
+                       messageStats.received,
+                       messageStats.batches,
+                       messageStats.coalesced,
+                       messageStats.handled,
+                       messageStats.unrouted);
+
+        // How big are the config messages, and how long do they take to parse?
+        used = appendf(payload, sizeof(payload), used, ",\"config\":{");
+        for (uint8_t i = 0; i < CONFIG_FORMAT_COUNT; i++)
+        {
+            const ConfigFormatStats &stats = configFormatStats[i];
+            used = appendf(payload, sizeof(payload), used,
+                           "%s\"%s\":{\"messages\":%u,\"lastBytes\":%u,\"lastParseUs\":%u,\"maxParseUs\":%u}",
+                           i == 0 ? "" : ",",
+                           i == CONFIG_FORMAT_MSGPACK ? "msgpack" : "json",
+                           stats.messages,
+                           stats.lastBytes,
+                           stats.lastParseUs,
+                           stats.maxParseUs);
+        }
+        used = appendf(payload, sizeof(payload), used, "}");
+        publishStats(mqtt, "messages", payload, sizeof(payload), used);
+
+        // How long did each boot stage take, and how long until the display was right?
+        used = appendf(payload, sizeof(payload), 0, "{");
+        for (uint8_t i = 0; i < getBootStageCount(); i++)
+        {
+            used = appendf(payload, sizeof(payload), used, "\"%sMs\":%u,", getBootStageName(i), getBootStageDuration(i));
+        }
+        used = appendf(payload, sizeof(payload), used, "\"firstCorrectDisplayMs\":%u,", getFirstCorrectDisplayMs());
+
+        // Did we come back from a reboot with the time, and how long was the display without it?
+        used = appendf(payload, sizeof(payload), used,
+                       "\"warmStart\":%d,\"warmStartUncertaintyMs\":%u,\"warmStartDarkMs\":%u",
+                       getWarmStartStatus(),
+                       getWarmStartUncertaintyMs(),
+                       getWarmStartDarkMs());
+        publishStats(mqtt, "boot", payload, sizeof(payload), used);
+
+        updateFrameStatsServiceText("ring", ringFrameStats);
+        updateFrameStatsServiceText("display", displayFrameStats);
+
+        /*
+            How much of the stack, heap and CPU is everything using? There's no per-task
+            CPU use, since that needs configGENERATE_RUN_TIME_STATS and the Arduino core
+            doesn't turn it on. The ring and display loops time themselves instead,
+            which covers the tasks we care about.
+        */
+        used = appendf(payload, sizeof(payload), 0,
+                       "{\"heap\":{\"free\":%u,\"minimumFree\":%u,\"largestFreeBlock\":%u}",
+                       ESP.getFreeHeap(),
+                       ESP.getMinFreeHeap(),
+                       ESP.getMaxAllocHeap());
+
+        uint32_t nowUs = micros();
+        uint32_t elapsedUs = nowUs - lastStatsUs;
+        lastStatsUs = nowUs;
+        used = appendf(payload, sizeof(payload), used,
+                       ",\"load\":{\"ringPercent\":%u,\"displayPercent\":%u}",
+                       loopBusyPercent(ringFrameStats, lastRingBusyUs, elapsedUs),
+                       loopBusyPercent(displayFrameStats, lastDisplayBusyUs, elapsedUs));
+
+        // Say so when FreeRTOS isn't keeping track, rather than just leaving it out
+#if configUSE_TRACE_FACILITY == 1
+        used = appendTaskStats(payload, sizeof(payload), used);
+#else
+        used = appendf(payload, sizeof(payload), used, ",\"tasks\":\"unavailable\"");
+#endif
+        publishStats(mqtt, "system", payload, sizeof(payload), used);
+    }
+}
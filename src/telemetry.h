@@ -0,0 +1,29 @@
+
+#pragma once
+
+#include <Arduino.h>
+
+extern "C"
+{
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+}
+
+#include "logging/logging.h"
+#include "mqtt/mqtt.h"
+
+// How often to publish the stats
+#define TELEMETRY_INTERVAL_MS (60 * 1000)
+
+// How many tasks can we keep track of?
+#define TELEMETRY_MAX_TASKS 32
+
+/**
+ * @brief Periodically publishes the clock's stats to MQTT
+ *
+ * Each part of the clock goes out on its own topic under "stats/" (ring,
+ * display, time, messages, boot and system).
+ *
+ * pvParameters needs to be a pointer to the (connected) MQTT object to publish with.
+ */
+portTASK_FUNCTION_PROTO(telemetryTask, pvParameters);
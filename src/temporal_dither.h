@@ -0,0 +1,86 @@
+
+#pragma once
+
+#include <Arduino.h>
+
+/*
+    Temporal dithering for the LED ring
+
+    At the brightness the ring usually runs at, each channel only has a handful
+    of 8 bit levels to work with, so slow fades move in visible jumps. If the
+    ring runs a few times faster than the fade changes, we can flick each
+    channel between the two nearest levels so the average over a few frames is
+    the level we actually wanted.
+
+    This is first order error diffusion in time: whatever got rounded off this
+    frame gets added to the same channel next frame. It costs an add and a
+    couple of shifts per channel, and the error never grows past one step.
+*/
+
+/**
+ * @brief Turns 8.8 fixed point levels into LED bytes, with or without dithering
+ *
+ * @tparam CHANNELS How many channels (3 per pixel)
+ */
+template <uint16_t CHANNELS>
+class TemporalDither
+{
+public:
+    TemporalDither()
+    {
+        reset();
+    }
+
+    /**
+     * @brief Forgets the error carried over from the last frame
+     */
+    void reset()
+    {
+        memset(error, 0, sizeof(error));
+    }
+
+    /**
+     * @brief Dithers one frame
+     *
+     * @param levels The levels we want (see scaleChannel16())
+     * @param out Where to put the bytes for the LEDs
+     */
+    void render(const uint16_t *levels, uint8_t *out)
+    {
+#pragma GCC unroll 4
+        for (uint16_t i = 0; i < CHANNELS; i++)
+        {
+            uint32_t sum = (uint32_t)levels[i] + error[i];
+
+            // Don't try to carry past full on
+            if (sum >= 0xFF00)
+            {
+                out[i] = 0xFF;
+                error[i] = 0;
+            }
+            else
+            {
+                out[i] = sum >> 8;
+                error[i] = sum & 0xFF;
+            }
+        }
+    }
+
+    /**
+     * @brief Just drops the fractions, for when we're not dithering
+     *
+     * @param levels The levels we want (see scaleChannel16())
+     * @param out Where to put the bytes for the LEDs
+     */
+    static void truncate(const uint16_t *levels, uint8_t *out)
+    {
+#pragma GCC unroll 4
+        for (uint16_t i = 0; i < CHANNELS; i++)
+        {
+            out[i] = levels[i] >> 8;
+        }
+    }
+
+private:
+    uint8_t error[CHANNELS];
+};
@@ -0,0 +1,199 @@
+
+#include <Arduino.h>
+
+#include <sys/time.h>
+
+extern "C"
+{
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+}
+
+#include "esp_sntp.h"
+
+#include "logging/logging.h"
+
+#include "time_discipline.h"
+
+using namespace creatures;
+
+static Logger l;
+
+TimeDisciplineStats timeDisciplineStats = {0, 0, 0, 0, 0, 0, TIME_DISCIPLINE_MIN_POLL_S};
+TaskHandle_t timeDisciplineTaskHandle;
+
+// The last offset from SNTP that the task hasn't dealt with yet
+static volatile int32_t pendingOffsetUs = 0;
+static volatile boolean offsetPending = false;
+
+// Did the clock just get stepped? Then the drift has to be measured from there.
+static volatile boolean stepped = true;
+
+static int64_t microsecondsOf(const struct timeval &tv)
+{
+    return (int64_t)tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+/**
+ * @brief Called by SNTP when it has the time from the server
+ *
+ * This replaces the (weak) one in ESP-IDF. It runs in the lwIP task, so it only
+ * steps the clock if it has to and leaves the slewing to timeDisciplineTask.
+ */
+extern "C" void sntp_sync_time(struct timeval *tv)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    int64_t offsetUs = microsecondsOf(*tv) - microsecondsOf(now);
+
+    timeDisciplineStats.syncs++;
+
+    if (offsetUs >= TIME_DISCIPLINE_STEP_US || offsetUs <= -TIME_DISCIPLINE_STEP_US)
+    {
+        // Cancel any slewing that's still going on, it's not going to be right anymore
+        struct timeval zero = {0, 0};
+        adjtime(&zero, NULL);
+        settimeofday(tv, NULL);
+
+        timeDisciplineStats.steps++;
+        stepped = true;
+        offsetPending = false;
+    }
+    else
+    {
+        pendingOffsetUs = offsetUs;
+        offsetPending = true;
+    }
+
+    timeDisciplineStats.lastOffsetUs = offsetUs > INT32_MAX ? INT32_MAX : (offsetUs < INT32_MIN ? INT32_MIN : offsetUs);
+    if (timeDisciplineStats.syncs == 1)
+    {
+        timeDisciplineStats.firstOffsetUs = timeDisciplineStats.lastOffsetUs;
+    }
+
+    // Ask less often when things are steady, and more often when they're not
+    uint32_t poll = timeDisciplineStats.pollInterval;
+    if (offsetUs < TIME_DISCIPLINE_STABLE_US && offsetUs > -TIME_DISCIPLINE_STABLE_US)
+    {
+        poll = poll * 2 > TIME_DISCIPLINE_MAX_POLL_S ? TIME_DISCIPLINE_MAX_POLL_S : poll * 2;
+    }
+    else
+    {
+        poll = poll / 2 < TIME_DISCIPLINE_MIN_POLL_S ? TIME_DISCIPLINE_MIN_POLL_S : poll / 2;
+    }
+    timeDisciplineStats.pollInterval = poll;
+
+    // This gets used when SNTP schedules the next request, which happens right after we return
+    sntp_set_sync_interval(poll * 1000);
+
+    sntp_set_sync_status(SNTP_SYNC_STATUS_COMPLETED);
+
+    if (timeDisciplineTaskHandle != NULL)
+    {
+        xTaskNotifyGive(timeDisciplineTaskHandle);
+    }
+}
+
+/**
+ * @brief Adds to whatever slewing adjtime() is still working on
+ */
+static void addSlew(int64_t deltaUs, boolean replace)
+{
+    int64_t totalUs = deltaUs;
+    if (!replace)
+    {
+        struct timeval outstanding;
+        adjtime(NULL, &outstanding);
+        totalUs += microsecondsOf(outstanding);
+    }
+
+    struct timeval delta;
+    delta.tv_sec = totalUs / 1000000LL;
+    delta.tv_usec = totalUs % 1000000LL;
+    adjtime(&delta, NULL);
+}
+
+portTASK_FUNCTION(timeDisciplineTask, pvParameters)
+{
+    l.info("time discipline task started");
+
+    sntp_set_sync_interval(timeDisciplineStats.pollInterval * 1000);
+
+    // Our own idea of the drift, in more detail than the stats
+    int64_t driftPpb = 0;
+
+    // When the last sync was, and when we last slewed for drift (on the monotonic timer)
+    int64_t lastSyncUs = esp_timer_get_time();
+    int64_t lastTickUs = lastSyncUs;
+
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(TIME_DISCIPLINE_TICK_MS));
+
+        int64_t nowUs = esp_timer_get_time();
+
+        if (offsetPending)
+        {
+            int32_t offsetUs = pendingOffsetUs;
+            offsetPending = false;
+
+            struct timeval outstanding;
+            adjtime(NULL, &outstanding);
+
+            /*
+                Whatever's still being slewed from before was going to fix part of this
+                offset anyway. What's left is how much our drift guess was off by over
+                the time since the last sync.
+            */
+            int64_t sinceSyncUs = nowUs - lastSyncUs;
+            if (!stepped && sinceSyncUs > 0)
+            {
+                int64_t residualUs = offsetUs - microsecondsOf(outstanding);
+                int64_t residualPpb = residualUs * 1000000000LL / sinceSyncUs;
+
+                driftPpb += residualPpb / TIME_DISCIPLINE_DRIFT_GAIN;
+                if (driftPpb > TIME_DISCIPLINE_MAX_DRIFT_PPB)
+                {
+                    driftPpb = TIME_DISCIPLINE_MAX_DRIFT_PPB;
+                }
+                else if (driftPpb < -TIME_DISCIPLINE_MAX_DRIFT_PPB)
+                {
+                    driftPpb = -TIME_DISCIPLINE_MAX_DRIFT_PPB;
+                }
+            }
+            stepped = false;
+            lastSyncUs = nowUs;
+            lastTickUs = nowUs;
+
+            // The offset was measured against where the clock is now, so it replaces what's left over
+            addSlew(offsetUs, true);
+
+            int32_t magnitude = offsetUs < 0 ? -offsetUs : offsetUs;
+            if (magnitude > timeDisciplineStats.maxOffsetUs)
+            {
+                timeDisciplineStats.maxOffsetUs = magnitude;
+            }
+            timeDisciplineStats.driftPpb = driftPpb;
+
+            l.debug("slewing %dus, drift is now %dppb, polling every %us",
+                    offsetUs, (int32_t)driftPpb, timeDisciplineStats.pollInterval);
+        }
+        else if (stepped)
+        {
+            // Start measuring the drift over from the step
+            stepped = false;
+            lastSyncUs = nowUs;
+            lastTickUs = nowUs;
+        }
+        else
+        {
+            // Slew out the drift we expect since the last time we did
+            int64_t driftUs = driftPpb * (nowUs - lastTickUs) / 1000000000LL;
+            if (driftUs != 0)
+            {
+                addSlew(driftUs, false);
+                lastTickUs = nowUs;
+            }
+        }
+    }
+}
@@ -0,0 +1,70 @@
+
+#pragma once
+
+#include <Arduino.h>
+
+extern "C"
+{
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+}
+
+/*
+    Keeps the system clock in line with SNTP without jumping it around
+
+    By default, every time SNTP hears back from the server it just sets the
+    clock, so the seconds ring lurches whenever the crystal has wandered off.
+    Instead, this takes over sntp_sync_time() and:
+
+        - slews small offsets out with adjtime() so the clock never jumps
+          (it only steps if it's off by more than TIME_DISCIPLINE_STEP_US,
+          like on the first sync)
+        - works out how fast the crystal drifts from how far off it was since
+          the last sync, and slews that out a little at a time in between
+        - asks the server less often when the clock is holding steady, and
+          more often when it isn't
+*/
+
+// Step the clock (instead of slewing it) if it's off by more than this
+#define TIME_DISCIPLINE_STEP_US 1000000L
+
+// If a sync finds the clock within this, it's stable and we can back off
+#define TIME_DISCIPLINE_STABLE_US 20000L
+
+// How often SNTP polls, in seconds. It doubles when stable, halves when not.
+#define TIME_DISCIPLINE_MIN_POLL_S 64
+#define TIME_DISCIPLINE_MAX_POLL_S 4096
+
+// How often to slew out the drift we've worked out
+#define TIME_DISCIPLINE_TICK_MS (10 * 1000)
+
+// How much of each new drift measurement to take (1/n), so one bad sync doesn't throw it off
+#define TIME_DISCIPLINE_DRIFT_GAIN 4
+
+// Don't believe we're drifting faster than this, in parts per billion
+#define TIME_DISCIPLINE_MAX_DRIFT_PPB 500000L
+
+/**
+ * @brief How well the clock is being kept
+ */
+struct TimeDisciplineStats
+{
+    uint32_t syncs;        // How many times SNTP came back with the time
+    uint32_t steps;        // How many of those were so far off we had to step
+    int32_t firstOffsetUs; // How far off the clock was at the first sync (so how good a warm start's guess was)
+    int32_t lastOffsetUs;  // How far off the clock was at the last sync (positive means behind)
+    int32_t maxOffsetUs;   // The worst offset we've slewed out
+    int32_t driftPpb;      // How fast we think the crystal is running slow (positive) or fast
+    uint32_t pollInterval; // How often SNTP is polling now, in seconds
+};
+
+extern TimeDisciplineStats timeDisciplineStats;
+
+extern TaskHandle_t timeDisciplineTaskHandle;
+
+/**
+ * @brief Slews the clock for drift and for each SNTP sync
+ *
+ * Start this before SNTP so it can set the poll interval from the start.
+ */
+portTASK_FUNCTION_PROTO(timeDisciplineTask, pvParameters);
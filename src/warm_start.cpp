@@ -0,0 +1,170 @@
+
+#include <Arduino.h>
+
+#include <sys/time.h>
+
+extern "C"
+{
+#include "freertos/FreeRTOS.h"
+}
+
+#include "esp32/rom/crc.h"
+#include "esp32/rtc.h"
+
+#include "civil_time.h"
+#include "clock_config.h"
+#include "warm_start.h"
+
+/**
+ * @brief What we keep in RTC memory
+ *
+ * It's laid out so there isn't any padding, so the CRC covers every byte.
+ */
+struct WarmState
+{
+    int64_t epochUs;     // The wall clock when the time was saved
+    uint64_t rtcUs;      // The RTC when the time was saved
+    uint32_t magic;      // WARM_START_MAGIC
+    int32_t utcOffset;   // CIVIL_TIME_UTC_OFFSET when the time was saved
+    uint16_t ringHue;    // What the ring was fading to
+    uint8_t version;     // WARM_START_VERSION
+    uint8_t timeValid;   // Has the time been saved yet?
+    ClockConfig config;  // The config when the time was saved
+    uint32_t crc;        // CRC32 of everything above
+};
+
+// Not cleared on a reset, only when the power goes away
+RTC_NOINIT_ATTR static WarmState warmState;
+
+// Both cores save to it
+static portMUX_TYPE warmStateLock = portMUX_INITIALIZER_UNLOCKED;
+
+static WarmStartStatus warmStartStatus = WARM_START_NONE;
+static uint32_t warmStartUncertaintyMs = 0;
+static int64_t warmStartSavedEpochUs = 0;
+static uint32_t warmStartDarkMs = 0;
+
+static uint32_t warmStateCrc(const WarmState &state)
+{
+    return crc32_le(0, (const uint8_t *)&state, offsetof(WarmState, crc));
+}
+
+static boolean warmStateGood(const WarmState &state)
+{
+    return state.magic == WARM_START_MAGIC &&
+           state.version == WARM_START_VERSION &&
+           state.crc == warmStateCrc(state);
+}
+
+WarmStartStatus warmStart()
+{
+    WarmState state = warmState;
+
+    if (!warmStateGood(state))
+    {
+        // Start over, so the saves have something good to build on
+        memset(&warmState, 0, sizeof(warmState));
+        warmState.magic = WARM_START_MAGIC;
+        warmState.version = WARM_START_VERSION;
+        getClockConfig(warmState.config);
+        warmState.crc = warmStateCrc(warmState);
+
+        warmStartStatus = WARM_START_NONE;
+        return warmStartStatus;
+    }
+
+    setClockConfig(state.config);
+    warmStartStatus = WARM_START_CONFIG;
+
+    // If the time zone changed, or the RTC got reset, the time's no good
+    uint64_t rtcUs = esp_rtc_get_time_us();
+    if (!state.timeValid || state.utcOffset != CIVIL_TIME_UTC_OFFSET || rtcUs < state.rtcUs)
+    {
+        return warmStartStatus;
+    }
+
+    uint64_t downUs = rtcUs - state.rtcUs;
+    uint64_t uncertaintyMs = downUs * WARM_START_RTC_DRIFT_PPM / 1000000000ULL;
+    if (uncertaintyMs > WARM_START_MAX_UNCERTAINTY_MS)
+    {
+        return warmStartStatus;
+    }
+
+    // Our best guess
+    int64_t nowUs = state.epochUs + (int64_t)downUs;
+    struct timeval now;
+    now.tv_sec = nowUs / 1000000LL;
+    now.tv_usec = nowUs % 1000000LL;
+    settimeofday(&now, NULL);
+
+    warmStartSavedEpochUs = state.epochUs;
+    warmStartUncertaintyMs = uncertaintyMs;
+    warmStartStatus = WARM_START_TIME;
+    return warmStartStatus;
+}
+
+WarmStartStatus getWarmStartStatus()
+{
+    return warmStartStatus;
+}
+
+uint32_t getWarmStartUncertaintyMs()
+{
+    return warmStartUncertaintyMs;
+}
+
+boolean getWarmRingHue(uint16_t &hue)
+{
+    if (warmStartStatus == WARM_START_NONE)
+    {
+        return false;
+    }
+
+    hue = warmState.ringHue;
+    return true;
+}
+
+void saveWarmTime()
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    uint64_t rtcUs = esp_rtc_get_time_us();
+
+    ClockConfig config;
+    getClockConfig(config);
+
+    portENTER_CRITICAL(&warmStateLock);
+    warmState.epochUs = (int64_t)now.tv_sec * 1000000LL + now.tv_usec;
+    warmState.rtcUs = rtcUs;
+    warmState.utcOffset = CIVIL_TIME_UTC_OFFSET;
+    warmState.timeValid = 1;
+    warmState.config = config;
+    warmState.crc = warmStateCrc(warmState);
+    portEXIT_CRITICAL(&warmStateLock);
+}
+
+void saveWarmRingHue(uint16_t hue)
+{
+    portENTER_CRITICAL(&warmStateLock);
+    warmState.ringHue = hue;
+    warmState.crc = warmStateCrc(warmState);
+    portEXIT_CRITICAL(&warmStateLock);
+}
+
+void markWarmTimeDisplayed()
+{
+    if (warmStartStatus != WARM_START_TIME || warmStartDarkMs != 0)
+    {
+        return;
+    }
+
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    int64_t darkUs = (int64_t)now.tv_sec * 1000000LL + now.tv_usec - warmStartSavedEpochUs;
+    warmStartDarkMs = darkUs > 0 ? darkUs / 1000 : 1;
+}
+
+uint32_t getWarmStartDarkMs()
+{
+    return warmStartDarkMs;
+}
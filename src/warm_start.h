@@ -0,0 +1,100 @@
+
+#pragma once
+
+#include <Arduino.h>
+
+#include "clock_config.h"
+
+/*
+    Picks up where we left off after a reboot
+
+    After an OTA update (or a crash, or a brownout) the clock used to show the
+    boot phase until WiFi, mDNS and SNTP were all up. But the RTC keeps counting
+    through a reset, and RTC slow memory keeps its contents, so we keep the last
+    good time (and the config and the ring's colour) there. On the way back up
+    we can work out about what time it is right away and show that while SNTP
+    confirms it (or fixes it) in the background.
+
+    The RTC's slow clock isn't as good as the crystal, so the guess gets worse
+    the longer we were down. If it could be off by more than
+    WARM_START_MAX_UNCERTAINTY_MS, we don't use it. If there's nothing in RTC
+    memory at all (like after power on), the config comes from NVS instead.
+*/
+
+// Bump this any time WarmState changes
+#define WARM_START_VERSION 2
+#define WARM_START_MAGIC 0xC10CC10C
+
+/*
+    How far off the RTC's slow clock could be, in parts per million
+
+    It runs off the internal 150 kHz RC oscillator, which the ESP32 datasheet
+    only promises to within +/- 5%. ESP-IDF calibrates it against the crystal,
+    but it moves with temperature and nothing checks it while we're down, so
+    go with the datasheet. With WARM_START_MAX_UNCERTAINTY_MS that means we only
+    guess if we were down for less than 100s, which is still plenty for an OTA
+    update or a crash.
+*/
+#define WARM_START_RTC_DRIFT_PPM 50000
+
+// Don't show a guess that could be off by more than this
+#define WARM_START_MAX_UNCERTAINTY_MS 5000
+
+enum WarmStartStatus
+{
+    WARM_START_NONE,   // Nothing good in RTC memory
+    WARM_START_CONFIG, // Got the config and the ring's colour, but not the time
+    WARM_START_TIME    // Got all of it, and the clock is set to our best guess
+};
+
+/**
+ * @brief Restores what we can from RTC memory
+ *
+ * Call this first thing in setup(). It doesn't log anything, since the logger
+ * isn't running yet.
+ *
+ * @return WarmStartStatus what we got back
+ */
+WarmStartStatus warmStart();
+
+WarmStartStatus getWarmStartStatus();
+
+/**
+ * @brief How far off the guessed time could be, in ms (0 if we didn't guess)
+ */
+uint32_t getWarmStartUncertaintyMs();
+
+/**
+ * @brief The colour the ring was fading to before the reboot
+ *
+ * @param hue Where to put it
+ * @return true if there was one
+ */
+boolean getWarmRingHue(uint16_t &hue);
+
+/**
+ * @brief Saves the time (and the config) to RTC memory
+ *
+ * Only call this when the clock is known to be right.
+ */
+void saveWarmTime();
+
+/**
+ * @brief Saves the colour the ring is fading to
+ */
+void saveWarmRingHue(uint16_t hue);
+
+/**
+ * @brief Notes that the guessed time just went up on the display
+ *
+ * Only the first call counts.
+ */
+void markWarmTimeDisplayed();
+
+/**
+ * @brief How long the display went without the time across the reboot, in ms
+ *
+ * This is from the last time the right time was saved before the reboot to
+ * when the guess went up on the display after it. 0 if we didn't guess.
+ */
+uint32_t getWarmStartDarkMs();
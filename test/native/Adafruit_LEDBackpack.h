@@ -0,0 +1,155 @@
+
+#pragma once
+
+#include <Arduino.h>
+
+/*
+    A mock of the Adafruit 7-segment backpack
+
+    The digits are kept in displaybuffer the same way the real library keeps
+    them, and everything that would go out on the I2C bus goes to a
+    MockI2CDevice instead, so a test can see exactly what got sent.
+*/
+
+/**
+ * @brief Records what would have gone out on the I2C bus
+ */
+class MockI2CDevice
+{
+public:
+    MockI2CDevice()
+    {
+        reset();
+    }
+
+    bool write(const uint8_t *buffer, size_t length)
+    {
+        writes++;
+        bytesWritten += length;
+        lastLength = length < sizeof(last) ? length : sizeof(last);
+        memcpy(last, buffer, lastLength);
+        return true;
+    }
+
+    void reset()
+    {
+        writes = 0;
+        bytesWritten = 0;
+        lastLength = 0;
+        memset(last, 0, sizeof(last));
+    }
+
+    uint32_t writes;
+    uint32_t bytesWritten;
+    uint8_t last[17];
+    size_t lastLength;
+};
+
+class Adafruit_LEDBackpack
+{
+public:
+    Adafruit_LEDBackpack()
+    {
+        i2c_dev = &bus;
+        clear();
+    }
+
+    bool begin(uint8_t = 0x70)
+    {
+        // The real one turns on the oscillator and the display
+        uint8_t command = 0x21;
+        i2c_dev->write(&command, 1);
+        command = 0x81;
+        i2c_dev->write(&command, 1);
+        return true;
+    }
+
+    void setBrightness(uint8_t brightness)
+    {
+        uint8_t command = 0xE0 | (brightness > 15 ? 15 : brightness);
+        i2c_dev->write(&command, 1);
+    }
+
+    void writeDisplay()
+    {
+        uint8_t buffer[17];
+        buffer[0] = 0;
+        for (uint8_t i = 0; i < 8; i++)
+        {
+            buffer[1 + 2 * i] = displaybuffer[i] & 0xFF;
+            buffer[2 + 2 * i] = displaybuffer[i] >> 8;
+        }
+        i2c_dev->write(buffer, sizeof(buffer));
+    }
+
+    void clear()
+    {
+        memset(displaybuffer, 0, sizeof(displaybuffer));
+    }
+
+    MockI2CDevice &getBus()
+    {
+        return bus;
+    }
+
+    uint16_t displaybuffer[8];
+
+protected:
+    MockI2CDevice *i2c_dev;
+
+private:
+    MockI2CDevice bus;
+};
+
+class Adafruit_7segment : public Adafruit_LEDBackpack
+{
+public:
+    /**
+     * @brief Right justifies a number over the four digits (positions 0, 1, 3 and 4)
+     */
+    size_t print(int number)
+    {
+        static const uint8_t positions[4] = {4, 3, 1, 0};
+
+        clearDigits();
+        for (uint8_t i = 0; i < 4; i++)
+        {
+            writeDigitNum(positions[i], number % 10);
+            number /= 10;
+            if (number == 0)
+            {
+                break;
+            }
+        }
+        return 4;
+    }
+
+    size_t print(const char *text)
+    {
+        clearDigits();
+        return strlen(text);
+    }
+
+    void writeDigitRaw(uint8_t position, uint8_t bitmask)
+    {
+        if (position < 5)
+        {
+            displaybuffer[position] = bitmask;
+        }
+    }
+
+    void writeDigitNum(uint8_t position, uint8_t number, bool dot = false)
+    {
+        static const uint8_t numbers[10] = {0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07, 0x7F, 0x6F};
+        writeDigitRaw(position, numbers[number % 10] | (dot << 7));
+    }
+
+private:
+    void clearDigits()
+    {
+        displaybuffer[0] = 0;
+        displaybuffer[1] = 0;
+        displaybuffer[3] = 0;
+        displaybuffer[4] = 0;
+    }
+};
@@ -0,0 +1,19 @@
+
+#pragma once
+
+#include <Arduino.h>
+
+/*
+    Just the pixel type constants from Adafruit_NeoPixel, which is all the ring's
+    rendering needs. The byte offsets are packed the same way the real library
+    packs them.
+*/
+
+#define NEO_RGB ((0 << 6) | (0 << 4) | (1 << 2) | (2))
+#define NEO_RBG ((0 << 6) | (0 << 4) | (2 << 2) | (1))
+#define NEO_GRB ((1 << 6) | (1 << 4) | (0 << 2) | (2))
+#define NEO_GBR ((2 << 6) | (2 << 4) | (0 << 2) | (1))
+#define NEO_BRG ((1 << 6) | (1 << 4) | (2 << 2) | (0))
+#define NEO_BGR ((2 << 6) | (2 << 4) | (1 << 2) | (0))
+
+#define NEO_KHZ800 0x0000
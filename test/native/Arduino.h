@@ -0,0 +1,228 @@
+
+#pragma once
+
+/*
+    The little bit of the Arduino core that the clock's logic uses, for the host
+
+    Only what the sources in the native environment need is here. Time comes
+    from the host's steady clock (which a test can move ahead), and the "cycle counter" pretends to be an
+    ESP32 at 240MHz so FrameStats and the effect budgets come out in the same
+    units as they do on the board (the host is a lot faster, so think of host
+    numbers as a lower bound).
+
+    The wall clock (gettimeofday() and friends) is our own too, so a test can
+    put it right before a minute edge. It runs off the same clock as millis(),
+    and adjtime() slews it at 1/64 speed like ESP-IDF's does.
+*/
+
+#include <limits.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <chrono>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define IRAM_ATTR
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
+
+#define NATIVE_CPU_FREQ_MHZ 240
+
+// How far a test has moved time along, on top of the host's clock
+inline uint64_t &nativeSkewNs()
+{
+    static uint64_t skew = 0;
+    return skew;
+}
+
+inline uint64_t nativeNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+               .count() +
+           nativeSkewNs();
+}
+
+/**
+ * @brief Lets time pass without waiting for it (for things like quiet periods)
+ */
+inline void nativeAdvanceMs(unsigned long ms)
+{
+    nativeSkewNs() += (uint64_t)ms * 1000000;
+}
+
+inline unsigned long millis()
+{
+    return (unsigned long)(nativeNowNs() / 1000000);
+}
+
+inline unsigned long micros()
+{
+    return (unsigned long)(nativeNowNs() / 1000);
+}
+
+/**
+ * @brief What esp_timer says, the microseconds since "boot"
+ */
+inline int64_t esp_timer_get_time()
+{
+    return (int64_t)(nativeNowNs() / 1000);
+}
+
+struct NativeWallClock
+{
+    bool set;
+    int64_t offsetUs;     // Wall clock minus esp_timer_get_time()
+    int64_t slewUs;       // How much adjtime() still has to slew
+    uint64_t slewedToNs;  // When the slewing was last brought up to date
+};
+
+inline NativeWallClock &nativeWallClock()
+{
+    static NativeWallClock clock = {false, 0, 0, 0};
+    return clock;
+}
+
+/**
+ * @brief The wall clock, in microseconds since the epoch
+ *
+ * It starts out at the host's time. Any slewing that's due gets applied first.
+ */
+inline int64_t nativeWallClockUs()
+{
+    NativeWallClock &clock = nativeWallClock();
+    uint64_t now = nativeNowNs();
+
+    if (!clock.set)
+    {
+        int64_t hostUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                             std::chrono::system_clock::now().time_since_epoch())
+                             .count();
+        clock.offsetUs = hostUs - (int64_t)(now / 1000);
+        clock.slewUs = 0;
+        clock.set = true;
+    }
+
+    if (clock.slewUs == 0)
+    {
+        clock.slewedToNs = now;
+    }
+    else
+    {
+        int64_t stepUs = (int64_t)((now - clock.slewedToNs) / 1000 / 64);
+        int64_t leftUs = clock.slewUs < 0 ? -clock.slewUs : clock.slewUs;
+        if (stepUs > leftUs)
+        {
+            stepUs = leftUs;
+        }
+        if (clock.slewUs < 0)
+        {
+            stepUs = -stepUs;
+        }
+        clock.offsetUs += stepUs;
+        clock.slewUs -= stepUs;
+        clock.slewedToNs = clock.slewUs == 0 ? now : clock.slewedToNs + (uint64_t)(stepUs < 0 ? -stepUs : stepUs) * 64 * 1000;
+    }
+
+    return clock.offsetUs + (int64_t)(now / 1000);
+}
+
+/**
+ * @brief Sets the wall clock (and forgets any slewing), like settimeofday()
+ */
+inline void nativeSetWallClockUs(int64_t us)
+{
+    NativeWallClock &clock = nativeWallClock();
+    uint64_t now = nativeNowNs();
+    clock.offsetUs = us - (int64_t)(now / 1000);
+    clock.slewUs = 0;
+    clock.slewedToNs = now;
+    clock.set = true;
+}
+
+inline int nativeGettimeofday(struct timeval *tv, void *)
+{
+    int64_t us = nativeWallClockUs();
+    tv->tv_sec = us / 1000000LL;
+    tv->tv_usec = us % 1000000LL;
+    return 0;
+}
+
+inline int nativeSettimeofday(const struct timeval *tv, const void *)
+{
+    nativeSetWallClockUs((int64_t)tv->tv_sec * 1000000LL + tv->tv_usec);
+    return 0;
+}
+
+inline int nativeAdjtime(const struct timeval *delta, struct timeval *olddelta)
+{
+    NativeWallClock &clock = nativeWallClock();
+    nativeWallClockUs();
+
+    if (olddelta != NULL)
+    {
+        olddelta->tv_sec = clock.slewUs / 1000000LL;
+        olddelta->tv_usec = clock.slewUs % 1000000LL;
+    }
+    if (delta != NULL)
+    {
+        clock.slewUs = (int64_t)delta->tv_sec * 1000000LL + delta->tv_usec;
+        clock.slewedToNs = nativeNowNs();
+    }
+    return 0;
+}
+
+#define gettimeofday nativeGettimeofday
+#define settimeofday nativeSettimeofday
+#define adjtime nativeAdjtime
+
+/**
+ * @brief Just enough of an IP address to show one on the display
+ */
+class IPAddress
+{
+public:
+    IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0)
+    {
+        bytes[0] = a;
+        bytes[1] = b;
+        bytes[2] = c;
+        bytes[3] = d;
+    }
+
+    uint8_t operator[](int index) const
+    {
+        return bytes[index];
+    }
+
+private:
+    uint8_t bytes[4];
+};
+
+inline long random(long howsmall, long howbig)
+{
+    return howsmall + rand() % (howbig - howsmall);
+}
+
+class EspClass
+{
+public:
+    uint32_t getCycleCount()
+    {
+        return (uint32_t)(nativeNowNs() * NATIVE_CPU_FREQ_MHZ / 1000);
+    }
+
+    uint32_t getCpuFreqMHz()
+    {
+        return NATIVE_CPU_FREQ_MHZ;
+    }
+};
+
+static EspClass ESP __attribute__((unused));
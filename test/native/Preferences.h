@@ -0,0 +1,107 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+    NVS on the host, which is just a map that lives as long as the test does
+
+    Only the bytes calls are here, since that's all the config store uses. Like
+    the real one, getBytes() won't hand back a blob that doesn't fit in the
+    buffer it was given. Tests can poke at what's "in flash" with the static
+    helpers.
+*/
+
+class Preferences
+{
+public:
+    Preferences()
+    {
+        opened = false;
+        readOnly = false;
+    }
+
+    bool begin(const char *name, bool readOnly = false)
+    {
+        space = name;
+        this->readOnly = readOnly;
+        opened = true;
+        return true;
+    }
+
+    void end()
+    {
+        opened = false;
+    }
+
+    size_t getBytes(const char *key, void *buf, size_t maxLen)
+    {
+        if (!opened)
+        {
+            return 0;
+        }
+
+        std::map<std::string, std::vector<uint8_t>>::iterator found = storage().find(space + "/" + key);
+        if (found == storage().end() || found->second.size() > maxLen)
+        {
+            return 0;
+        }
+
+        memcpy(buf, found->second.data(), found->second.size());
+        return found->second.size();
+    }
+
+    size_t putBytes(const char *key, const void *value, size_t len)
+    {
+        if (!opened || readOnly)
+        {
+            return 0;
+        }
+
+        const uint8_t *bytes = (const uint8_t *)value;
+        storage()[space + "/" + key] = std::vector<uint8_t>(bytes, bytes + len);
+        nativeWrites()++;
+        return len;
+    }
+
+    // Put a blob straight into "flash", as if an older build had written it
+    static void nativeStore(const char *name, const char *key, const void *value, size_t len)
+    {
+        const uint8_t *bytes = (const uint8_t *)value;
+        storage()[std::string(name) + "/" + key] = std::vector<uint8_t>(bytes, bytes + len);
+    }
+
+    // How big the blob under a key is (0 if there isn't one)
+    static size_t nativeLength(const char *name, const char *key)
+    {
+        std::map<std::string, std::vector<uint8_t>>::iterator found = storage().find(std::string(name) + "/" + key);
+        return found == storage().end() ? 0 : found->second.size();
+    }
+
+    static void nativeClear()
+    {
+        storage().clear();
+        nativeWrites() = 0;
+    }
+
+    // How many times anything was written
+    static uint32_t &nativeWrites()
+    {
+        static uint32_t count = 0;
+        return count;
+    }
+
+private:
+    static std::map<std::string, std::vector<uint8_t>> &storage()
+    {
+        static std::map<std::string, std::vector<uint8_t>> flash;
+        return flash;
+    }
+
+    std::string space;
+    bool opened;
+    bool readOnly;
+};
@@ -0,0 +1,99 @@
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <unity.h>
+
+/*
+    Tiny helpers for the benchmarks in the native tests
+
+    Everything is timed with the host's steady clock. The numbers depend on the
+    host, so most tests only fail on limits with plenty of room in them; the
+    point is to have the same, reproducible measurement every time (fixed
+    inputs, fixed iteration counts) to compare changes against. The ring
+    effects' cycle budgets are tighter, see BENCH_ESP32_CYCLES_PER_HOST_NS.
+*/
+
+/*
+    Roughly how many ESP32 cycles one ns on the host is worth, for turning a
+    host benchmark into a budget for the board
+
+    A desktop core at about 4GHz gets through about 3 simple instructions a
+    cycle, so a host ns is about 12 instructions. The ESP32's LX6 at 240MHz
+    does about one a cycle. It's a rough guess (the ring's telemetry on the
+    board is the real answer), but it's the same guess every time.
+*/
+#define BENCH_ESP32_CYCLES_PER_HOST_NS 12
+
+// The sanitizers make everything a few times slower, so budgets get this much more room under them
+#if defined(__SANITIZE_ADDRESS__)
+#define BENCH_SLACK 4
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define BENCH_SLACK 4
+#endif
+#endif
+#ifndef BENCH_SLACK
+#define BENCH_SLACK 1
+#endif
+
+/**
+ * @brief Timing for a run of the same operation
+ */
+struct BenchResult
+{
+    uint32_t iterations;
+    uint64_t totalNs;
+    uint64_t worstNs;
+};
+
+/**
+ * @brief Times something, once per iteration
+ *
+ * @param iterations How many times to run it
+ * @param operation What to run (gets the iteration number)
+ */
+template <typename OPERATION>
+BenchResult runBench(uint32_t iterations, OPERATION operation)
+{
+    BenchResult result = {iterations, 0, 0};
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        uint64_t start = nativeNowNs();
+        operation(i);
+        uint64_t took = nativeNowNs() - start;
+
+        result.totalNs += took;
+        if (took > result.worstNs)
+        {
+            result.worstNs = took;
+        }
+    }
+    return result;
+}
+
+inline double benchMeanNs(const BenchResult &result)
+{
+    return (double)result.totalNs / result.iterations;
+}
+
+inline double benchPerSecond(const BenchResult &result)
+{
+    return result.totalNs == 0 ? 0 : result.iterations * 1e9 / result.totalNs;
+}
+
+/**
+ * @brief Prints a result as a test message
+ */
+inline void reportBench(const char *name, const BenchResult &result)
+{
+    char message[160];
+    snprintf(message, sizeof(message), "%s: %u runs, mean %.1fns, worst %lluns, %.0f/s",
+             name,
+             result.iterations,
+             benchMeanNs(result),
+             (unsigned long long)result.worstNs,
+             benchPerSecond(result));
+    TEST_MESSAGE(message);
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <vector>
+
+extern "C"
+{
+#include "freertos/FreeRTOS.h"
+}
+
+/*
+    ESP-IDF's RMT driver on the host
+
+    A write goes through the channel's translator right away (the same way the
+    real driver's ISR would feed it, a memory block at a time), and is done as
+    soon as it's written. What went out is kept per channel, both as the bytes
+    that were asked for and as the RMT items they turned into, so a test can
+    look at either. A test can also make writes take a while (of the caller's
+    time), like a slow strip would.
+*/
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_STATE 0x103
+
+typedef enum
+{
+    GPIO_NUM_13 = 13
+} gpio_num_t;
+
+typedef enum
+{
+    RMT_CHANNEL_0,
+    RMT_CHANNEL_1,
+    RMT_CHANNEL_2,
+    RMT_CHANNEL_3,
+    RMT_CHANNEL_4,
+    RMT_CHANNEL_5,
+    RMT_CHANNEL_6,
+    RMT_CHANNEL_7,
+    RMT_CHANNEL_MAX
+} rmt_channel_t;
+
+typedef struct
+{
+    union
+    {
+        struct
+        {
+            uint32_t duration0 : 15;
+            uint32_t level0 : 1;
+            uint32_t duration1 : 15;
+            uint32_t level1 : 1;
+        };
+        uint32_t val;
+    };
+} rmt_item32_t;
+
+typedef struct
+{
+    rmt_channel_t channel;
+    gpio_num_t gpio_num;
+    uint8_t clk_div;
+    uint8_t mem_block_num;
+} rmt_config_t;
+
+#define RMT_DEFAULT_CONFIG_TX(gpio, channel_id) {channel_id, gpio, 80, 1}
+
+typedef void (*sample_to_rmt_t)(const void *src, rmt_item32_t *dest, size_t src_size,
+                                size_t wanted_num, size_t *translated_size, size_t *item_num);
+
+// How many items fit in one of the RMT's memory blocks
+#define NATIVE_RMT_BLOCK_ITEMS 64
+
+struct NativeRmtChannel
+{
+    rmt_config_t config;
+    bool configured;
+    bool installed;
+    sample_to_rmt_t translator;
+
+    uint32_t writes;
+    uint32_t writeUs; // How long a write keeps the caller busy
+    std::vector<uint8_t> sample;
+    std::vector<rmt_item32_t> items;
+};
+
+inline NativeRmtChannel &nativeRmtChannel(rmt_channel_t channel)
+{
+    static NativeRmtChannel channels[RMT_CHANNEL_MAX];
+    return channels[channel];
+}
+
+inline const char *esp_err_to_name(esp_err_t err)
+{
+    return err == ESP_OK ? "ESP_OK" : "ESP_FAIL";
+}
+
+inline esp_err_t rmt_config(const rmt_config_t *config)
+{
+    NativeRmtChannel &channel = nativeRmtChannel(config->channel);
+    channel.config = *config;
+    channel.configured = true;
+    return ESP_OK;
+}
+
+// Installing it again is fine here, since a test might start the same task more than once
+inline esp_err_t rmt_driver_install(rmt_channel_t channel, size_t, int)
+{
+    if (!nativeRmtChannel(channel).configured)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    nativeRmtChannel(channel).installed = true;
+    return ESP_OK;
+}
+
+inline esp_err_t rmt_translator_init(rmt_channel_t channel, sample_to_rmt_t translator)
+{
+    nativeRmtChannel(channel).translator = translator;
+    return ESP_OK;
+}
+
+inline esp_err_t rmt_write_sample(rmt_channel_t channel, const uint8_t *src, size_t size, bool)
+{
+    NativeRmtChannel &rmt = nativeRmtChannel(channel);
+    if (!rmt.installed || rmt.translator == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    rmt.writes++;
+    nativeSkewNs() += (uint64_t)rmt.writeUs * 1000;
+    rmt.sample.assign(src, src + size);
+    rmt.items.clear();
+
+    size_t done = 0;
+    while (done < size)
+    {
+        rmt_item32_t block[NATIVE_RMT_BLOCK_ITEMS];
+        size_t translated = 0;
+        size_t items = 0;
+        rmt.translator(src + done, block, size - done, NATIVE_RMT_BLOCK_ITEMS, &translated, &items);
+        if (translated == 0)
+        {
+            return ESP_FAIL;
+        }
+        rmt.items.insert(rmt.items.end(), block, block + items);
+        done += translated;
+    }
+    return ESP_OK;
+}
+
+inline esp_err_t rmt_wait_tx_done(rmt_channel_t channel, TickType_t)
+{
+    return nativeRmtChannel(channel).installed ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
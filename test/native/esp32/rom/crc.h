@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+    The ESP32 ROM's little-endian CRC32, on the host
+
+    It's the same CRC as zlib's crc32(), including flipping the bits on the way
+    in and out, so a blob checked here matches one written on the board.
+*/
+
+static inline uint32_t crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--)
+    {
+        crc ^= *buf++;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <Arduino.h>
+
+/*
+    The ESP32's RTC timer on the host
+
+    It's the same clock as everything else, so it counts from "power on" and
+    keeps going through anything a test calls a reset.
+*/
+
+static inline uint64_t esp_rtc_get_time_us(void)
+{
+    return (uint64_t)(nativeNowNs() / 1000);
+}
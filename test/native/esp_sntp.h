@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <sys/time.h>
+
+/*
+    The part of ESP-IDF's SNTP client that the time discipline talks to
+
+    Nothing goes out on the network. What the clock asks for is kept so a test
+    can see it, and a test plays the server by calling sntp_sync_time().
+*/
+
+typedef enum
+{
+    SNTP_SYNC_STATUS_RESET,
+    SNTP_SYNC_STATUS_COMPLETED,
+    SNTP_SYNC_STATUS_IN_PROGRESS
+} sntp_sync_status_t;
+
+struct NativeSntp
+{
+    uint32_t syncIntervalMs;
+    sntp_sync_status_t status;
+};
+
+inline NativeSntp &nativeSntp()
+{
+    static NativeSntp sntp = {3600000, SNTP_SYNC_STATUS_RESET};
+    return sntp;
+}
+
+inline void sntp_set_sync_interval(uint32_t intervalMs)
+{
+    nativeSntp().syncIntervalMs = intervalMs;
+}
+
+inline uint32_t sntp_get_sync_interval(void)
+{
+    return nativeSntp().syncIntervalMs;
+}
+
+inline void sntp_set_sync_status(sntp_sync_status_t status)
+{
+    nativeSntp().status = status;
+}
+
+inline sntp_sync_status_t sntp_get_sync_status(void)
+{
+    return nativeSntp().status;
+}
+
+// The clock has its own (see time_discipline.cpp)
+extern "C" void sntp_sync_time(struct timeval *tv);
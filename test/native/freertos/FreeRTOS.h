@@ -0,0 +1,49 @@
+
+#pragma once
+
+/*
+    A host stand-in for the bits of FreeRTOS the clock's logic uses
+
+    Ticks are milliseconds of the same clock as millis(). Tasks run one at a
+    time (see task.h and native_scheduler.h), so critical sections don't need
+    to do anything, and queues (see queue.h) never block. That's enough to
+    drive the message router and friends from a test one call at a time, or
+    to run the clock's tasks through a few minutes.
+
+    Everything here has to work as C, since the sources include it inside
+    extern "C".
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef void *TaskHandle_t;
+
+#define configTICK_RATE_HZ 1000
+#define portNUM_PROCESSORS 2
+#define portMAX_DELAY 0xFFFFFFFFu
+#define portTICK_PERIOD_MS 1
+#define tskNO_AFFINITY 0x7FFFFFFF
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdFAIL 0
+#define pdPASS 1
+
+#define portTASK_FUNCTION_PROTO(function, parameters) void function(void *parameters)
+#define portTASK_FUNCTION(function, parameters) void function(void *parameters)
+
+typedef struct
+{
+    int owner;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/*
+    FreeRTOS event groups on the host, on top of the scheduler in task.h
+
+    Only the 24 bits the real ones have are any use.
+*/
+
+typedef uint32_t EventBits_t;
+
+typedef struct NativeEventGroup
+{
+    EventBits_t bits;
+} NativeEventGroup;
+
+typedef NativeEventGroup *EventGroupHandle_t;
+
+static inline EventGroupHandle_t xEventGroupCreate(void)
+{
+    EventGroupHandle_t group = (EventGroupHandle_t)malloc(sizeof(NativeEventGroup));
+    group->bits = 0;
+    return group;
+}
+
+static inline EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    return group->bits;
+}
+
+static inline EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    group->bits |= bits & 0x00FFFFFFu;
+    return group->bits;
+}
+
+static inline EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    EventBits_t before = group->bits;
+    group->bits &= ~bits;
+    return before;
+}
+
+static inline EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clearOnExit,
+                                              BaseType_t waitForAll, TickType_t ticks)
+{
+    std::function<bool()> done = [group, bits, waitForAll] {
+        return waitForAll ? (group->bits & bits) == bits : (group->bits & bits) != 0;
+    };
+
+    if (!done() && ticks > 0)
+    {
+        nativeBlock(done, nativeTicksFromNow(ticks));
+    }
+
+    EventBits_t result = group->bits;
+    if (clearOnExit && done())
+    {
+        group->bits &= ~bits;
+    }
+    return result;
+}
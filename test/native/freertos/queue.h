@@ -0,0 +1,72 @@
+
+#pragma once
+
+#include "FreeRTOS.h"
+
+/*
+    A FreeRTOS queue on the host, which is what the MQTT library hands the
+    message reader. It's a plain ring buffer that never blocks: receiving from
+    an empty queue fails right away, no matter how long the caller said it
+    would wait, and sending to a full one fails too.
+*/
+
+typedef struct NativeQueue
+{
+    uint8_t *items;
+    size_t itemSize;
+    UBaseType_t length;
+    UBaseType_t head;
+    UBaseType_t count;
+} NativeQueue;
+
+typedef NativeQueue *QueueHandle_t;
+
+static inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+    QueueHandle_t queue = (QueueHandle_t)malloc(sizeof(NativeQueue));
+    queue->items = (uint8_t *)malloc(length * itemSize);
+    queue->itemSize = itemSize;
+    queue->length = length;
+    queue->head = 0;
+    queue->count = 0;
+    return queue;
+}
+
+static inline void vQueueDelete(QueueHandle_t queue)
+{
+    free(queue->items);
+    free(queue);
+}
+
+static inline BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait)
+{
+    (void)wait;
+    if (queue->count == queue->length)
+    {
+        return pdFAIL;
+    }
+
+    UBaseType_t tail = (queue->head + queue->count) % queue->length;
+    memcpy(queue->items + tail * queue->itemSize, item, queue->itemSize);
+    queue->count++;
+    return pdPASS;
+}
+
+static inline BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait)
+{
+    (void)wait;
+    if (queue->count == 0)
+    {
+        return pdFAIL;
+    }
+
+    memcpy(item, queue->items + queue->head * queue->itemSize, queue->itemSize);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    return pdPASS;
+}
+
+static inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    return queue->count;
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+#include "../native_scheduler.h"
+
+/*
+    Tasks and task notifications, run by the scheduler in native_scheduler.h
+
+    The notifications work like the real ones: a value and a pending flag per
+    task, so a notify that shows up before anybody waits isn't lost. Calls that
+    block only block inside a task. From the test itself, vTaskDelay() runs the
+    tasks for that long instead, and the rest don't wait at all.
+*/
+
+typedef enum
+{
+    eNoAction = 0,
+    eSetBits,
+    eIncrement,
+    eSetValueWithOverwrite,
+    eSetValueWithoutOverwrite
+} eNotifyAction;
+
+typedef void (*TaskFunction_t)(void *);
+
+static inline TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(nativeNowNs() / (1000000000ULL / configTICK_RATE_HZ));
+}
+
+// There's only ever one task running, so the stack size, priority and core don't matter
+static inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char *name, uint32_t,
+                                                 void *parameters, UBaseType_t,
+                                                 TaskHandle_t *created, BaseType_t)
+{
+    NativeTask *task = nativeCreateTask(code, name, parameters);
+    if (created != NULL)
+    {
+        *created = task;
+    }
+    return pdPASS;
+}
+
+static inline BaseType_t xTaskCreate(TaskFunction_t code, const char *name, uint32_t stackDepth,
+                                     void *parameters, UBaseType_t priority, TaskHandle_t *created)
+{
+    return xTaskCreatePinnedToCore(code, name, stackDepth, parameters, priority, created, tskNO_AFFINITY);
+}
+
+static inline void vTaskDelete(TaskHandle_t handle)
+{
+    NativeTask *task = handle == NULL ? nativeCurrentTask() : (NativeTask *)handle;
+    if (task == NULL)
+    {
+        return;
+    }
+
+    task->deleted = true;
+    if (task == nativeCurrentTask())
+    {
+        throw NativeTaskStopped();
+    }
+}
+
+static inline TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return nativeCurrentTask();
+}
+
+static inline void vTaskDelay(TickType_t ticks)
+{
+    nativeBlock(std::function<bool()>(), nativeTicksFromNow(ticks));
+}
+
+static inline BaseType_t xTaskNotify(TaskHandle_t handle, uint32_t value, eNotifyAction action)
+{
+    NativeTask *task = (NativeTask *)handle;
+    if (task == NULL)
+    {
+        return pdFAIL;
+    }
+
+    bool wasPending = task->notifyPending;
+    switch (action)
+    {
+    case eSetBits:
+        task->notifyValue |= value;
+        break;
+    case eIncrement:
+        task->notifyValue++;
+        break;
+    case eSetValueWithOverwrite:
+        task->notifyValue = value;
+        break;
+    case eSetValueWithoutOverwrite:
+        if (wasPending)
+        {
+            return pdFAIL;
+        }
+        task->notifyValue = value;
+        break;
+    case eNoAction:
+        break;
+    }
+    task->notifyPending = true;
+    return pdPASS;
+}
+
+static inline BaseType_t xTaskNotifyGive(TaskHandle_t handle)
+{
+    return xTaskNotify(handle, 0, eIncrement);
+}
+
+static inline BaseType_t xTaskNotifyWait(uint32_t clearOnEntry, uint32_t clearOnExit, uint32_t *value, TickType_t ticks)
+{
+    NativeTask *self = nativeCurrentTask();
+    if (self == NULL)
+    {
+        return pdFALSE;
+    }
+
+    if (!self->notifyPending)
+    {
+        self->notifyValue &= ~clearOnEntry;
+        if (ticks > 0)
+        {
+            nativeBlock([self] { return self->notifyPending; }, nativeTicksFromNow(ticks));
+        }
+    }
+
+    if (value != NULL)
+    {
+        *value = self->notifyValue;
+    }
+    if (!self->notifyPending)
+    {
+        return pdFALSE;
+    }
+
+    self->notifyValue &= ~clearOnExit;
+    self->notifyPending = false;
+    return pdTRUE;
+}
+
+static inline uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks)
+{
+    NativeTask *self = nativeCurrentTask();
+    if (self == NULL)
+    {
+        return 0;
+    }
+
+    if (self->notifyValue == 0 && ticks > 0)
+    {
+        nativeBlock([self] { return self->notifyValue != 0; }, nativeTicksFromNow(ticks));
+    }
+
+    uint32_t value = self->notifyValue;
+    if (value != 0)
+    {
+        self->notifyValue = clearOnExit ? 0 : value - 1;
+    }
+    self->notifyPending = false;
+    return value;
+}
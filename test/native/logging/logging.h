@@ -0,0 +1,90 @@
+
+#pragma once
+
+#include <stdarg.h>
+#include <stdio.h>
+
+/*
+    The creature Logger, on the host
+
+    Every call is formatted (so it costs about what the real one does before it
+    goes out on serial or syslog) and counted, but nothing is printed unless
+    NATIVE_LOG_PRINT is defined. Tests can look at how many calls made it
+    through with Logger::getCalls().
+*/
+
+namespace creatures
+{
+    class Logger
+    {
+    public:
+        void init() {}
+
+        void verbose(const char *format, ...)
+        {
+            va_list args;
+            va_start(args, format);
+            log("V", format, args);
+            va_end(args);
+        }
+
+        void debug(const char *format, ...)
+        {
+            va_list args;
+            va_start(args, format);
+            log("D", format, args);
+            va_end(args);
+        }
+
+        void info(const char *format, ...)
+        {
+            va_list args;
+            va_start(args, format);
+            log("I", format, args);
+            va_end(args);
+        }
+
+        void warning(const char *format, ...)
+        {
+            va_list args;
+            va_start(args, format);
+            log("W", format, args);
+            va_end(args);
+        }
+
+        void error(const char *format, ...)
+        {
+            va_list args;
+            va_start(args, format);
+            log("E", format, args);
+            va_end(args);
+        }
+
+        void fatal(const char *format, ...)
+        {
+            va_list args;
+            va_start(args, format);
+            log("F", format, args);
+            va_end(args);
+        }
+
+        static unsigned long &getCalls()
+        {
+            static unsigned long calls = 0;
+            return calls;
+        }
+
+    private:
+        void log(const char *level, const char *format, va_list args)
+        {
+            char message[256];
+            vsnprintf(message, sizeof(message), format, args);
+            getCalls()++;
+#ifdef NATIVE_LOG_PRINT
+            printf("[%s] %s\n", level, message);
+#else
+            (void)level;
+#endif
+        }
+    };
+}
@@ -0,0 +1,81 @@
+
+#pragma once
+
+#include <Arduino.h>
+
+#include "led_driver.h"
+
+/*
+    A LedDriver that keeps what it was sent instead of sending it
+
+    A transmit can be left "on the wire" (busy) until the test says it's done,
+    so the double buffering in RingOutput can be checked without a strip.
+*/
+
+#define MOCK_LED_DRIVER_MAX_BYTES 4096
+
+class MockLedDriver : public LedDriver
+{
+public:
+    MockLedDriver()
+    {
+        started = false;
+        holdTransmits = false;
+        busy = false;
+        transmits = 0;
+        waits = 0;
+        lastPixels = NULL;
+        lastLength = 0;
+        memset(sent, 0, sizeof(sent));
+    }
+
+    boolean begin()
+    {
+        started = true;
+        return true;
+    }
+
+    boolean startTransmit(const uint8_t *pixels, size_t length)
+    {
+        if (busy || length > MOCK_LED_DRIVER_MAX_BYTES)
+        {
+            // The real RMT would have trashed the frame that's still going out
+            return false;
+        }
+
+        transmits++;
+        lastPixels = pixels;
+        lastLength = length;
+        memcpy(sent, pixels, length);
+        busy = holdTransmits;
+        return true;
+    }
+
+    boolean isBusy()
+    {
+        return busy;
+    }
+
+    void waitUntilDone()
+    {
+        waits++;
+        busy = false;
+    }
+
+    /**
+     * @brief Finishes the transmit that's on the wire, like the RMT would on its own
+     */
+    void finish()
+    {
+        busy = false;
+    }
+
+    boolean started;
+    boolean holdTransmits; // Stay busy after a transmit until finish() or waitUntilDone()
+    boolean busy;
+    uint32_t transmits;
+    uint32_t waits;
+    const uint8_t *lastPixels; // The buffer the last transmit came from
+    size_t lastLength;
+    uint8_t sent[MOCK_LED_DRIVER_MAX_BYTES];
+};
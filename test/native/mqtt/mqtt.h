@@ -0,0 +1,16 @@
+
+#pragma once
+
+/*
+    What the creature MQTT library puts on its incoming message queue
+
+    A test can fill one of these in and xQueueSend() it to stand in for the
+    broker.
+*/
+
+struct MqttMessage
+{
+    char topic[64];
+    char topicGlobalNamespace[64];
+    char payload[1024];
+};
@@ -0,0 +1,289 @@
+#pragma once
+
+/*
+    Just enough of a FreeRTOS scheduler to run the clock's tasks on the host
+
+    Every task gets its own thread, but only one of them (or the test) runs at
+    a time, and a task only gives up the CPU when it blocks, which is all the
+    tasks here ever count on. Blocking is a condition plus a time to give up
+    at. When every task is blocked, time jumps straight to the next one that
+    times out, so a test can run through minutes of clock in well under a
+    second.
+
+    Time itself is the same as millis() (see Arduino.h). It still moves while
+    a task is running, which is what makes a slow task show up as late.
+
+    A test drives it with nativeRunFor() or nativeRunUntil(), which only come
+    back once every task is blocked past the end, and cleans up with
+    nativeStopTasks().
+
+    This is C++, even though task.h is included inside extern "C".
+*/
+
+extern "C++"
+{
+
+#include <Arduino.h>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define NATIVE_NEVER_NS UINT64_MAX
+
+/**
+ * @brief Thrown out of a blocked task to stop it
+ */
+struct NativeTaskStopped
+{
+};
+
+struct NativeTask
+{
+    void (*code)(void *);
+    void *parameters;
+    const char *name;
+    std::thread thread;
+
+    // A blocked task runs again once ready() is true (if there is one) or wakeNs goes by
+    bool blocked;
+    std::function<bool()> ready;
+    uint64_t wakeNs;
+
+    bool finished;
+    bool deleted;
+
+    // FreeRTOS's task notification: a 32 bit value and whether one is pending
+    uint32_t notifyValue;
+    bool notifyPending;
+};
+
+struct NativeScheduler
+{
+    std::mutex mutex;
+    std::condition_variable changed;
+
+    std::vector<NativeTask *> tasks;
+    NativeTask *running;
+    size_t nextTask;
+    bool stopping;
+};
+
+inline NativeScheduler &nativeScheduler()
+{
+    static NativeScheduler scheduler;
+    return scheduler;
+}
+
+// Which task this thread is, or NULL for the test itself
+inline NativeTask *&nativeCurrentTask()
+{
+    static thread_local NativeTask *task = NULL;
+    return task;
+}
+
+inline bool nativeTaskRunnable(NativeTask *task, uint64_t nowNs)
+{
+    if (task->finished)
+    {
+        return false;
+    }
+    return nativeScheduler().stopping || task->deleted || !task->blocked || nowNs >= task->wakeNs || (task->ready && task->ready());
+}
+
+/**
+ * @brief Runs the tasks until they're all blocked past endNs (or until done() says so)
+ *
+ * @return true if done() stopped it
+ */
+inline bool nativeRunUntil(uint64_t endNs, std::function<bool()> done = std::function<bool()>())
+{
+    NativeScheduler &scheduler = nativeScheduler();
+    std::unique_lock<std::mutex> lock(scheduler.mutex);
+
+    for (;;)
+    {
+        if (done && done())
+        {
+            return true;
+        }
+
+        uint64_t now = nativeNowNs();
+
+        // Round robin, so a task that's always ready can't starve the rest
+        NativeTask *next = NULL;
+        size_t count = scheduler.tasks.size();
+        for (size_t i = 0; i < count; i++)
+        {
+            size_t index = (scheduler.nextTask + i) % count;
+            if (nativeTaskRunnable(scheduler.tasks[index], now))
+            {
+                next = scheduler.tasks[index];
+                scheduler.nextTask = index + 1;
+                break;
+            }
+        }
+
+        if (next != NULL)
+        {
+            scheduler.running = next;
+            scheduler.changed.notify_all();
+            scheduler.changed.wait(lock, [&scheduler] { return scheduler.running == NULL; });
+            continue;
+        }
+
+        if (now >= endNs)
+        {
+            return false;
+        }
+
+        // Nothing to do until the next timeout, so skip ahead to it
+        uint64_t wakeNs = endNs;
+        for (size_t i = 0; i < count; i++)
+        {
+            NativeTask *task = scheduler.tasks[i];
+            if (!task->finished && task->blocked && task->wakeNs < wakeNs)
+            {
+                wakeNs = task->wakeNs;
+            }
+        }
+        if (wakeNs > now)
+        {
+            nativeSkewNs() += wakeNs - now;
+        }
+    }
+}
+
+inline bool nativeRunFor(unsigned long ms, std::function<bool()> done = std::function<bool()>())
+{
+    return nativeRunUntil(nativeNowNs() + (uint64_t)ms * 1000000, done);
+}
+
+/**
+ * @brief Blocks the calling task until ready() is true or wakeNs goes by
+ *
+ * From the test (which isn't a task) it runs the tasks instead.
+ *
+ * @return true if ready() is true
+ */
+inline bool nativeBlock(std::function<bool()> ready, uint64_t wakeNs)
+{
+    NativeScheduler &scheduler = nativeScheduler();
+    NativeTask *self = nativeCurrentTask();
+
+    if (self == NULL)
+    {
+        if (ready && ready())
+        {
+            return true;
+        }
+        return nativeRunUntil(wakeNs, ready);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(scheduler.mutex);
+        self->blocked = true;
+        self->ready = ready;
+        self->wakeNs = wakeNs;
+        scheduler.running = NULL;
+        scheduler.changed.notify_all();
+        scheduler.changed.wait(lock, [&scheduler, self] { return scheduler.running == self; });
+
+        if (scheduler.stopping || self->deleted)
+        {
+            throw NativeTaskStopped();
+        }
+        self->blocked = false;
+        self->ready = std::function<bool()>();
+        self->wakeNs = NATIVE_NEVER_NS;
+    }
+
+    return !ready || ready();
+}
+
+/**
+ * @brief When a wait of this many ticks from now runs out
+ *
+ * Like FreeRTOS, the wait is counted in whole ticks, so it ends on a tick boundary.
+ */
+inline uint64_t nativeTicksFromNow(TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY)
+    {
+        return NATIVE_NEVER_NS;
+    }
+
+    uint64_t tickNs = 1000000000ULL / configTICK_RATE_HZ;
+    return (nativeNowNs() / tickNs + ticks) * tickNs;
+}
+
+inline void nativeTaskMain(NativeTask *task)
+{
+    NativeScheduler &scheduler = nativeScheduler();
+    nativeCurrentTask() = task;
+
+    {
+        std::unique_lock<std::mutex> lock(scheduler.mutex);
+        scheduler.changed.wait(lock, [&scheduler, task] { return scheduler.running == task; });
+    }
+
+    try
+    {
+        if (!scheduler.stopping && !task->deleted)
+        {
+            task->code(task->parameters);
+        }
+    }
+    catch (const NativeTaskStopped &)
+    {
+    }
+
+    std::unique_lock<std::mutex> lock(scheduler.mutex);
+    task->finished = true;
+    scheduler.running = NULL;
+    scheduler.changed.notify_all();
+}
+
+inline NativeTask *nativeCreateTask(void (*code)(void *), const char *name, void *parameters)
+{
+    NativeScheduler &scheduler = nativeScheduler();
+    NativeTask *task = new NativeTask();
+    task->code = code;
+    task->parameters = parameters;
+    task->name = name;
+    task->blocked = false;
+    task->wakeNs = NATIVE_NEVER_NS;
+    task->finished = false;
+    task->deleted = false;
+    task->notifyValue = 0;
+    task->notifyPending = false;
+
+    std::unique_lock<std::mutex> lock(scheduler.mutex);
+    scheduler.tasks.push_back(task);
+    task->thread = std::thread(nativeTaskMain, task);
+    return task;
+}
+
+/**
+ * @brief Stops every task and forgets about them, for the end of a test
+ */
+inline void nativeStopTasks()
+{
+    NativeScheduler &scheduler = nativeScheduler();
+
+    scheduler.stopping = true;
+    nativeRunUntil(0);
+
+    for (size_t i = 0; i < scheduler.tasks.size(); i++)
+    {
+        scheduler.tasks[i]->thread.join();
+        delete scheduler.tasks[i];
+    }
+    scheduler.tasks.clear();
+    scheduler.nextTask = 0;
+    scheduler.stopping = false;
+}
+
+} // extern "C++"
@@ -0,0 +1,159 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include <time.h>
+
+#include "bench.h"
+#include "civil_time.h"
+
+/*
+    toCivilTime() against localtime_r(), with the TZ the built-in rules are for
+
+    The build defaults are Pacific time with US daylight saving time, which is
+    PST8PDT,M3.2.0,M11.1.0 in TZ. Every hour in the table's years and a second
+    either side of every change have to come out the same both ways.
+*/
+
+#define PACIFIC_TZ "PST8PDT,M3.2.0,M11.1.0"
+
+static void setZone(const char *tz)
+{
+    setenv("TZ", tz, 1);
+    tzset();
+}
+
+static void checkAgrees(int64_t epoch)
+{
+    CivilTime fast = toCivilTime(epoch);
+
+    time_t seconds = (time_t)epoch;
+    struct tm tm;
+    localtime_r(&seconds, &tm);
+
+    if (fast.hour != tm.tm_hour || fast.minute != tm.tm_min || fast.second != tm.tm_sec ||
+        fast.dst != (tm.tm_isdst > 0))
+    {
+        char message[128];
+        snprintf(message, sizeof(message), "at %lld: %02u:%02u:%02u%s, libc says %02d:%02d:%02d%s",
+                 (long long)epoch,
+                 fast.hour, fast.minute, fast.second, fast.dst ? " DST" : "",
+                 tm.tm_hour, tm.tm_min, tm.tm_sec, tm.tm_isdst > 0 ? " DST" : "");
+        TEST_FAIL_MESSAGE(message);
+    }
+}
+
+void setUp()
+{
+    setZone(PACIFIC_TZ);
+    TEST_ASSERT_TRUE(checkCivilTimeZone((int64_t)daysFromCivil(2026, 10, 17) * SECONDS_PER_DAY));
+}
+
+void tearDown() {}
+
+void test_date_math()
+{
+    static_assert(daysFromCivil(1970, 1, 1) == 0, "the epoch");
+    static_assert(daysFromCivil(2000, 3, 1) == 11017, "after a leap day");
+    static_assert(weekdayFromDays(daysFromCivil(2026, 10, 17)) == 6, "a Saturday");
+    static_assert(nthSunday(2026, 3, 2) == daysFromCivil(2026, 3, 8), "DST starts March 8th, 2026");
+    static_assert(nthSunday(2026, 11, 1) == daysFromCivil(2026, 11, 1), "DST ends November 1st, 2026");
+}
+
+void test_every_hour_matches_localtime()
+{
+    int64_t first = (int64_t)daysFromCivil(CIVIL_TIME_FIRST_YEAR, 1, 1) * SECONDS_PER_DAY;
+    int64_t last = (int64_t)daysFromCivil(CIVIL_TIME_LAST_YEAR + 1, 1, 1) * SECONDS_PER_DAY;
+
+    // An odd step, so the minutes and seconds move around too
+    for (int64_t epoch = first; epoch < last; epoch += 3600 + 7)
+    {
+        checkAgrees(epoch);
+    }
+}
+
+void test_every_change_matches_localtime()
+{
+    for (int32_t year = CIVIL_TIME_FIRST_YEAR; year <= CIVIL_TIME_LAST_YEAR; year++)
+    {
+        const int64_t changes[2] = {dstStartUtc(year), dstEndUtc(year)};
+        for (uint8_t i = 0; i < 2; i++)
+        {
+            for (int64_t offset = -1; offset <= 1; offset++)
+            {
+                checkAgrees(changes[i] + offset);
+            }
+        }
+    }
+}
+
+void test_years_outside_the_table_match_localtime()
+{
+    for (int32_t year = 2010; year < CIVIL_TIME_FIRST_YEAR; year++)
+    {
+        checkAgrees(dstStartUtc(year) - 1);
+        checkAgrees(dstStartUtc(year));
+        checkAgrees(dstEndUtc(year) - 1);
+        checkAgrees(dstEndUtc(year));
+    }
+}
+
+void test_a_different_zone_falls_back_to_localtime()
+{
+    const char *const zones[] = {"EST5EDT,M3.2.0,M11.1.0", "UTC0", "MST7", "PST8PDT,M3.5.0,M10.5.0"};
+    int64_t now = (int64_t)daysFromCivil(2026, 10, 17) * SECONDS_PER_DAY;
+
+    for (uint8_t i = 0; i < sizeof(zones) / sizeof(zones[0]); i++)
+    {
+        setZone(zones[i]);
+        TEST_ASSERT_FALSE_MESSAGE(checkCivilTimeZone(now), zones[i]);
+        TEST_ASSERT_TRUE(civilTimeZoneStats.mismatches > 0);
+
+        // Now it's just asking libc, so it's right anyway
+        for (int64_t epoch = now; epoch < now + 366 * SECONDS_PER_DAY; epoch += 3 * 3600 + 11)
+        {
+            checkAgrees(epoch);
+        }
+    }
+
+    setZone(PACIFIC_TZ);
+    TEST_ASSERT_TRUE(checkCivilTimeZone(now));
+    TEST_ASSERT_EQUAL_UINT32(0, civilTimeZoneStats.mismatches);
+}
+
+void test_benchmark_conversions_per_second()
+{
+    int64_t start = (int64_t)daysFromCivil(2026, 1, 1) * SECONDS_PER_DAY;
+    volatile uint8_t sink = 0;
+
+    BenchResult fast = runBench(500000, [&](uint32_t i) {
+        sink = toCivilTime(start + (int64_t)i * 61).second;
+    });
+
+    BenchResult libc = runBench(500000, [&](uint32_t i) {
+        time_t seconds = (time_t)(start + (int64_t)i * 61);
+        struct tm tm;
+        localtime_r(&seconds, &tm);
+        sink = tm.tm_sec;
+    });
+
+    reportBench("toCivilTime()", fast);
+    reportBench("localtime_r()", libc);
+
+    char message[96];
+    snprintf(message, sizeof(message), "%.0f conversions/s vs %.0f, %.1fx",
+             benchPerSecond(fast), benchPerSecond(libc), benchMeanNs(libc) / benchMeanNs(fast));
+    TEST_MESSAGE(message);
+    (void)sink;
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_date_math);
+    RUN_TEST(test_every_hour_matches_localtime);
+    RUN_TEST(test_every_change_matches_localtime);
+    RUN_TEST(test_years_outside_the_table_match_localtime);
+    RUN_TEST(test_a_different_zone_falls_back_to_localtime);
+    RUN_TEST(test_benchmark_conversions_per_second);
+    return UNITY_END();
+}
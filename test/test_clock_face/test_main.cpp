@@ -0,0 +1,59 @@
+#include <unity.h>
+
+#include "clock_face.h"
+
+void setUp() {}
+void tearDown() {}
+
+void test_midnight_is_twelve_am()
+{
+    ClockFace face = makeClockFace(0, 5, 0, false);
+    TEST_ASSERT_EQUAL_INT(1205, face.time);
+    TEST_ASSERT_EQUAL_UINT8(CLOCK_FACE_AM | CLOCK_FACE_COLON, face.colonSegments);
+}
+
+void test_noon_is_twelve_pm()
+{
+    ClockFace face = makeClockFace(12, 0, 0, false);
+    TEST_ASSERT_EQUAL_INT(1200, face.time);
+    TEST_ASSERT_EQUAL_UINT8(CLOCK_FACE_PM | CLOCK_FACE_COLON, face.colonSegments);
+}
+
+void test_every_hour_is_twelve_hour_time()
+{
+    for (int hour = 0; hour < 24; hour++)
+    {
+        ClockFace face = makeClockFace(hour, 0, 0, false);
+        int hour12 = face.time / 100;
+
+        TEST_ASSERT_TRUE(hour12 >= 1 && hour12 <= 12);
+        TEST_ASSERT_EQUAL_INT(hour % 12, hour12 % 12);
+        TEST_ASSERT_EQUAL_UINT8(hour < 12 ? CLOCK_FACE_AM : CLOCK_FACE_PM,
+                                face.colonSegments & (CLOCK_FACE_AM | CLOCK_FACE_PM));
+    }
+}
+
+void test_colon_blinks_on_even_seconds()
+{
+    TEST_ASSERT_TRUE(makeClockFace(9, 30, 10, true).colonSegments & CLOCK_FACE_COLON);
+    TEST_ASSERT_FALSE(makeClockFace(9, 30, 11, true).colonSegments & CLOCK_FACE_COLON);
+}
+
+void test_colon_stays_on_when_not_blinking()
+{
+    for (int second = 0; second < 60; second++)
+    {
+        TEST_ASSERT_TRUE(makeClockFace(9, 30, second, false).colonSegments & CLOCK_FACE_COLON);
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_midnight_is_twelve_am);
+    RUN_TEST(test_noon_is_twelve_pm);
+    RUN_TEST(test_every_hour_is_twelve_hour_time);
+    RUN_TEST(test_colon_blinks_on_even_seconds);
+    RUN_TEST(test_colon_stays_on_when_not_blinking);
+    return UNITY_END();
+}
@@ -0,0 +1,241 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include <math.h>
+
+#include "bench.h"
+#include "color.h"
+
+/*
+    The fixed-point HSV kernel, checked against the obvious floating point
+    version of the same thing
+*/
+
+#define TYPE (NEO_GRB + NEO_KHZ800)
+#define PIXELS 60
+
+// Where each colour lands in a GRB pixel
+#define R 1
+#define G 0
+#define B 2
+
+void setUp() {}
+
+void tearDown() {}
+
+/**
+ * @brief HSV -> 8 bit RGB the slow way, with the same gamma and brightness steps
+ */
+static void referenceHsv(uint16_t hue, uint8_t saturation, uint8_t brightness, double rgb[3])
+{
+    double h = hue / 65536.0 * 6.0;
+    double full[3] = {
+        fmin(fmax(fabs(h - 3.0) - 1.0, 0.0), 1.0),       // red
+        fmin(fmax(2.0 - fabs(h - 2.0), 0.0), 1.0),       // green
+        fmin(fmax(2.0 - fabs(h - 4.0), 0.0), 1.0)};      // blue
+
+    double s = saturation / 255.0;
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        double value = full[i] * s + (1.0 - s);
+        rgb[i] = pow(value, 2.6) * 255.0 * (brightness + 1) / 256.0;
+    }
+}
+
+void test_gamma_table_is_the_curve()
+{
+    for (uint16_t i = 0; i < 256; i++)
+    {
+        uint16_t expected = (uint16_t)lround(pow(i / 255.0, 2.6) * 65535.0);
+        TEST_ASSERT_EQUAL_UINT16(expected, gammaTable[i]);
+        if (i > 0)
+        {
+            TEST_ASSERT_TRUE(gammaTable[i] >= gammaTable[i - 1]);
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT16(0, gammaTable[0]);
+    TEST_ASSERT_EQUAL_UINT16(65535, gammaTable[255]);
+}
+
+void test_primaries()
+{
+    uint16_t r, g, b;
+
+    hsvToRgb16(0, 255, r, g, b);
+    TEST_ASSERT_EQUAL_UINT16(65535, r);
+    TEST_ASSERT_EQUAL_UINT16(0, g);
+    TEST_ASSERT_EQUAL_UINT16(0, b);
+
+    hsvToRgb16(21845, 255, r, g, b);
+    TEST_ASSERT_EQUAL_UINT16(0, r);
+    TEST_ASSERT_EQUAL_UINT16(65535, g);
+    TEST_ASSERT_EQUAL_UINT16(0, b);
+
+    hsvToRgb16(43690, 255, r, g, b);
+    TEST_ASSERT_EQUAL_UINT16(0, r);
+    TEST_ASSERT_EQUAL_UINT16(0, g);
+    TEST_ASSERT_EQUAL_UINT16(65535, b);
+
+    // All the way round is red again
+    hsvToRgb16(65535, 255, r, g, b);
+    TEST_ASSERT_EQUAL_UINT16(65535, r);
+    TEST_ASSERT_EQUAL_UINT16(0, b);
+}
+
+void test_no_saturation_is_white()
+{
+    for (uint32_t hue = 0; hue < 65536; hue += 1111)
+    {
+        uint16_t r, g, b;
+        hsvToRgb16(hue, 0, r, g, b);
+        TEST_ASSERT_EQUAL_UINT16(65535, r);
+        TEST_ASSERT_EQUAL_UINT16(65535, g);
+        TEST_ASSERT_EQUAL_UINT16(65535, b);
+    }
+}
+
+void test_brightness_ends()
+{
+    uint8_t pixel[3];
+    uint16_t hue = 0;
+
+    renderHsv<1, TYPE>(pixel, &hue, 255, 0);
+    TEST_ASSERT_EQUAL_UINT8(0, pixel[R]);
+
+    renderHsv<1, TYPE>(pixel, &hue, 255, 255);
+    TEST_ASSERT_EQUAL_UINT8(255, pixel[R]);
+    TEST_ASSERT_EQUAL_UINT8(0, pixel[G]);
+    TEST_ASSERT_EQUAL_UINT8(0, pixel[B]);
+}
+
+void test_brightness_never_goes_backwards()
+{
+    for (uint16_t channel = 0; channel < 256; channel += 15)
+    {
+        uint8_t previous = 0;
+        uint16_t previous16 = 0;
+        for (uint16_t brightness = 0; brightness < 256; brightness++)
+        {
+            uint8_t level = scaleChannel(gammaTable[channel], brightness);
+            uint16_t level16 = scaleChannel16(gammaTable[channel], brightness);
+            TEST_ASSERT_TRUE(level >= previous);
+            TEST_ASSERT_TRUE(level16 >= previous16);
+
+            // The top byte of the fixed point level is the byte
+            TEST_ASSERT_EQUAL_UINT8(level, level16 >> 8);
+
+            previous = level;
+            previous16 = level16;
+        }
+    }
+}
+
+void test_matches_floating_point()
+{
+    /*
+        The wheel and the saturation are worked out in 8 bits before the gamma
+        curve, so a channel can be one step of the curve away from the real
+        thing. At the steep end that's about 2.6 levels at full brightness.
+    */
+    const uint8_t saturations[] = {0, 64, 128, 200, 255};
+    const uint8_t brightnesses[] = {1, 16, 64, 128, 255};
+
+    double totalError = 0;
+    uint32_t channels = 0;
+    for (uint32_t hue = 0; hue < 65536; hue += 97)
+    {
+        for (uint8_t s = 0; s < sizeof(saturations); s++)
+        {
+            for (uint8_t v = 0; v < sizeof(brightnesses); v++)
+            {
+                uint16_t h = hue;
+                uint8_t pixel[3];
+                renderHsv<1, TYPE>(pixel, &h, saturations[s], brightnesses[v]);
+
+                double expected[3];
+                referenceHsv(h, saturations[s], brightnesses[v], expected);
+
+                const uint8_t offsets[3] = {R, G, B};
+                for (uint8_t c = 0; c < 3; c++)
+                {
+                    double error = fabs(pixel[offsets[c]] - expected[c]);
+                    TEST_ASSERT_TRUE_MESSAGE(error <= 3.0, "too far from the floating point colour");
+                    totalError += error;
+                    channels++;
+                }
+            }
+        }
+    }
+
+    // Most of the time it's just the rounding
+    TEST_ASSERT_TRUE_MESSAGE(totalError / channels < 1.0, "too far from the floating point colour on average");
+}
+
+void test_renderers_agree()
+{
+    uint16_t hues[PIXELS];
+    for (uint16_t i = 0; i < PIXELS; i++)
+    {
+        hues[i] = i * 1092;
+    }
+
+    uint8_t pixels[PIXELS * 3];
+    uint16_t levels[PIXELS * 3];
+    renderHsv<PIXELS, TYPE>(pixels, hues, 230, 90);
+    renderHsvLevels<PIXELS, TYPE>(levels, hues, 230, 90);
+    for (uint16_t i = 0; i < PIXELS * 3; i++)
+    {
+        TEST_ASSERT_EQUAL_UINT8(pixels[i], levels[i] >> 8);
+    }
+
+    uint8_t filled[PIXELS * 3];
+    uint8_t one[3];
+    fillHsv<PIXELS, TYPE>(filled, hues[7], 230, 90);
+    renderHsv<1, TYPE>(one, &hues[7], 230, 90);
+    for (uint16_t i = 0; i < PIXELS; i++)
+    {
+        TEST_ASSERT_EQUAL_MEMORY(one, filled + (i * 3), 3);
+    }
+}
+
+void test_benchmark_cycles_per_pixel()
+{
+    static uint16_t hues[PIXELS];
+    static uint8_t pixels[PIXELS * 3];
+    static uint16_t levels[PIXELS * 3];
+    for (uint16_t i = 0; i < PIXELS; i++)
+    {
+        hues[i] = i * 1092;
+    }
+
+    BenchResult bytes = runBench(20000, [&](uint32_t run) {
+        renderHsv<PIXELS, TYPE>(pixels, hues, 255, run & 0xFF);
+    });
+    BenchResult fixedPoint = runBench(20000, [&](uint32_t run) {
+        renderHsvLevels<PIXELS, TYPE>(levels, hues, 255, run & 0xFF);
+    });
+
+    reportBench("renderHsv, 60 pixels", bytes);
+    reportBench("renderHsvLevels, 60 pixels", fixedPoint);
+
+    // Cycles as the ESP32 would count them at 240MHz, if it were as quick as the host
+    char message[96];
+    snprintf(message, sizeof(message), "%.1f cycles per pixel (bytes), %.1f cycles per pixel (levels)",
+             benchMeanNs(bytes) * NATIVE_CPU_FREQ_MHZ / 1000 / PIXELS,
+             benchMeanNs(fixedPoint) * NATIVE_CPU_FREQ_MHZ / 1000 / PIXELS);
+    TEST_MESSAGE(message);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_gamma_table_is_the_curve);
+    RUN_TEST(test_primaries);
+    RUN_TEST(test_no_saturation_is_white);
+    RUN_TEST(test_brightness_ends);
+    RUN_TEST(test_brightness_never_goes_backwards);
+    RUN_TEST(test_matches_floating_point);
+    RUN_TEST(test_renderers_agree);
+    RUN_TEST(test_benchmark_cycles_per_pixel);
+    return UNITY_END();
+}
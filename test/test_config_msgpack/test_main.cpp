@@ -0,0 +1,180 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include <stddef.h>
+
+#include "bench.h"
+#include "clock_config.h"
+#include "config_parser.h"
+
+static const char *const effectNames[] = {"wipe", "comet", NULL};
+
+// The same kind of schema config.cpp uses
+static const ConfigField schema[] = {
+    {"brightness", CONFIG_FIELD_UINT8, 0, 15, offsetof(ClockConfig, screenBrightness), NULL},
+    {"displayOn", CONFIG_FIELD_ON_OFF, 0, 1, offsetof(ClockConfig, displayOn), NULL},
+    {"ledRingEffect", CONFIG_FIELD_CHOICE, 0, 1, offsetof(ClockConfig, ringEffect), effectNames},
+};
+
+#define FIELD_COUNT (sizeof(schema) / sizeof(schema[0]))
+#define BRIGHTNESS 0
+#define DISPLAY_ON 1
+#define EFFECT 2
+
+static ConfigValue values[FIELD_COUNT];
+
+void setUp()
+{
+    memset(values, 0xAA, sizeof(values));
+}
+
+void tearDown() {}
+
+static boolean parseMsgPack(const char *payload, size_t length, size_t &used)
+{
+    return parseMsgPackConfig(payload, length, schema, FIELD_COUNT, values, used);
+}
+
+// {"brightness": 7, "displayOn": true, "ledRingEffect": "comet"}
+static const char fullMap[] =
+    "\x83"
+    "\xAA" "brightness" "\x07"
+    "\xA9" "displayOn" "\xC3"
+    "\xAD" "ledRingEffect" "\xA5" "comet";
+
+static const char fullJson[] = "{\"brightness\": 7, \"displayOn\": \"on\", \"ledRingEffect\": \"comet\"}";
+
+void test_detects_the_format_from_the_first_byte()
+{
+    TEST_ASSERT_EQUAL(CONFIG_FORMAT_MSGPACK, detectConfigFormat(fullMap, sizeof(fullMap) - 1));
+    TEST_ASSERT_EQUAL(CONFIG_FORMAT_MSGPACK, detectConfigFormat("\xDE\x00\x01", 3));
+    TEST_ASSERT_EQUAL(CONFIG_FORMAT_JSON, detectConfigFormat(fullJson, sizeof(fullJson) - 1));
+    TEST_ASSERT_EQUAL(CONFIG_FORMAT_JSON, detectConfigFormat("", 0));
+}
+
+void test_reads_a_whole_map()
+{
+    size_t used = 0;
+    TEST_ASSERT_TRUE(parseMsgPack(fullMap, sizeof(fullMap) - 1, used));
+    TEST_ASSERT_EQUAL_UINT32(sizeof(fullMap) - 1, used);
+
+    TEST_ASSERT_TRUE(values[BRIGHTNESS].present && values[BRIGHTNESS].valid);
+    TEST_ASSERT_EQUAL_INT32(7, values[BRIGHTNESS].value);
+    TEST_ASSERT_TRUE(values[DISPLAY_ON].valid);
+    TEST_ASSERT_EQUAL_INT32(1, values[DISPLAY_ON].value);
+    TEST_ASSERT_TRUE(values[EFFECT].valid);
+    TEST_ASSERT_EQUAL_INT32(1, values[EFFECT].value);
+}
+
+void test_stops_at_the_end_of_the_map()
+{
+    // A binary topic hands over the whole buffer, zeros and all
+    char buffer[256];
+    memset(buffer, 0, sizeof(buffer));
+    memcpy(buffer, fullMap, sizeof(fullMap) - 1);
+
+    size_t used = 0;
+    TEST_ASSERT_TRUE(parseMsgPack(buffer, sizeof(buffer), used));
+    TEST_ASSERT_EQUAL_UINT32(sizeof(fullMap) - 1, used);
+}
+
+void test_skips_unknown_keys_whatever_they_hold()
+{
+    // {"other": {"a": [1, 2, 3]}, "brightness": 3}
+    static const char map[] =
+        "\x82"
+        "\xA5" "other" "\x81" "\xA1" "a" "\x93\x01\x02\x03"
+        "\xAA" "brightness" "\x03";
+
+    size_t used = 0;
+    TEST_ASSERT_TRUE(parseMsgPack(map, sizeof(map) - 1, used));
+    TEST_ASSERT_EQUAL_INT32(3, values[BRIGHTNESS].value);
+    TEST_ASSERT_FALSE(values[DISPLAY_ON].present);
+}
+
+void test_nil_is_the_same_as_missing()
+{
+    static const char map[] = "\x81" "\xAA" "brightness" "\xC0";
+
+    size_t used = 0;
+    TEST_ASSERT_TRUE(parseMsgPack(map, sizeof(map) - 1, used));
+    TEST_ASSERT_FALSE(values[BRIGHTNESS].present);
+}
+
+void test_wide_integers_are_clamped_not_wrapped()
+{
+    // brightness: uint32 0x100000007 doesn't fit, so it has to come out out-of-range
+    static const char map[] = "\x81" "\xAA" "brightness" "\xCF\x00\x00\x00\x01\x00\x00\x00\x07";
+
+    size_t used = 0;
+    TEST_ASSERT_TRUE(parseMsgPack(map, sizeof(map) - 1, used));
+    TEST_ASSERT_EQUAL_INT32(INT32_MAX, values[BRIGHTNESS].value);
+}
+
+void test_a_key_with_a_nul_in_it_is_not_a_match()
+{
+    // "displayOn\0" is 10 bytes long, and isn't "displayOn"
+    static const char map[] = "\x81" "\xAA" "displayOn\x00" "\xC3";
+
+    size_t used = 0;
+    TEST_ASSERT_TRUE(parseMsgPack(map, sizeof(map) - 1, used));
+    TEST_ASSERT_FALSE(values[DISPLAY_ON].present);
+}
+
+void test_a_choice_with_a_nul_in_it_is_not_a_match()
+{
+    static const char map[] = "\x81" "\xAD" "ledRingEffect" "\xA6" "comet\x00";
+
+    size_t used = 0;
+    TEST_ASSERT_TRUE(parseMsgPack(map, sizeof(map) - 1, used));
+    TEST_ASSERT_TRUE(values[EFFECT].present);
+    TEST_ASSERT_FALSE(values[EFFECT].valid);
+}
+
+void test_truncated_maps_are_rejected()
+{
+    for (size_t length = 0; length < sizeof(fullMap) - 1; length++)
+    {
+        size_t used = 0;
+        TEST_ASSERT_FALSE(parseMsgPack(fullMap, length, used));
+    }
+}
+
+void test_benchmark_json_vs_msgpack()
+{
+    const uint32_t runs = 100000;
+
+    BenchResult json = runBench(runs, [](uint32_t) {
+        parseJsonConfig(fullJson, sizeof(fullJson) - 1, schema, FIELD_COUNT, values);
+    });
+
+    BenchResult msgpack = runBench(runs, [](uint32_t) {
+        size_t used;
+        parseMsgPack(fullMap, sizeof(fullMap) - 1, used);
+    });
+
+    char message[96];
+    snprintf(message, sizeof(message), "payload: JSON %u bytes, MessagePack %u bytes",
+             (unsigned int)(sizeof(fullJson) - 1), (unsigned int)(sizeof(fullMap) - 1));
+    TEST_MESSAGE(message);
+    reportBench("JSON parse", json);
+    reportBench("MessagePack parse", msgpack);
+
+    TEST_ASSERT_LESS_THAN(sizeof(fullJson) - 1, sizeof(fullMap) - 1);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_detects_the_format_from_the_first_byte);
+    RUN_TEST(test_reads_a_whole_map);
+    RUN_TEST(test_stops_at_the_end_of_the_map);
+    RUN_TEST(test_skips_unknown_keys_whatever_they_hold);
+    RUN_TEST(test_nil_is_the_same_as_missing);
+    RUN_TEST(test_wide_integers_are_clamped_not_wrapped);
+    RUN_TEST(test_a_key_with_a_nul_in_it_is_not_a_match);
+    RUN_TEST(test_a_choice_with_a_nul_in_it_is_not_a_match);
+    RUN_TEST(test_truncated_maps_are_rejected);
+    RUN_TEST(test_benchmark_json_vs_msgpack);
+    return UNITY_END();
+}
@@ -0,0 +1,351 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include <stddef.h>
+
+#include <new>
+
+#include "bench.h"
+#include "clock_config.h"
+#include "config_parser.h"
+
+/*
+    Counts every allocation, so the benchmark can show the parser doesn't make any
+*/
+static size_t allocations = 0;
+static size_t bytesAllocated = 0;
+
+void *operator new(size_t size)
+{
+    allocations++;
+    bytesAllocated += size;
+    void *memory = malloc(size);
+    if (memory == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void *memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+    free(memory);
+}
+
+static const char *const effectNames[] = {"wipe", "comet", "breathing", NULL};
+
+static const ConfigField schema[] = {
+    {"brightness", CONFIG_FIELD_UINT8, 0, 15, offsetof(ClockConfig, screenBrightness), NULL},
+    {"blinkingColon", CONFIG_FIELD_ON_OFF, 0, 1, offsetof(ClockConfig, blinkColon), NULL},
+    {"displayOn", CONFIG_FIELD_ON_OFF, 0, 1, offsetof(ClockConfig, displayOn), NULL},
+    {"ledRingBrightness", CONFIG_FIELD_UINT8, 0, 254, offsetof(ClockConfig, pixelBrightness), NULL},
+    {"ledRingEffect", CONFIG_FIELD_CHOICE, 0, 2, offsetof(ClockConfig, ringEffect), effectNames},
+};
+
+#define FIELD_COUNT (sizeof(schema) / sizeof(schema[0]))
+#define BRIGHTNESS 0
+#define BLINKING_COLON 1
+#define DISPLAY_ON 2
+#define RING_BRIGHTNESS 3
+#define RING_EFFECT 4
+
+static ConfigValue values[FIELD_COUNT];
+
+// What Home Assistant sends
+static const char homeAssistant[] =
+    "{\"brightness\": \"7\", \"blinkingColon\": \"on\", \"displayOn\": \"off\", "
+    "\"ledRingBrightness\": 120, \"ledRingEffect\": \"comet\"}";
+
+void setUp()
+{
+    memset(values, 0xAA, sizeof(values));
+}
+
+void tearDown() {}
+
+static boolean parseJson(const char *json)
+{
+    return parseJsonConfig(json, strlen(json), schema, FIELD_COUNT, values);
+}
+
+void test_reads_what_home_assistant_sends()
+{
+    TEST_ASSERT_TRUE(parseJson(homeAssistant));
+
+    TEST_ASSERT_TRUE(values[BRIGHTNESS].valid);
+    TEST_ASSERT_EQUAL_INT32(7, values[BRIGHTNESS].value);
+    TEST_ASSERT_EQUAL_INT32(1, values[BLINKING_COLON].value);
+    TEST_ASSERT_EQUAL_INT32(0, values[DISPLAY_ON].value);
+    TEST_ASSERT_EQUAL_INT32(120, values[RING_BRIGHTNESS].value);
+    TEST_ASSERT_EQUAL_INT32(1, values[RING_EFFECT].value);
+}
+
+void test_missing_and_null_fields_are_not_present()
+{
+    TEST_ASSERT_TRUE(parseJson("{\"brightness\": null}"));
+    for (uint8_t i = 0; i < FIELD_COUNT; i++)
+    {
+        TEST_ASSERT_FALSE(values[i].present);
+    }
+}
+
+void test_skips_unknown_keys_and_containers()
+{
+    TEST_ASSERT_TRUE(parseJson("{\"x\": {\"y\": [1, {\"z\": \"}\"}]}, \"brightness\": 3}"));
+    TEST_ASSERT_EQUAL_INT32(3, values[BRIGHTNESS].value);
+}
+
+void test_wrong_types_are_invalid()
+{
+    TEST_ASSERT_TRUE(parseJson("{\"brightness\": true, \"displayOn\": 1, \"ledRingEffect\": \"sparkle\"}"));
+    TEST_ASSERT_TRUE(values[BRIGHTNESS].present);
+    TEST_ASSERT_FALSE(values[BRIGHTNESS].valid);
+    TEST_ASSERT_FALSE(values[DISPLAY_ON].valid);
+    TEST_ASSERT_FALSE(values[RING_EFFECT].valid);
+}
+
+void test_malformed_json_is_rejected()
+{
+    static const char *const bad[] = {
+        "",
+        "[]",
+        "{",
+        "{\"brightness\"}",
+        "{\"brightness\": }",
+        "{\"brightness\": 3,}",
+        "{\"brightness\": \"3}",
+        "{\"brightness\": tru}",
+        "{\"brightness\" 3}",
+    };
+
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+    {
+        TEST_ASSERT_FALSE_MESSAGE(parseJson(bad[i]), bad[i]);
+    }
+}
+
+void test_keys_must_match_exactly()
+{
+    TEST_ASSERT_TRUE(parseJson("{\"bright\": 3, \"brightnessX\": 4}"));
+    TEST_ASSERT_FALSE(values[BRIGHTNESS].present);
+}
+
+/*
+    Fuzzing
+
+    Inputs come from a fixed seed, so a failure is the same every run. They're
+    built out of the bits that make up real payloads (JSON punctuation, our keys,
+    MessagePack type bytes) along with random bytes and NULs, and every one goes
+    in a buffer exactly its own size so a sanitizer build catches any over-read.
+*/
+
+#define FUZZ_RUNS 200000
+#define FUZZ_MAX_LENGTH 96
+
+static uint32_t fuzzState;
+
+static uint32_t fuzzNext()
+{
+    // xorshift32
+    fuzzState ^= fuzzState << 13;
+    fuzzState ^= fuzzState >> 17;
+    fuzzState ^= fuzzState << 5;
+    return fuzzState;
+}
+
+struct FuzzPiece
+{
+    const char *bytes;
+    size_t length;
+};
+
+// Some of these have NULs in them, so they carry their own length
+#define PIECE(bytes) {bytes, sizeof(bytes) - 1}
+
+static const FuzzPiece fuzzPieces[] = {
+    PIECE("{"), PIECE("}"), PIECE("["), PIECE("]"), PIECE(":"), PIECE(","), PIECE("\""), PIECE(" "),
+    PIECE("\\"), PIECE("-"), PIECE("0"), PIECE("7"), PIECE("255"), PIECE("99999999999"),
+    PIECE("true"), PIECE("false"), PIECE("null"), PIECE("\"on\""), PIECE("\"off\""), PIECE("\"comet\""),
+    PIECE("\"brightness\""), PIECE("\"displayOn\""), PIECE("\"ledRingEffect\""),
+    PIECE("\x83"), PIECE("\x81"), PIECE("\xDE\x00\x02"), PIECE("\xDF"), PIECE("\xAA" "brightness"),
+    PIECE("\xA9" "displayOn"), PIECE("\xAA" "displayOn\x00"), PIECE("\xA5" "comet"), PIECE("\xA6" "comet\x00"),
+    PIECE("\xC0"), PIECE("\xC3"), PIECE("\xCC\xFF"), PIECE("\xCF\x01\x02\x03\x04\x05\x06\x07\x08"),
+    PIECE("\xD9\x05"), PIECE("\xDC\x00\x03"), PIECE("\x93"), PIECE("\x00"),
+};
+
+#define FUZZ_PIECES (sizeof(fuzzPieces) / sizeof(fuzzPieces[0]))
+
+/**
+ * @brief Makes up the next input
+ */
+static size_t fuzzInput(char *buffer)
+{
+    size_t length = 0;
+    while (length < FUZZ_MAX_LENGTH && (fuzzNext() % 12) != 0)
+    {
+        uint32_t pick = fuzzNext();
+        if (pick % 3 == 0)
+        {
+            // A random byte, NULs very much included
+            buffer[length++] = (char)(fuzzNext() & 0xFF);
+            continue;
+        }
+
+        const FuzzPiece &piece = fuzzPieces[pick % FUZZ_PIECES];
+        for (size_t i = 0; i < piece.length && length < FUZZ_MAX_LENGTH; i++)
+        {
+            buffer[length++] = piece.bytes[i];
+        }
+    }
+    return length;
+}
+
+/**
+ * @brief Whatever came in, the values have to make sense
+ */
+static void checkValues(const char *format)
+{
+    for (uint8_t i = 0; i < FIELD_COUNT; i++)
+    {
+        if (!values[i].present || !values[i].valid)
+        {
+            continue;
+        }
+
+        switch (schema[i].type)
+        {
+        case CONFIG_FIELD_ON_OFF:
+            TEST_ASSERT_TRUE_MESSAGE(values[i].value == 0 || values[i].value == 1, format);
+            break;
+        case CONFIG_FIELD_CHOICE:
+            TEST_ASSERT_TRUE_MESSAGE(values[i].value >= 0 && values[i].value <= 2, format);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void test_fuzz_json_and_msgpack()
+{
+    fuzzState = 0xC10C4B1D;
+
+    char scratch[FUZZ_MAX_LENGTH];
+    uint32_t parsed = 0;
+    for (uint32_t run = 0; run < FUZZ_RUNS; run++)
+    {
+        size_t length = fuzzInput(scratch);
+
+        char *input = (char *)malloc(length == 0 ? 1 : length);
+        memcpy(input, scratch, length);
+
+        memset(values, 0xAA, sizeof(values));
+        if (parseJsonConfig(input, length, schema, FIELD_COUNT, values))
+        {
+            parsed++;
+            checkValues("json");
+        }
+
+        size_t used = SIZE_MAX;
+        memset(values, 0xAA, sizeof(values));
+        if (parseMsgPackConfig(input, length, schema, FIELD_COUNT, values, used))
+        {
+            parsed++;
+            TEST_ASSERT_TRUE(used <= length);
+            checkValues("msgpack");
+        }
+
+        free(input);
+    }
+
+    char message[80];
+    snprintf(message, sizeof(message), "%u inputs, %u parsed all the way through", FUZZ_RUNS, parsed);
+    TEST_MESSAGE(message);
+}
+
+void test_fuzz_keys_with_nuls_never_match()
+{
+    fuzzState = 0x5EED;
+
+    for (uint32_t run = 0; run < 10000; run++)
+    {
+        // Take a real key, and put a NUL and some junk after it
+        const ConfigField &field = schema[fuzzNext() % FIELD_COUNT];
+        char key[32];
+        size_t keyLength = strlen(field.key);
+        memcpy(key, field.key, keyLength);
+        key[keyLength++] = '\0';
+        size_t junk = fuzzNext() % 4;
+        for (size_t i = 0; i < junk; i++)
+        {
+            key[keyLength++] = (char)(fuzzNext() & 0xFF);
+        }
+
+        char map[48];
+        size_t length = 0;
+        map[length++] = (char)0x81;
+        map[length++] = (char)(0xA0 | keyLength);
+        memcpy(map + length, key, keyLength);
+        length += keyLength;
+        map[length++] = (char)0xC3;
+
+        char *input = (char *)malloc(length);
+        memcpy(input, map, length);
+
+        size_t used;
+        TEST_ASSERT_TRUE(parseMsgPackConfig(input, length, schema, FIELD_COUNT, values, used));
+        for (uint8_t i = 0; i < FIELD_COUNT; i++)
+        {
+            TEST_ASSERT_FALSE_MESSAGE(values[i].present, field.key);
+        }
+
+        free(input);
+    }
+}
+
+void test_benchmark_throughput_and_allocations()
+{
+    const uint32_t runs = 200000;
+
+    size_t allocationsBefore = allocations;
+    size_t bytesBefore = bytesAllocated;
+
+    BenchResult result = runBench(runs, [](uint32_t) {
+        parseJsonConfig(homeAssistant, sizeof(homeAssistant) - 1, schema, FIELD_COUNT, values);
+    });
+
+    // runBench itself doesn't allocate, so anything here came from the parser
+    size_t parserAllocations = allocations - allocationsBefore;
+    size_t parserBytes = bytesAllocated - bytesBefore;
+
+    reportBench("Home Assistant config", result);
+
+    char message[96];
+    snprintf(message, sizeof(message), "%.0f messages/s, %.0f MB/s, %.2f bytes allocated per message",
+             benchPerSecond(result),
+             benchPerSecond(result) * (sizeof(homeAssistant) - 1) / 1e6,
+             (double)parserBytes / runs);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_EQUAL_UINT32(0, parserAllocations);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_reads_what_home_assistant_sends);
+    RUN_TEST(test_missing_and_null_fields_are_not_present);
+    RUN_TEST(test_skips_unknown_keys_and_containers);
+    RUN_TEST(test_wrong_types_are_invalid);
+    RUN_TEST(test_malformed_json_is_rejected);
+    RUN_TEST(test_keys_must_match_exactly);
+    RUN_TEST(test_fuzz_json_and_msgpack);
+    RUN_TEST(test_fuzz_keys_with_nuls_never_match);
+    RUN_TEST(test_benchmark_throughput_and_allocations);
+    return UNITY_END();
+}
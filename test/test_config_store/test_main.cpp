@@ -0,0 +1,211 @@
+#include <Arduino.h>
+#include <Preferences.h>
+#include <unity.h>
+
+#include "esp32/rom/crc.h"
+
+#include "clock_config.h"
+#include "config_store.h"
+
+/*
+    The config store against an in-memory NVS, including the configs that
+    clocks already in the field wrote before there was a fleet to follow
+*/
+
+static const ClockConfig defaults = {8, true, true, 100, 200, 0, false, false};
+
+static StoredConfigV1 makeV1(uint8_t screenBrightness, uint8_t pixelBrightness, uint8_t ringEffect, uint8_t ringDither)
+{
+    StoredConfigV1 config;
+    memset(&config, 0, sizeof(config));
+    config.version = 1;
+    config.screenBrightness = screenBrightness;
+    config.blinkColon = false;
+    config.displayOn = true;
+    config.pixelBrightness = pixelBrightness;
+    config.pixelSaturation = 77;
+    config.ringEffect = ringEffect;
+    config.ringDither = ringDither;
+    config.crc = crc32_le(0, (const uint8_t *)&config, offsetof(StoredConfigV1, crc));
+    return config;
+}
+
+static StoredConfig makeV2(uint8_t screenBrightness, uint8_t ringFleetSync)
+{
+    StoredConfig config;
+    memset(&config, 0, sizeof(config));
+    config.version = CONFIG_STORE_VERSION;
+    config.screenBrightness = screenBrightness;
+    config.blinkColon = true;
+    config.displayOn = false;
+    config.pixelBrightness = 33;
+    config.pixelSaturation = 44;
+    config.ringEffect = 2;
+    config.ringDither = true;
+    config.ringFleetSync = ringFleetSync;
+    config.crc = crc32_le(0, (const uint8_t *)&config, offsetof(StoredConfig, crc));
+    return config;
+}
+
+static void store(const void *blob, size_t length)
+{
+    Preferences::nativeStore(CONFIG_STORE_NAMESPACE, CONFIG_STORE_KEY, blob, length);
+}
+
+static void settle()
+{
+    nativeAdvanceMs(CONFIG_STORE_QUIET_MS + 1);
+    flushStoredConfig();
+}
+
+void setUp()
+{
+    // Don't let anything one test changed get written out in the next one
+    settle();
+    Preferences::nativeClear();
+    setClockConfig(defaults);
+}
+
+void tearDown() {}
+
+void test_layouts_are_what_the_field_has()
+{
+    TEST_ASSERT_EQUAL_UINT32(12, sizeof(StoredConfigV1));
+    TEST_ASSERT_EQUAL_UINT32(8, offsetof(StoredConfigV1, crc));
+    TEST_ASSERT_EQUAL_UINT32(16, sizeof(StoredConfig));
+    TEST_ASSERT_EQUAL_UINT32(12, offsetof(StoredConfig, crc));
+}
+
+void test_nothing_stored_is_missing()
+{
+    TEST_ASSERT_EQUAL(STORED_CONFIG_MISSING, loadStoredConfig());
+
+    ClockConfig config;
+    getClockConfig(config);
+    TEST_ASSERT_EQUAL_UINT8(defaults.screenBrightness, config.screenBrightness);
+}
+
+void test_loads_a_current_config()
+{
+    StoredConfig stored = makeV2(3, true);
+    store(&stored, sizeof(stored));
+
+    TEST_ASSERT_EQUAL(STORED_CONFIG_LOADED, loadStoredConfig());
+
+    ClockConfig config;
+    getClockConfig(config);
+    TEST_ASSERT_EQUAL_UINT8(3, config.screenBrightness);
+    TEST_ASSERT_TRUE(config.blinkColon);
+    TEST_ASSERT_FALSE(config.displayOn);
+    TEST_ASSERT_EQUAL_UINT8(33, config.pixelBrightness);
+    TEST_ASSERT_EQUAL_UINT8(44, config.pixelSaturation);
+    TEST_ASSERT_EQUAL_UINT8(2, config.ringEffect);
+    TEST_ASSERT_TRUE(config.ringDither);
+    TEST_ASSERT_TRUE(config.ringFleetSync);
+
+    // Nothing changed, so there's nothing to write
+    settle();
+    TEST_ASSERT_EQUAL_UINT32(0, Preferences::nativeWrites());
+}
+
+void test_migrates_a_version_1_config()
+{
+    StoredConfigV1 stored = makeV1(12, 150, 1, true);
+    store(&stored, sizeof(stored));
+
+    TEST_ASSERT_EQUAL(STORED_CONFIG_MIGRATED, loadStoredConfig());
+
+    ClockConfig config;
+    getClockConfig(config);
+    TEST_ASSERT_EQUAL_UINT8(12, config.screenBrightness);
+    TEST_ASSERT_FALSE(config.blinkColon);
+    TEST_ASSERT_TRUE(config.displayOn);
+    TEST_ASSERT_EQUAL_UINT8(150, config.pixelBrightness);
+    TEST_ASSERT_EQUAL_UINT8(77, config.pixelSaturation);
+    TEST_ASSERT_EQUAL_UINT8(1, config.ringEffect);
+    TEST_ASSERT_TRUE(config.ringDither);
+
+    // Version 1 didn't know about the fleet, so it's off
+    TEST_ASSERT_FALSE(config.ringFleetSync);
+}
+
+void test_migrated_config_is_written_back_as_current()
+{
+    StoredConfigV1 stored = makeV1(5, 10, 0, false);
+    store(&stored, sizeof(stored));
+    TEST_ASSERT_EQUAL(STORED_CONFIG_MIGRATED, loadStoredConfig());
+
+    // Not before it's been quiet for a while, like any other change
+    flushStoredConfig();
+    TEST_ASSERT_EQUAL_UINT32(0, Preferences::nativeWrites());
+
+    settle();
+    TEST_ASSERT_EQUAL_UINT32(1, Preferences::nativeWrites());
+    TEST_ASSERT_EQUAL_UINT32(sizeof(StoredConfig), Preferences::nativeLength(CONFIG_STORE_NAMESPACE, CONFIG_STORE_KEY));
+
+    // And the next boot loads it without migrating again
+    setClockConfig(defaults);
+    TEST_ASSERT_EQUAL(STORED_CONFIG_LOADED, loadStoredConfig());
+
+    ClockConfig config;
+    getClockConfig(config);
+    TEST_ASSERT_EQUAL_UINT8(5, config.screenBrightness);
+    TEST_ASSERT_EQUAL_UINT8(10, config.pixelBrightness);
+    TEST_ASSERT_FALSE(config.ringFleetSync);
+}
+
+void test_bad_crcs_are_rejected()
+{
+    StoredConfig current = makeV2(3, false);
+    current.pixelBrightness++;
+    store(&current, sizeof(current));
+    TEST_ASSERT_EQUAL(STORED_CONFIG_BAD_CRC, loadStoredConfig());
+
+    StoredConfigV1 old = makeV1(12, 150, 1, true);
+    old.screenBrightness++;
+    store(&old, sizeof(old));
+    TEST_ASSERT_EQUAL(STORED_CONFIG_BAD_CRC, loadStoredConfig());
+
+    ClockConfig config;
+    getClockConfig(config);
+    TEST_ASSERT_EQUAL_UINT8(defaults.screenBrightness, config.screenBrightness);
+    TEST_ASSERT_EQUAL_UINT8(defaults.pixelBrightness, config.pixelBrightness);
+}
+
+void test_unknown_versions_and_sizes_are_wrong_version()
+{
+    // From the future
+    StoredConfig future = makeV2(3, false);
+    future.version = CONFIG_STORE_VERSION + 1;
+    future.crc = crc32_le(0, (const uint8_t *)&future, offsetof(StoredConfig, crc));
+    store(&future, sizeof(future));
+    TEST_ASSERT_EQUAL(STORED_CONFIG_WRONG_VERSION, loadStoredConfig());
+
+    // A version that doesn't go with its size
+    StoredConfig mislabeled = makeV2(3, false);
+    mislabeled.version = 1;
+    store(&mislabeled, sizeof(mislabeled));
+    TEST_ASSERT_EQUAL(STORED_CONFIG_WRONG_VERSION, loadStoredConfig());
+
+    uint8_t odd[7] = {1, 2, 3, 4, 5, 6, 7};
+    store(odd, sizeof(odd));
+    TEST_ASSERT_EQUAL(STORED_CONFIG_WRONG_VERSION, loadStoredConfig());
+
+    // Too big to even read
+    uint8_t big[sizeof(StoredConfig) + 4] = {CONFIG_STORE_VERSION};
+    store(big, sizeof(big));
+    TEST_ASSERT_EQUAL(STORED_CONFIG_MISSING, loadStoredConfig());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_layouts_are_what_the_field_has);
+    RUN_TEST(test_nothing_stored_is_missing);
+    RUN_TEST(test_loads_a_current_config);
+    RUN_TEST(test_migrates_a_version_1_config);
+    RUN_TEST(test_migrated_config_is_written_back_as_current);
+    RUN_TEST(test_bad_crcs_are_rejected);
+    RUN_TEST(test_unknown_versions_and_sizes_are_wrong_version);
+    return UNITY_END();
+}
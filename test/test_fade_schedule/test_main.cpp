@@ -0,0 +1,163 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include "bench.h"
+#include "color.h"
+#include "ring_effects.h"
+
+/*
+    The wipe's fade schedule
+
+    Once a minute the ring works out every step of the fade from the old hue
+    to the new one, and after that each frame is a copy out of the table. The
+    table has to hold exactly what working the colour out on the spot would
+    have given.
+*/
+
+#define SCHEDULE_LEVELS ((STEPS_PER_PIXEL + 1) * 3)
+
+static uint16_t schedule[SCHEDULE_LEVELS];
+
+void setUp()
+{
+    memset(schedule, 0, sizeof(schedule));
+}
+
+void tearDown() {}
+
+/**
+ * @brief What one step of the fade is, worked out the slow way
+ */
+static void stepLevels(uint16_t *levels, uint16_t oldHue, uint16_t newHue, uint8_t saturation, uint8_t brightness, uint8_t step)
+{
+    uint16_t hue = interpolateHue(oldHue, newHue, STEPS_PER_PIXEL, step);
+    renderHsvLevels<1, LED_RING_TYPE>(levels, &hue, saturation, brightness);
+}
+
+static void checkSchedule(uint16_t oldHue, uint16_t newHue, uint8_t saturation, uint8_t brightness)
+{
+    buildFadeSchedule(schedule, oldHue, newHue, saturation, brightness);
+
+    for (uint8_t step = 0; step <= STEPS_PER_PIXEL; step++)
+    {
+        uint16_t expected[3];
+        stepLevels(expected, oldHue, newHue, saturation, brightness, step);
+
+        if (memcmp(expected, schedule + (step * 3), sizeof(expected)) != 0)
+        {
+            char message[96];
+            snprintf(message, sizeof(message), "hue %u -> %u, saturation %u, brightness %u, step %u",
+                     oldHue, newHue, saturation, brightness, step);
+            TEST_FAIL_MESSAGE(message);
+        }
+    }
+}
+
+void test_every_step_matches_working_it_out()
+{
+    const uint8_t brightnesses[] = {0, 1, 20, 128, 255};
+    const uint8_t saturations[] = {0, 128, 255};
+
+    for (uint32_t oldHue = 0; oldHue < 65536; oldHue += 4099)
+    {
+        uint16_t newHue = oldHue + GOLDEN_RATIO_CONJUGATE;
+        for (uint8_t s = 0; s < sizeof(saturations); s++)
+        {
+            for (uint8_t b = 0; b < sizeof(brightnesses); b++)
+            {
+                checkSchedule(oldHue, newHue, saturations[s], brightnesses[b]);
+            }
+        }
+    }
+}
+
+void test_starts_on_the_old_colour()
+{
+    uint16_t oldHue = 12345;
+    uint16_t expected[3];
+    renderHsvLevels<1, LED_RING_TYPE>(expected, &oldHue, 255, 100);
+
+    buildFadeSchedule(schedule, oldHue, oldHue + GOLDEN_RATIO_CONJUGATE, 255, 100);
+    TEST_ASSERT_EQUAL_MEMORY(expected, schedule, sizeof(expected));
+}
+
+void test_ends_on_the_new_colour()
+{
+    for (uint32_t oldHue = 0; oldHue < 65536; oldHue += 997)
+    {
+        const uint16_t newHues[] = {(uint16_t)(oldHue + GOLDEN_RATIO_CONJUGATE), (uint16_t)(oldHue + 1),
+                                    (uint16_t)(oldHue - 1), (uint16_t)(oldHue * 7)};
+        for (uint8_t i = 0; i < sizeof(newHues) / sizeof(newHues[0]); i++)
+        {
+            TEST_ASSERT_EQUAL_UINT16(newHues[i], interpolateHue(oldHue, newHues[i], STEPS_PER_PIXEL, STEPS_PER_PIXEL));
+        }
+    }
+
+    uint16_t newHue = 12345 + GOLDEN_RATIO_CONJUGATE;
+    uint16_t expected[3];
+    renderHsvLevels<1, LED_RING_TYPE>(expected, &newHue, 255, 100);
+
+    buildFadeSchedule(schedule, 12345, newHue, 255, 100);
+    TEST_ASSERT_EQUAL_MEMORY(expected, schedule + (STEPS_PER_PIXEL * 3), sizeof(expected));
+}
+
+void test_benchmark_table_vs_working_it_out()
+{
+    /*
+        One pixel a frame, like the wipe. A single frame is about as quick as
+        reading the clock, so each run is a whole minute of frames.
+    */
+    const uint32_t minutes = 500;
+    uint16_t oldHue = 1000;
+    uint16_t newHue = oldHue + GOLDEN_RATIO_CONJUGATE;
+    static uint16_t levels[NUMBER_OF_PIXELS * 3];
+
+    BenchResult build = runBench(10000, [&](uint32_t run) {
+        buildFadeSchedule(schedule, oldHue + run, newHue + run, 255, 128);
+    });
+
+    buildFadeSchedule(schedule, oldHue, newHue, 255, 128);
+    BenchResult table = runBench(minutes, [&](uint32_t) {
+        for (uint16_t frame = 0; frame < RING_FRAMES_PER_MINUTE; frame++)
+        {
+            uint8_t step = (frame % STEPS_PER_PIXEL) + 1;
+            uint16_t pixel = frame / STEPS_PER_PIXEL;
+            memcpy(levels + (pixel * 3), schedule + (step * 3), RING_PIXEL_LEVEL_BYTES);
+        }
+    });
+
+    BenchResult hsv = runBench(minutes, [&](uint32_t) {
+        for (uint16_t frame = 0; frame < RING_FRAMES_PER_MINUTE; frame++)
+        {
+            uint8_t step = (frame % STEPS_PER_PIXEL) + 1;
+            uint16_t pixel = frame / STEPS_PER_PIXEL;
+            stepLevels(levels + (pixel * 3), oldHue, newHue, 255, 128, step);
+        }
+    });
+
+    reportBench("build the schedule (once a minute)", build);
+
+    char message[128];
+    snprintf(message, sizeof(message), "per frame: table %.1fns (%.1fns in the worst minute), HSV %.1fns (%.1fns in the worst minute)",
+             benchMeanNs(table) / RING_FRAMES_PER_MINUTE,
+             (double)table.worstNs / RING_FRAMES_PER_MINUTE,
+             benchMeanNs(hsv) / RING_FRAMES_PER_MINUTE,
+             (double)hsv.worstNs / RING_FRAMES_PER_MINUTE);
+    TEST_MESSAGE(message);
+
+    // Keep the compiler from throwing the frames away
+    TEST_ASSERT_TRUE(levels[0] != 0xFFFF);
+
+    // The whole point of the table
+    TEST_ASSERT_LESS_THAN(benchMeanNs(hsv), benchMeanNs(table));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_every_step_matches_working_it_out);
+    RUN_TEST(test_starts_on_the_old_colour);
+    RUN_TEST(test_ends_on_the_new_colour);
+    RUN_TEST(test_benchmark_table_vs_working_it_out);
+    return UNITY_END();
+}
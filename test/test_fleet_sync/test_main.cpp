@@ -0,0 +1,266 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include "clock_config.h"
+#include "fleet_sync.h"
+#include "seconds_ring.h"
+
+/*
+    A room full of clocks following one sync message, on the host
+
+    There's only one fleet schedule per process, so the clocks take turns: the
+    broker stand-in hands the retained message to a clock, and that clock keeps
+    the hues it worked out for every minute of the run (which is all the ring
+    ever asks for). Each clock's wall clock is off from the true time by a bit,
+    the way SNTP leaves them.
+
+    Then we walk the true time through the run and see where each clock is in
+    the fleet's schedule (which minute's hue, and which frame of it), just like
+    the ring would: frames are due at fixed times past the top of the minute
+    on its own wall clock.
+*/
+
+#define START_MINUTE 29400000 // Somewhere in 2025
+#define RUN_MINUTES 5
+#define SAMPLE_US 1000
+
+#define MAX_CLOCKS 4
+
+static void publishSchedule(char *message, size_t size, uint32_t startMinute, uint16_t hueSeed)
+{
+    snprintf(message, size, "{\"startMinute\": %u, \"hueSeed\": %u}", startMinute, hueSeed);
+}
+
+/**
+ * @brief One clock in the room
+ */
+struct SimClock
+{
+    int32_t offsetUs; // How far ahead of the true time its wall clock is
+    boolean restarted;
+    uint16_t hues[RUN_MINUTES + 1];
+};
+
+/**
+ * @brief Stands in for the broker's retained message on the global topic
+ */
+class NativeBroker
+{
+public:
+    void publish(const char *payload)
+    {
+        strncpy(retained, payload, sizeof(retained) - 1);
+        retained[sizeof(retained) - 1] = '\0';
+    }
+
+    // Delivers the retained message to a clock, and lets it work out its schedule
+    void deliver(SimClock &clock)
+    {
+        clock.restarted = updateFleetSchedule(retained, strlen(retained));
+        for (uint32_t i = 0; i <= RUN_MINUTES; i++)
+        {
+            TEST_ASSERT_TRUE(getFleetHue(START_MINUTE + i, clock.hues[i]));
+        }
+    }
+
+private:
+    char retained[128];
+};
+
+static void setFleetSync(boolean on)
+{
+    ClockConfig config;
+    getClockConfig(config);
+    config.ringFleetSync = on;
+    setClockConfig(config);
+}
+
+void setUp()
+{
+    setFleetSync(true);
+}
+
+void tearDown() {}
+
+void test_takes_a_good_schedule()
+{
+    uint32_t received = fleetSyncStats.received;
+    const char *message = "{\"startMinute\": 29400000, \"hueSeed\": 1234}";
+
+    TEST_ASSERT_TRUE(updateFleetSchedule(message, strlen(message)));
+    TEST_ASSERT_EQUAL_UINT32(received + 1, fleetSyncStats.received);
+    TEST_ASSERT_EQUAL_UINT32(29400000, fleetSyncStats.startMinute);
+    TEST_ASSERT_EQUAL_UINT16(1234, fleetSyncStats.hueSeed);
+
+    uint16_t hue;
+    TEST_ASSERT_TRUE(getFleetHue(29400000, hue));
+    TEST_ASSERT_EQUAL_UINT16(1234, hue);
+    TEST_ASSERT_TRUE(fleetSyncStats.following);
+}
+
+void test_rejects_bad_schedules()
+{
+    const char *messages[] = {
+        "{\"startMinute\": 29400000}",
+        "{\"hueSeed\": 1234}",
+        "{\"startMinute\": 100, \"hueSeed\": 1234}",
+        "{\"startMinute\": 29400000, \"hueSeed\": 65535}",
+        "{\"startMinute\": 29400000, \"hueSeed\": -1}",
+        "not even json",
+    };
+    const uint8_t count = sizeof(messages) / sizeof(messages[0]);
+
+    uint32_t rejected = fleetSyncStats.rejected;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        TEST_ASSERT_FALSE_MESSAGE(updateFleetSchedule(messages[i], strlen(messages[i])), messages[i]);
+    }
+    TEST_ASSERT_EQUAL_UINT32(rejected + count, fleetSyncStats.rejected);
+}
+
+void test_doesnt_follow_when_its_turned_off()
+{
+    const char *message = "{\"startMinute\": 29400000, \"hueSeed\": 1234}";
+    setFleetSync(false);
+
+    // Still keeps the schedule, so turning it on later works right away
+    TEST_ASSERT_FALSE(updateFleetSchedule(message, strlen(message)));
+
+    uint16_t hue;
+    TEST_ASSERT_FALSE(getFleetHue(29400000, hue));
+    TEST_ASSERT_FALSE(fleetSyncStats.following);
+
+    setFleetSync(true);
+    TEST_ASSERT_TRUE(getFleetHue(29400000, hue));
+    TEST_ASSERT_EQUAL_UINT16(1234, hue);
+}
+
+void test_steps_by_the_golden_ratio_both_ways()
+{
+    const char *message = "{\"startMinute\": 29400000, \"hueSeed\": 65000}";
+    TEST_ASSERT_TRUE(updateFleetSchedule(message, strlen(message)));
+
+    for (int32_t step = -200; step < 200; step++)
+    {
+        uint16_t hue, next;
+        TEST_ASSERT_TRUE(getFleetHue(29400000 + step, hue));
+        TEST_ASSERT_TRUE(getFleetHue(29400000 + step + 1, next));
+        TEST_ASSERT_EQUAL_UINT16((hue + GOLDEN_RATIO_CONJUGATE) % USHRT_MAX, next);
+    }
+}
+
+void test_republished_schedule_lands_on_the_same_hues()
+{
+    char message[128];
+    NativeBroker broker;
+    SimClock first, late;
+
+    publishSchedule(message, sizeof(message), START_MINUTE, 4321);
+    broker.publish(message);
+    broker.deliver(first);
+
+    // Somebody sends it again later, starting from where the fleet is by then
+    publishSchedule(message, sizeof(message), START_MINUTE + 3, first.hues[3]);
+    broker.publish(message);
+    broker.deliver(late);
+
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(first.hues, late.hues, RUN_MINUTES + 1);
+}
+
+/**
+ * @brief Where a clock is in the fleet's schedule at a true time
+ *
+ * @return int64_t how far into the run (in microseconds) the frame it's
+ *         showing is due, by the fleet's schedule
+ */
+static int64_t schedulePositionUs(const SimClock &clock, int64_t trueUs, uint16_t &hue)
+{
+    int64_t wallUs = trueUs + clock.offsetUs;
+    int64_t minute = wallUs / 60000000LL;
+    int64_t frame = (wallUs - minute * 60000000LL) / RING_FRAME_PERIOD_US;
+
+    hue = clock.hues[minute];
+    return minute * 60000000LL + frame * RING_FRAME_PERIOD_US;
+}
+
+void test_phase_error_across_clocks()
+{
+    char message[128];
+    NativeBroker broker;
+    SimClock clocks[MAX_CLOCKS] = {};
+
+    // A few milliseconds either way, which is about what SNTP gets us
+    const int32_t offsetsUs[MAX_CLOCKS] = {-3000, 0, 2000, 7000};
+    const int32_t spreadUs = 10000;
+
+    publishSchedule(message, sizeof(message), START_MINUTE, 4321);
+    broker.publish(message);
+    for (uint8_t i = 0; i < MAX_CLOCKS; i++)
+    {
+        clocks[i].offsetUs = offsetsUs[i];
+        broker.deliver(clocks[i]);
+        TEST_ASSERT_TRUE(clocks[i].restarted);
+    }
+
+    // Stay clear of the ends, so every clock has a minute to look at
+    const int64_t firstUs = spreadUs;
+    const int64_t lastUs = RUN_MINUTES * 60000000LL - spreadUs;
+
+    int64_t worstUs = 0;
+    int64_t totalUs = 0;
+    uint32_t samples = 0;
+    uint32_t hueMismatches = 0;
+    for (int64_t trueUs = firstUs; trueUs < lastUs; trueUs += SAMPLE_US)
+    {
+        int64_t earliest = INT64_MAX;
+        int64_t latest = INT64_MIN;
+        uint16_t firstHue = 0;
+        boolean hueAgrees = true;
+        for (uint8_t i = 0; i < MAX_CLOCKS; i++)
+        {
+            uint16_t hue;
+            int64_t position = schedulePositionUs(clocks[i], trueUs, hue);
+            earliest = position < earliest ? position : earliest;
+            latest = position > latest ? position : latest;
+
+            if (i == 0)
+            {
+                firstHue = hue;
+            }
+            hueAgrees &= hue == firstHue;
+        }
+
+        int64_t errorUs = latest - earliest;
+        worstUs = errorUs > worstUs ? errorUs : worstUs;
+        totalUs += errorUs;
+        samples++;
+        hueMismatches += !hueAgrees;
+    }
+
+    char report[160];
+    snprintf(report, sizeof(report), "%u clocks %dus apart: worst phase error %lldus, mean %.0fus, hues differed for %ums",
+             MAX_CLOCKS,
+             spreadUs,
+             (long long)worstUs,
+             (double)totalUs / samples,
+             hueMismatches * SAMPLE_US / 1000);
+    TEST_MESSAGE(report);
+
+    // Nobody's further apart than their clocks are (rounded to a frame)
+    TEST_ASSERT_LESS_OR_EQUAL(spreadUs + RING_FRAME_PERIOD_US, worstUs);
+
+    // And they only show different colours right around the top of a minute
+    TEST_ASSERT_LESS_OR_EQUAL((RUN_MINUTES - 1) * spreadUs / SAMPLE_US, hueMismatches);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_takes_a_good_schedule);
+    RUN_TEST(test_rejects_bad_schedules);
+    RUN_TEST(test_doesnt_follow_when_its_turned_off);
+    RUN_TEST(test_steps_by_the_golden_ratio_both_ways);
+    RUN_TEST(test_republished_schedule_lands_on_the_same_hues);
+    RUN_TEST(test_phase_error_across_clocks);
+    return UNITY_END();
+}
@@ -0,0 +1,97 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include "frame_stats.h"
+
+/*
+    FrameStats, fed cycle counts by hand (the host pretends to be a 240MHz ESP32)
+*/
+
+#define DEADLINE_US 40000
+#define CYCLES_PER_US NATIVE_CPU_FREQ_MHZ
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_counts_frames_and_deadline_misses()
+{
+    FrameStats stats(DEADLINE_US);
+
+    stats.record(0, 1000 * CYCLES_PER_US, 2000 * CYCLES_PER_US);
+    stats.record(30000, 5000 * CYCLES_PER_US, 5000 * CYCLES_PER_US);
+    stats.record(30000, 5000 * CYCLES_PER_US, 5001 * CYCLES_PER_US);
+
+    TEST_ASSERT_EQUAL_UINT32(3, stats.getFrames());
+    TEST_ASSERT_EQUAL_UINT32(1, stats.getDeadlineMisses());
+    TEST_ASSERT_EQUAL_UINT32(DEADLINE_US, stats.getDeadlineUs());
+}
+
+void test_deadline_can_change()
+{
+    FrameStats stats(DEADLINE_US);
+
+    // Like the ring going into high frame-rate mode, four times as fast
+    stats.setDeadlineUs(DEADLINE_US / 4);
+    TEST_ASSERT_EQUAL_UINT32(DEADLINE_US / 4, stats.getDeadlineUs());
+
+    stats.record(0, 5000 * CYCLES_PER_US, 5000 * CYCLES_PER_US);
+    stats.record(0, 5000 * CYCLES_PER_US, 5001 * CYCLES_PER_US);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.getDeadlineMisses());
+
+    // And back
+    stats.setDeadlineUs(DEADLINE_US);
+    stats.record(0, 5000 * CYCLES_PER_US, 5001 * CYCLES_PER_US);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.getDeadlineMisses());
+}
+
+void test_waking_up_early_isnt_late()
+{
+    FrameStats stats(DEADLINE_US);
+
+    stats.record(-5000, 0, 0);
+    TEST_ASSERT_EQUAL_INT32(0, stats.lateness.getMaximum());
+}
+
+void test_adds_up_busy_time()
+{
+    FrameStats stats(DEADLINE_US);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.getBusyUs());
+
+    stats.record(100, 1000 * CYCLES_PER_US, 250 * CYCLES_PER_US);
+    stats.record(100, 500 * CYCLES_PER_US, 250 * CYCLES_PER_US);
+
+    // Being late isn't being busy
+    TEST_ASSERT_EQUAL_UINT32(2000, stats.getBusyUs());
+}
+
+void test_busy_time_differences_survive_wrapping()
+{
+    FrameStats stats(DEADLINE_US);
+
+    // About 71 minutes of work, in 17.5ms frames
+    const uint32_t frameUs = 17500;
+    uint32_t before = 0;
+    for (uint32_t i = 0; i < 250000; i++)
+    {
+        if (i == 245000)
+        {
+            before = stats.getBusyUs();
+        }
+        stats.record(0, frameUs * CYCLES_PER_US, 0);
+    }
+
+    TEST_ASSERT_TRUE(stats.getBusyUs() < before);
+    TEST_ASSERT_EQUAL_UINT32(5000 * frameUs, stats.getBusyUs() - before);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_counts_frames_and_deadline_misses);
+    RUN_TEST(test_deadline_can_change);
+    RUN_TEST(test_waking_up_early_isnt_late);
+    RUN_TEST(test_adds_up_busy_time);
+    RUN_TEST(test_busy_time_differences_survive_wrapping);
+    return UNITY_END();
+}
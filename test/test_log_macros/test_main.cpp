@@ -0,0 +1,151 @@
+#include <Arduino.h>
+#include <unity.h>
+
+// Build this suite at warning level, so half the macros are on and half are gone
+#define CLOCKY_LOG_LEVEL 2
+
+#include "bench.h"
+#include "logging/logging.h"
+#include "log_macros.h"
+
+using namespace creatures;
+
+static Logger l;
+
+// How many times an argument got worked out
+static uint32_t evaluated = 0;
+
+static int expensive()
+{
+    evaluated++;
+    return 42;
+}
+
+void setUp()
+{
+    evaluated = 0;
+    Logger::getCalls() = 0;
+}
+
+void tearDown() {}
+
+void test_levels_at_or_above_the_build_level_log()
+{
+    LOG_ERROR(l, "error %d", expensive());
+    LOG_WARNING(l, "warning %d", expensive());
+
+    TEST_ASSERT_EQUAL_UINT32(2, evaluated);
+    TEST_ASSERT_EQUAL_UINT32(2, Logger::getCalls());
+}
+
+void test_levels_below_the_build_level_cost_nothing()
+{
+    LOG_INFO(l, "info %d", expensive());
+    LOG_DEBUG(l, "debug %d", expensive());
+    LOG_VERBOSE(l, "verbose %d", expensive());
+    LOG_INFO_EVERY(l, 0, "info %d", expensive());
+    LOG_DEBUG_EVERY(l, 0, "debug %d", expensive());
+    LOG_VERBOSE_EVERY(l, 0, "verbose %d", expensive());
+
+    // The arguments weren't even evaluated
+    TEST_ASSERT_EQUAL_UINT32(0, evaluated);
+    TEST_ASSERT_EQUAL_UINT32(0, Logger::getCalls());
+}
+
+void test_macros_are_single_statements()
+{
+    // Without the do/while these would grab the else
+    if (evaluated == 0)
+        LOG_DEBUG(l, "gone");
+    else
+        TEST_FAIL_MESSAGE("the else belongs to the if");
+
+    if (evaluated == 0)
+        LOG_WARNING_EVERY(l, 1000, "once");
+    else
+        TEST_FAIL_MESSAGE("the else belongs to the if");
+}
+
+void test_rate_limit_lets_the_first_one_through()
+{
+    for (uint8_t i = 0; i < 10; i++)
+    {
+        LOG_WARNING_EVERY(l, 60000, "warning %d", expensive());
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(1, Logger::getCalls());
+
+    // Only the call that got through worked out its arguments
+    TEST_ASSERT_EQUAL_UINT32(1, evaluated);
+}
+
+void test_rate_limit_is_per_call_site()
+{
+    LOG_ERROR_EVERY(l, 60000, "one");
+    LOG_ERROR_EVERY(l, 60000, "two");
+    TEST_ASSERT_EQUAL_UINT32(2, Logger::getCalls());
+}
+
+void test_rate_limit_lets_one_through_each_interval()
+{
+    unsigned long start = millis();
+    while (millis() - start < 250)
+    {
+        LOG_WARNING_EVERY(l, 100, "tick");
+    }
+
+    // At 0, 100 and 200ms (a busy host might miss the last one)
+    TEST_ASSERT_TRUE(Logger::getCalls() >= 2);
+    TEST_ASSERT_TRUE(Logger::getCalls() <= 3);
+}
+
+void test_benchmark_render_loop_cost_per_level()
+{
+    // A log call in the middle of a frame, with an argument that takes some work
+    const uint32_t frames = 200000;
+    volatile uint32_t frame = 0;
+
+    BenchResult none = runBench(frames, [&](uint32_t i) {
+        frame = i;
+    });
+    BenchResult elided = runBench(frames, [&](uint32_t i) {
+        frame = i;
+        LOG_DEBUG(l, "frame %u, pixel %u", frame, frame % 60);
+    });
+    BenchResult limited = runBench(frames, [&](uint32_t i) {
+        frame = i;
+        LOG_WARNING_EVERY(l, 1000, "frame %u, pixel %u", frame, frame % 60);
+    });
+    BenchResult logged = runBench(frames, [&](uint32_t i) {
+        frame = i;
+        LOG_WARNING(l, "frame %u, pixel %u", frame, frame % 60);
+    });
+
+    reportBench("no log call", none);
+    reportBench("LOG_DEBUG (compiled out)", elided);
+    reportBench("LOG_WARNING_EVERY (rate limited)", limited);
+    reportBench("LOG_WARNING", logged);
+
+    char message[128];
+    snprintf(message, sizeof(message), "per frame over no call: compiled out %.1fns, rate limited %.1fns, logged %.1fns",
+             benchMeanNs(elided) - benchMeanNs(none),
+             benchMeanNs(limited) - benchMeanNs(none),
+             benchMeanNs(logged) - benchMeanNs(none));
+    TEST_MESSAGE(message);
+
+    // Formatting every frame has to cost more than not
+    TEST_ASSERT_TRUE(benchMeanNs(logged) > benchMeanNs(elided));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_levels_at_or_above_the_build_level_log);
+    RUN_TEST(test_levels_below_the_build_level_cost_nothing);
+    RUN_TEST(test_macros_are_single_statements);
+    RUN_TEST(test_rate_limit_lets_the_first_one_through);
+    RUN_TEST(test_rate_limit_is_per_call_site);
+    RUN_TEST(test_rate_limit_lets_one_through_each_interval);
+    RUN_TEST(test_benchmark_render_loop_cost_per_level);
+    return UNITY_END();
+}
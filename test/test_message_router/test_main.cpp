@@ -0,0 +1,235 @@
+#include <Arduino.h>
+#include <unity.h>
+
+extern "C"
+{
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+}
+
+#include "bench.h"
+#include "mqtt/mqtt.h"
+
+#include "message_router.h"
+
+/*
+    The router's table can't be cleared, so every topic the tests use is
+    registered once in main(). The queue never blocks on the host, so each
+    routeMessages() call is one batch: everything that was queued up before it.
+*/
+
+#define QUEUE_LENGTH 16
+#define MAX_CALLS 32
+
+static QueueHandle_t queue;
+
+// Who got called with what, in order
+static char calls[MAX_CALLS][32];
+static uint8_t callCount = 0;
+
+static void record(const char *name, const char *payload)
+{
+    if (callCount < MAX_CALLS)
+    {
+        snprintf(calls[callCount++], sizeof(calls[0]), "%s:%s", name, payload);
+    }
+}
+
+static void handleCmd(const char *payload, size_t) { record("cmd", payload); }
+static void handleConfig(const char *payload, size_t) { record("config", payload); }
+static void handleSync(const char *payload, size_t) { record("sync", payload); }
+static void handleOther(const char *payload, size_t) { record("other", payload); }
+
+static size_t binaryLength = 0;
+static void handleBinary(const char *, size_t length) { binaryLength = length; }
+
+static void send(const char *topic, const char *payload, boolean global = false)
+{
+    struct MqttMessage message;
+    memset(&message, 0, sizeof(message));
+    snprintf(global ? message.topicGlobalNamespace : message.topic, sizeof(message.topic), "%s", topic);
+    snprintf(message.payload, sizeof(message.payload), "%s", payload);
+    TEST_ASSERT_EQUAL_INT(pdPASS, xQueueSend(queue, &message, 0));
+}
+
+static void registerTopics()
+{
+    registerTopicHandler("cmd", TOPIC_LOCAL, handleCmd, TOPIC_NO_FLAGS);
+    registerTopicHandler("config", TOPIC_LOCAL, handleConfig, TOPIC_COALESCE);
+    registerTopicHandler("config/msgpack", TOPIC_LOCAL, handleConfig, TOPIC_COALESCE | TOPIC_BINARY);
+    registerTopicHandler("sync", TOPIC_GLOBAL, handleSync, TOPIC_COALESCE);
+    registerTopicHandler("other", TOPIC_LOCAL, handleOther, TOPIC_NO_FLAGS);
+    registerTopicHandler("binary", TOPIC_LOCAL, handleBinary, TOPIC_BINARY);
+}
+
+void setUp()
+{
+    callCount = 0;
+    memset(&messageStats, 0, sizeof(messageStats));
+}
+
+void tearDown() {}
+
+void test_hash_is_the_same_at_compile_time_and_run_time()
+{
+    static_assert(topicHash("config") != topicHash("conf"), "the hashes should differ");
+    TEST_ASSERT_EQUAL_UINT32(topicHash("config"), boundedTopicHash("config/msgpack", 6));
+    TEST_ASSERT_EQUAL_UINT32(topicHash("cmd"), boundedTopicHash("cmd\0junk", 8));
+}
+
+void test_registering_twice_or_too_many_coalesced_fails()
+{
+    TEST_ASSERT_FALSE(registerTopicHandler("cmd", TOPIC_LOCAL, handleOther, TOPIC_NO_FLAGS));
+    TEST_ASSERT_FALSE(registerTopicHandler("fourth", TOPIC_LOCAL, handleOther, TOPIC_COALESCE));
+
+    // The same name in the other namespace is someone else's topic
+    TEST_ASSERT_TRUE(registerTopicHandler("cmd", TOPIC_GLOBAL, handleOther, TOPIC_NO_FLAGS));
+}
+
+void test_routes_by_topic_and_namespace()
+{
+    send("cmd", "a");
+    send("conf", "nobody");
+    send("sync", "local, so nobody");
+    send("other", "b");
+    routeMessages(queue, 0);
+
+    TEST_ASSERT_EQUAL_UINT8(2, callCount);
+    TEST_ASSERT_EQUAL_STRING("cmd:a", calls[0]);
+    TEST_ASSERT_EQUAL_STRING("other:b", calls[1]);
+    TEST_ASSERT_EQUAL_UINT32(4, messageStats.received);
+    TEST_ASSERT_EQUAL_UINT32(2, messageStats.unrouted);
+}
+
+void test_coalesces_to_the_newest_message()
+{
+    send("config", "1");
+    send("cmd", "x");
+    send("config", "2");
+    send("config", "3");
+    routeMessages(queue, 0);
+
+    TEST_ASSERT_EQUAL_UINT8(2, callCount);
+    TEST_ASSERT_EQUAL_STRING("cmd:x", calls[0]);
+    TEST_ASSERT_EQUAL_STRING("config:3", calls[1]);
+    TEST_ASSERT_EQUAL_UINT32(1, messageStats.batches);
+    TEST_ASSERT_EQUAL_UINT32(2, messageStats.coalesced);
+    TEST_ASSERT_EQUAL_UINT32(2, messageStats.handled);
+}
+
+void test_coalesced_topics_are_handled_in_arrival_order()
+{
+    // Both of these go to the same handler, so the newer one has to be last
+    send("config/msgpack", "older");
+    send("config", "newer");
+    routeMessages(queue, 0);
+
+    TEST_ASSERT_EQUAL_UINT8(2, callCount);
+    TEST_ASSERT_EQUAL_STRING("config:older", calls[0]);
+    TEST_ASSERT_EQUAL_STRING("config:newer", calls[1]);
+
+    callCount = 0;
+    send("config", "older");
+    send("sync", "middle", true);
+    send("config/msgpack", "newer");
+    routeMessages(queue, 0);
+
+    TEST_ASSERT_EQUAL_UINT8(3, callCount);
+    TEST_ASSERT_EQUAL_STRING("config:older", calls[0]);
+    TEST_ASSERT_EQUAL_STRING("sync:middle", calls[1]);
+    TEST_ASSERT_EQUAL_STRING("config:newer", calls[2]);
+
+    // A replaced message moves to where its replacement showed up
+    callCount = 0;
+    send("sync", "replaced", true);
+    send("config", "first");
+    send("sync", "second", true);
+    routeMessages(queue, 0);
+
+    TEST_ASSERT_EQUAL_UINT8(2, callCount);
+    TEST_ASSERT_EQUAL_STRING("config:first", calls[0]);
+    TEST_ASSERT_EQUAL_STRING("sync:second", calls[1]);
+}
+
+void test_binary_topics_get_the_whole_buffer()
+{
+    send("binary", "");
+    routeMessages(queue, 0);
+    TEST_ASSERT_EQUAL_UINT32(sizeof(((struct MqttMessage *)0)->payload), binaryLength);
+}
+
+void test_nothing_queued_does_nothing()
+{
+    routeMessages(queue, 0);
+    TEST_ASSERT_EQUAL_UINT32(0, messageStats.batches);
+    TEST_ASSERT_EQUAL_UINT8(0, callCount);
+}
+
+void test_benchmark_dispatch_cost()
+{
+    // A burst like Home Assistant sends when a few things change at once
+    static struct MqttMessage burst[8];
+    static const char *const topics[] = {"config", "cmd", "config", "sync", "config/msgpack", "cmd", "config", "sync"};
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        memset(&burst[i], 0, sizeof(burst[i]));
+        boolean global = strcmp(topics[i], "sync") == 0;
+        snprintf(global ? burst[i].topicGlobalNamespace : burst[i].topic, sizeof(burst[i].topic), "%s", topics[i]);
+        snprintf(burst[i].payload, sizeof(burst[i].payload), "{\"brightness\": %u}", i);
+    }
+
+    // Filling the queue is part of the timing, so time it on its own too
+    BenchResult fill = runBench(20000, [&](uint32_t) {
+        for (uint8_t i = 0; i < 8; i++)
+        {
+            xQueueSend(queue, &burst[i], 0);
+        }
+        struct MqttMessage drain;
+        while (xQueueReceive(queue, &drain, 0) == pdPASS)
+        {
+        }
+    });
+
+    BenchResult route = runBench(20000, [&](uint32_t) {
+        callCount = 0;
+        for (uint8_t i = 0; i < 8; i++)
+        {
+            xQueueSend(queue, &burst[i], 0);
+        }
+        routeMessages(queue, 0);
+    });
+
+    reportBench("queue only, 8 messages", fill);
+    reportBench("queue and route, 8 messages", route);
+
+    char message[96];
+    snprintf(message, sizeof(message), "about %.0fns to route each message",
+             (benchMeanNs(route) - benchMeanNs(fill)) / 8);
+    TEST_MESSAGE(message);
+
+    // Each burst collapses to two commands and one of each coalesced topic
+    TEST_ASSERT_EQUAL_UINT8(5, callCount);
+    TEST_ASSERT_EQUAL_STRING("config:{\"brightness\": 4}", calls[2]);
+    TEST_ASSERT_EQUAL_STRING("config:{\"brightness\": 6}", calls[3]);
+    TEST_ASSERT_EQUAL_STRING("sync:{\"brightness\": 7}", calls[4]);
+}
+
+int main()
+{
+    queue = xQueueCreate(QUEUE_LENGTH, sizeof(struct MqttMessage));
+    registerTopics();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_hash_is_the_same_at_compile_time_and_run_time);
+    RUN_TEST(test_registering_twice_or_too_many_coalesced_fails);
+    RUN_TEST(test_routes_by_topic_and_namespace);
+    RUN_TEST(test_coalesces_to_the_newest_message);
+    RUN_TEST(test_coalesced_topics_are_handled_in_arrival_order);
+    RUN_TEST(test_binary_topics_get_the_whole_buffer);
+    RUN_TEST(test_nothing_queued_does_nothing);
+    RUN_TEST(test_benchmark_dispatch_cost);
+    int failures = UNITY_END();
+
+    vQueueDelete(queue);
+    return failures;
+}
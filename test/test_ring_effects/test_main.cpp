@@ -0,0 +1,158 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include "bench.h"
+#include "ring_effects.h"
+
+/*
+    The effects, drawn a minute at a time on the host
+
+    The budget tests time a whole minute of frames, each one a redraw (the
+    worst case), a few times over and keep the fastest. That's turned into
+    ESP32 cycles with BENCH_ESP32_CYCLES_PER_HOST_NS and held to the effect's
+    CYCLE_BUDGET, which only has about half again as much room as the effect
+    needed in an unoptimized build (the slowest) when the budget was set. An
+    effect that gets a lot slower fails.
+*/
+
+#define PIXELS NUMBER_OF_PIXELS
+#define LEVELS (PIXELS * 3)
+#define BUDGET_PASSES 5
+
+static RingEffectState<PIXELS> state;
+static uint16_t levels[LEVELS];
+
+static void beginEffect(uint8_t effect)
+{
+    memset(&state, 0, sizeof(state));
+    state.oldHue = 1000;
+    state.newHue = 1000 + GOLDEN_RATIO_CONJUGATE;
+    state.saturation = 255;
+    state.brightness = 200;
+    beginRingEffect<PIXELS>(effect, state);
+}
+
+void setUp()
+{
+    memset(levels, 0, sizeof(levels));
+}
+
+void tearDown() {}
+
+/**
+ * @brief Times a minute of an effect, with every frame a redraw, and checks it against the budget
+ */
+template <typename EFFECT>
+static void checkBudget(uint8_t effect, const char *name)
+{
+    uint64_t fastestNs = UINT64_MAX;
+    for (uint8_t pass = 0; pass < BUDGET_PASSES; pass++)
+    {
+        beginEffect(effect);
+        uint64_t start = nativeNowNs();
+        for (uint16_t frame = 0; frame < RING_FRAMES_PER_MINUTE; frame++)
+        {
+            EFFECT::render(state, levels, frame, true);
+        }
+        uint64_t took = nativeNowNs() - start;
+        fastestNs = took < fastestNs ? took : fastestNs;
+    }
+
+    double hostNs = (double)fastestNs / RING_FRAMES_PER_MINUTE;
+    uint32_t cycles = (uint32_t)(hostNs * BENCH_ESP32_CYCLES_PER_HOST_NS);
+
+    char message[128];
+    snprintf(message, sizeof(message), "%s: %.1fns a frame on the host, about %u cycles on the ESP32, budget %u",
+             name, hostNs, cycles, EFFECT::CYCLE_BUDGET);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(EFFECT::CYCLE_BUDGET * BENCH_SLACK, cycles, name);
+}
+
+void test_wipe_is_within_budget()
+{
+    checkBudget<WipeEffect<PIXELS> >(RING_EFFECT_WIPE, "wipe");
+}
+
+void test_comet_is_within_budget()
+{
+    checkBudget<CometEffect<PIXELS> >(RING_EFFECT_COMET, "comet");
+}
+
+void test_breathing_is_within_budget()
+{
+    checkBudget<BreathingEffect<PIXELS> >(RING_EFFECT_BREATHING, "breathing");
+}
+
+void test_gradient_is_within_budget()
+{
+    checkBudget<GradientEffect<PIXELS> >(RING_EFFECT_GRADIENT, "gradient");
+}
+
+/**
+ * @brief Draws a minute frame by frame, skipping some, and checks every frame
+ *        against the same frame drawn from scratch
+ */
+static void checkIncrementalMatchesRedraw(uint8_t effect, uint8_t skip)
+{
+    static RingEffectState<PIXELS> redrawState;
+    static uint16_t redrawLevels[LEVELS];
+
+    beginEffect(effect);
+    memcpy(&redrawState, &state, sizeof(state));
+
+    for (uint16_t frame = 0; frame < RING_FRAMES_PER_MINUTE; frame += skip)
+    {
+        renderRingEffect<PIXELS>(effect, state, levels, frame, frame == 0);
+
+        // Anything left over in the levels shouldn't matter when redrawing
+        memset(redrawLevels, 0x5A, sizeof(redrawLevels));
+        renderRingEffect<PIXELS>(effect, redrawState, redrawLevels, frame, true);
+
+        if (memcmp(levels, redrawLevels, sizeof(levels)) != 0)
+        {
+            char message[64];
+            snprintf(message, sizeof(message), "%s, frame %u, skipping %u",
+                     ringEffectNames[effect], frame, skip);
+            TEST_FAIL_MESSAGE(message);
+        }
+    }
+}
+
+void test_incremental_frames_match_redrawn_frames()
+{
+    for (uint8_t effect = 0; effect < RING_EFFECT_COUNT; effect++)
+    {
+        checkIncrementalMatchesRedraw(effect, 1);
+
+        // Catching up skips a frame now and then
+        checkIncrementalMatchesRedraw(effect, 1 + RING_MAX_CATCHUP_FRAMES);
+    }
+}
+
+void test_wipe_ends_on_the_new_colour()
+{
+    beginEffect(RING_EFFECT_WIPE);
+    for (uint16_t frame = 0; frame < RING_FRAMES_PER_MINUTE; frame++)
+    {
+        WipeEffect<PIXELS>::render(state, levels, frame, frame == 0);
+    }
+
+    const uint16_t *newColour = state.schedule + (STEPS_PER_PIXEL * 3);
+    for (uint16_t pixel = 0; pixel < PIXELS; pixel++)
+    {
+        TEST_ASSERT_EQUAL_MEMORY(newColour, levels + (pixel * 3), RING_PIXEL_LEVEL_BYTES);
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_wipe_is_within_budget);
+    RUN_TEST(test_comet_is_within_budget);
+    RUN_TEST(test_breathing_is_within_budget);
+    RUN_TEST(test_gradient_is_within_budget);
+    RUN_TEST(test_incremental_frames_match_redrawn_frames);
+    RUN_TEST(test_wipe_ends_on_the_new_colour);
+    return UNITY_END();
+}
@@ -0,0 +1,145 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include "mock_led_driver.h"
+#include "ring_output.h"
+
+/*
+    RingOutput on one strip, against a driver that holds on to its buffer
+
+    The rule RingOutput has to keep is the one in led_driver.h: a buffer handed
+    to startTransmit() belongs to the driver until it isn't busy any more, so
+    the back buffer can never be the one on the wire.
+*/
+
+#define PIXELS 60
+
+static MockLedDriver driver;
+static RingOutput<PIXELS> *output = NULL;
+
+static void drawPixel(uint16_t pixel, uint8_t value)
+{
+    uint8_t *pixels = output->getPixels();
+    pixels[pixel * 3] = value;
+    pixels[pixel * 3 + 1] = value;
+    pixels[pixel * 3 + 2] = value;
+}
+
+void setUp()
+{
+    driver = MockLedDriver();
+    delete output;
+    output = new RingOutput<PIXELS>(driver);
+}
+
+void tearDown() {}
+
+void test_first_frame_always_goes_out()
+{
+    TEST_ASSERT_TRUE(output->show());
+    TEST_ASSERT_EQUAL_UINT32(1, driver.transmits);
+    TEST_ASSERT_EQUAL_UINT32(PIXELS * 3, driver.lastLength);
+    TEST_ASSERT_EQUAL_UINT32(1, output->getFramesPushed());
+}
+
+void test_sends_what_was_drawn()
+{
+    drawPixel(7, 200);
+    TEST_ASSERT_TRUE(output->show());
+    TEST_ASSERT_EQUAL_UINT8(200, driver.sent[7 * 3]);
+    TEST_ASSERT_EQUAL_UINT8(0, driver.sent[6 * 3]);
+}
+
+void test_unchanged_frames_are_skipped()
+{
+    drawPixel(0, 1);
+    TEST_ASSERT_TRUE(output->show());
+    TEST_ASSERT_FALSE(output->show());
+    TEST_ASSERT_FALSE(output->show());
+
+    TEST_ASSERT_EQUAL_UINT32(1, driver.transmits);
+    TEST_ASSERT_EQUAL_UINT32(2, output->getFramesSkipped());
+
+    // Setting a pixel to what it already was isn't a change either
+    drawPixel(0, 1);
+    TEST_ASSERT_FALSE(output->show());
+}
+
+void test_back_buffer_starts_as_the_last_frame()
+{
+    drawPixel(3, 50);
+    output->show();
+
+    // Only draw what changed, and the rest should still be there
+    drawPixel(4, 60);
+    output->show();
+
+    TEST_ASSERT_EQUAL_UINT8(50, driver.sent[3 * 3]);
+    TEST_ASSERT_EQUAL_UINT8(60, driver.sent[4 * 3]);
+    TEST_ASSERT_EQUAL_MEMORY(driver.sent, output->getPixels(), PIXELS * 3);
+}
+
+void test_back_buffer_is_never_the_one_on_the_wire()
+{
+    driver.holdTransmits = true;
+
+    for (uint16_t frame = 0; frame < 3 * PIXELS; frame++)
+    {
+        drawPixel(frame % PIXELS, (uint8_t)frame);
+        TEST_ASSERT_TRUE(output->show());
+
+        TEST_ASSERT_TRUE(driver.busy);
+        TEST_ASSERT_TRUE(output->getPixels() != driver.lastPixels);
+
+        // Let every other frame finish on its own before the next one
+        if (frame % 2 == 0)
+        {
+            driver.finish();
+        }
+    }
+
+    // The driver never got a transmit while it was busy, or it would have refused it
+    TEST_ASSERT_EQUAL_UINT32(3 * PIXELS, driver.transmits);
+}
+
+void test_waits_for_a_frame_still_on_the_wire()
+{
+    driver.holdTransmits = true;
+
+    drawPixel(0, 1);
+    output->show();
+    TEST_ASSERT_EQUAL_UINT32(0, output->getFramesWaited());
+
+    drawPixel(0, 2);
+    output->show();
+    TEST_ASSERT_EQUAL_UINT32(1, driver.waits);
+    TEST_ASSERT_EQUAL_UINT32(1, output->getFramesWaited());
+
+    // Once it's done on its own, there's nothing to wait for
+    driver.finish();
+    drawPixel(0, 3);
+    output->show();
+    TEST_ASSERT_EQUAL_UINT32(1, output->getFramesWaited());
+}
+
+void test_skipped_frames_dont_wait()
+{
+    driver.holdTransmits = true;
+
+    output->show();
+    TEST_ASSERT_FALSE(output->show());
+    TEST_ASSERT_EQUAL_UINT32(0, driver.waits);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_first_frame_always_goes_out);
+    RUN_TEST(test_sends_what_was_drawn);
+    RUN_TEST(test_unchanged_frames_are_skipped);
+    RUN_TEST(test_back_buffer_starts_as_the_last_frame);
+    RUN_TEST(test_back_buffer_is_never_the_one_on_the_wire);
+    RUN_TEST(test_waits_for_a_frame_still_on_the_wire);
+    RUN_TEST(test_skipped_frames_dont_wait);
+    return UNITY_END();
+}
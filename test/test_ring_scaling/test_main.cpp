@@ -0,0 +1,233 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include "bench.h"
+#include "mock_led_driver.h"
+#include "ring_effects.h"
+#include "ring_output.h"
+#include "temporal_dither.h"
+
+/*
+    How the ring's frame time grows with the number of pixels
+
+    This used to run on the clock every time it booted. It's here now so it
+    doesn't hold up the first frame, and so bigger rings can be tried out
+    before anyone solders them together.
+
+    Every effect draws a whole frame from scratch (the worst case), and then the
+    levels get turned into bytes and handed to mock strips. Times are per frame,
+    and they're from the host, so they're only good for comparing sizes with
+    each other.
+*/
+
+#define SCALING_RUNS 2000
+
+// Static, since the bigger rings would be a lot of stack
+template <uint16_t PIXELS>
+struct RingScratch
+{
+    static RingEffectState<PIXELS> state;
+    static uint16_t levels[PIXELS * 3];
+};
+
+template <uint16_t PIXELS>
+RingEffectState<PIXELS> RingScratch<PIXELS>::state;
+
+template <uint16_t PIXELS>
+uint16_t RingScratch<PIXELS>::levels[PIXELS * 3];
+
+void setUp() {}
+
+void tearDown() {}
+
+/**
+ * @brief Times a frame of every effect, and the conversion to bytes, with this many pixels
+ */
+template <uint16_t PIXELS>
+static void benchmarkRing()
+{
+    RingEffectState<PIXELS> &state = RingScratch<PIXELS>::state;
+    uint16_t *levels = RingScratch<PIXELS>::levels;
+    const uint16_t framesPerMinute = PIXELS * STEPS_PER_PIXEL;
+
+    state.oldHue = 1000;
+    state.newHue = 1000 + GOLDEN_RATIO_CONJUGATE;
+    state.saturation = 255;
+    state.brightness = 200;
+
+    char message[160];
+    for (uint8_t effect = 0; effect < RING_EFFECT_COUNT; effect++)
+    {
+        beginRingEffect<PIXELS>(effect, state);
+
+        BenchResult result = runBench(SCALING_RUNS, [&](uint32_t run) {
+            renderRingEffect<PIXELS>(effect, state, levels, (run * 7) % framesPerMinute, true);
+        });
+
+        snprintf(message, sizeof(message), "%u pixels, %s", PIXELS, ringEffectNames[effect]);
+        reportBench(message, result);
+    }
+
+    static uint8_t bytes[PIXELS * 3];
+    BenchResult convert = runBench(SCALING_RUNS, [&](uint32_t) {
+        TemporalDither<PIXELS * 3>::truncate(levels, bytes);
+    });
+    snprintf(message, sizeof(message), "%u pixels, convert", PIXELS);
+    reportBench(message, convert);
+}
+
+void test_benchmark_60_pixels()
+{
+    benchmarkRing<60>();
+}
+
+void test_benchmark_120_pixels()
+{
+    benchmarkRing<120>();
+}
+
+void test_benchmark_240_pixels()
+{
+    benchmarkRing<240>();
+}
+
+void test_benchmark_480_pixels()
+{
+    benchmarkRing<480>();
+}
+
+void test_frames_per_minute_fit_the_frame_counter()
+{
+    // The biggest ring above still has to count a minute of frames in a uint16_t
+    TEST_ASSERT_LESS_OR_EQUAL(65535, 480 * STEPS_PER_PIXEL);
+}
+
+/*
+    Multiple strips
+*/
+
+#define SPLIT_PIXELS 240
+
+static MockLedDriver drivers[4];
+
+static void resetDrivers()
+{
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        drivers[i] = MockLedDriver();
+    }
+}
+
+void test_strips_get_their_own_part_of_the_frame()
+{
+    resetDrivers();
+    const RingStrip layout[3] = {{&drivers[0], 60}, {&drivers[1], 100}, {&drivers[2], 80}};
+    static RingOutput<SPLIT_PIXELS, 3> output(layout);
+
+    uint8_t *pixels = output.getPixels();
+    for (uint16_t i = 0; i < SPLIT_PIXELS * 3; i++)
+    {
+        pixels[i] = (uint8_t)(i / 3);
+    }
+    TEST_ASSERT_TRUE(output.show());
+
+    TEST_ASSERT_EQUAL_UINT32(60 * 3, drivers[0].lastLength);
+    TEST_ASSERT_EQUAL_UINT32(100 * 3, drivers[1].lastLength);
+    TEST_ASSERT_EQUAL_UINT32(80 * 3, drivers[2].lastLength);
+
+    // Each strip starts where the one before it left off
+    TEST_ASSERT_EQUAL_UINT8(0, drivers[0].sent[0]);
+    TEST_ASSERT_EQUAL_UINT8(60, drivers[1].sent[0]);
+    TEST_ASSERT_EQUAL_UINT8(160, drivers[2].sent[0]);
+    TEST_ASSERT_EQUAL_UINT32(3, output.getStripsPushed());
+}
+
+void test_only_strips_that_changed_are_sent()
+{
+    resetDrivers();
+    const RingStrip layout[4] = {{&drivers[0], 60}, {&drivers[1], 60}, {&drivers[2], 60}, {&drivers[3], 60}};
+    static RingOutput<SPLIT_PIXELS, 4> output(layout);
+
+    // The first frame always goes to everything
+    TEST_ASSERT_TRUE(output.show());
+    TEST_ASSERT_EQUAL_UINT32(4, output.getStripsPushed());
+
+    // A pixel on the third strip
+    output.getPixels()[130 * 3] = 42;
+    TEST_ASSERT_TRUE(output.show());
+    TEST_ASSERT_EQUAL_UINT32(5, output.getStripsPushed());
+    TEST_ASSERT_EQUAL_UINT32(1, drivers[0].transmits);
+    TEST_ASSERT_EQUAL_UINT32(2, drivers[2].transmits);
+
+    // Nothing at all
+    TEST_ASSERT_FALSE(output.show());
+    TEST_ASSERT_EQUAL_UINT32(1, output.getFramesSkipped());
+    TEST_ASSERT_EQUAL_UINT32(5, output.getStripsPushed());
+}
+
+void test_strips_that_are_still_busy_are_waited_for()
+{
+    resetDrivers();
+    const RingStrip layout[2] = {{&drivers[0], 120}, {&drivers[1], 120}};
+    static RingOutput<SPLIT_PIXELS, 2> output(layout);
+
+    drivers[0].holdTransmits = true;
+    drivers[1].holdTransmits = true;
+    TEST_ASSERT_TRUE(output.show());
+    TEST_ASSERT_TRUE(drivers[0].busy && drivers[1].busy);
+
+    // Only the first strip changes, but the second one is still sending the
+    // buffer that's now the back one, so it has to be waited on too
+    output.getPixels()[0] = 1;
+    TEST_ASSERT_TRUE(output.show());
+    TEST_ASSERT_EQUAL_UINT32(1, drivers[0].waits);
+    TEST_ASSERT_EQUAL_UINT32(1, drivers[1].waits);
+    TEST_ASSERT_EQUAL_UINT32(2, output.getFramesWaited());
+    TEST_ASSERT_EQUAL_UINT32(1, drivers[1].transmits);
+}
+
+void test_benchmark_show_over_strips()
+{
+    char message[96];
+
+    resetDrivers();
+    static RingOutput<480, 1> one(drivers[0]);
+    const RingStrip four[4] = {{&drivers[0], 120}, {&drivers[1], 120}, {&drivers[2], 120}, {&drivers[3], 120}};
+    static RingOutput<480, 4> split(four);
+
+    // Change one pixel a frame, so a split ring only sends one strip
+    BenchResult oneStrip = runBench(SCALING_RUNS, [&](uint32_t run) {
+        one.getPixels()[(run % 480) * 3]++;
+        one.show();
+    });
+    BenchResult fourStrips = runBench(SCALING_RUNS, [&](uint32_t run) {
+        split.getPixels()[(run % 480) * 3]++;
+        split.show();
+    });
+
+    reportBench("480 pixels on 1 strip, show", oneStrip);
+    reportBench("480 pixels on 4 strips, show", fourStrips);
+
+    snprintf(message, sizeof(message), "bytes on the wire per frame: 1 strip %u, 4 strips %u",
+             (unsigned)(one.getStripsPushed() * 480 * 3 / one.getFramesPushed()),
+             (unsigned)(split.getStripsPushed() * 120 * 3 / split.getFramesPushed()));
+    TEST_MESSAGE(message);
+
+    // After the first frame (which goes to all of them), one strip per frame
+    TEST_ASSERT_EQUAL_UINT32(split.getFramesPushed() + 3, split.getStripsPushed());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_benchmark_60_pixels);
+    RUN_TEST(test_benchmark_120_pixels);
+    RUN_TEST(test_benchmark_240_pixels);
+    RUN_TEST(test_benchmark_480_pixels);
+    RUN_TEST(test_frames_per_minute_fit_the_frame_counter);
+    RUN_TEST(test_strips_get_their_own_part_of_the_frame);
+    RUN_TEST(test_only_strips_that_changed_are_sent);
+    RUN_TEST(test_strips_that_are_still_busy_are_waited_for);
+    RUN_TEST(test_benchmark_show_over_strips);
+    return UNITY_END();
+}
@@ -0,0 +1,253 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include "driver/rmt.h"
+
+#include "clock_config.h"
+#include "color.h"
+#include "seconds_ring.h"
+
+/*
+    secondRingTask, for real, on the host's scheduler
+
+    The ring is the only task. The test plays showTimeTask, sending the minute
+    signal, and looks at what went out to the RMT channel. Time only moves
+    when the ring is waiting for it, so a whole minute takes a moment.
+*/
+
+// A minute edge a while after the epoch, so the fleet's minutes make sense
+#define TEST_MINUTE 28000000L
+
+extern TaskHandle_t secondRingTaskHandle;
+extern uint16_t colorNumber;
+
+static ClockConfig defaultConfig;
+
+// While this is set, hogTask takes 10ms of every 20
+static volatile bool hogging;
+
+/**
+ * @brief Something else on the ring's core that keeps it from waking up on time
+ */
+static portTASK_FUNCTION(hogTask, pvParameters)
+{
+    for (;;)
+    {
+        vTaskDelay(pdMS_TO_TICKS(20));
+        if (hogging)
+        {
+            nativeAdvanceMs(10);
+        }
+    }
+}
+
+static void setWallClock(int64_t seconds, int64_t extraUs)
+{
+    nativeSetWallClockUs(seconds * 1000000LL + extraUs);
+}
+
+static void startRing()
+{
+    xTaskCreatePinnedToCore(secondRingTask, "secondRingTask", 4096, NULL, 1, &secondRingTaskHandle, 1);
+
+    // Let it get set up and start waiting for the signal
+    nativeRunFor(100);
+}
+
+static void signalMinute(uint32_t minute)
+{
+    xTaskNotify(secondRingTaskHandle, minute * 60, eSetValueWithOverwrite);
+}
+
+/**
+ * @brief Checks that the last thing sent out is the whole ring in one hue
+ */
+static void checkRingIsFilled(uint16_t hue)
+{
+    ClockConfig config;
+    getClockConfig(config);
+
+    static uint8_t expected[NUMBER_OF_PIXELS * 3];
+    fillHsv<NUMBER_OF_PIXELS, LED_RING_TYPE>(expected, hue, config.pixelSaturation, config.pixelBrightness);
+
+    NativeRmtChannel &rmt = nativeRmtChannel(LED_RING_RMT_CHANNEL);
+    TEST_ASSERT_EQUAL_UINT32(NUMBER_OF_PIXELS * 3, rmt.sample.size());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, rmt.sample.data(), NUMBER_OF_PIXELS * 3);
+
+    // Every bit of every byte is an RMT item
+    TEST_ASSERT_EQUAL_UINT32(NUMBER_OF_PIXELS * 3 * 8, rmt.items.size());
+}
+
+static void turnOnHighFrameRate()
+{
+    ClockConfig config = defaultConfig;
+    config.ringDither = true;
+    setClockConfig(config);
+}
+
+void setUp()
+{
+    setClockConfig(defaultConfig);
+    ringPhaseHistogram.reset();
+    nativeRmtChannel(LED_RING_RMT_CHANNEL).writeUs = 0;
+    hogging = false;
+}
+
+void tearDown()
+{
+    nativeStopTasks();
+}
+
+void test_waits_for_the_minute_signal()
+{
+    setWallClock(TEST_MINUTE * 60, 0);
+    uint32_t framesBefore = ringFrameStats.getFrames();
+
+    startRing();
+    nativeRunFor(5000);
+
+    // Nothing but the fill with the old hue went out
+    TEST_ASSERT_EQUAL_UINT32(framesBefore, ringFrameStats.getFrames());
+    TEST_ASSERT_TRUE(nativeRmtChannel(LED_RING_RMT_CHANNEL).writes > 0);
+    checkRingIsFilled(colorNumber);
+}
+
+void test_a_minute_is_every_frame_on_time()
+{
+    setWallClock(TEST_MINUTE * 60, 0);
+    startRing();
+
+    setWallClock(TEST_MINUTE * 60, 0);
+    uint32_t framesBefore = ringFrameStats.getFrames();
+    signalMinute(TEST_MINUTE);
+    nativeRunFor(60000 + 100);
+
+    TEST_ASSERT_EQUAL_UINT32(RING_FRAMES_PER_MINUTE, ringFrameStats.getFrames() - framesBefore);
+
+    // Every frame went out within 2ms of when it was due
+    TEST_ASSERT_EQUAL_UINT32(RING_FRAMES_PER_MINUTE, ringPhaseHistogram.getSamples());
+    TEST_ASSERT_EQUAL_UINT32(RING_FRAMES_PER_MINUTE, ringPhaseHistogram.getCount(RING_PHASE_BUCKETS / 2));
+
+    // The fade ends right on the new hue
+    checkRingIsFilled(colorNumber);
+}
+
+void test_catches_up_after_a_late_signal()
+{
+    setWallClock(TEST_MINUTE * 60, 0);
+    startRing();
+
+    // The signal shows up half a second (20 frames) after the minute
+    setWallClock(TEST_MINUTE * 60, 500000);
+    uint32_t framesBefore = ringFrameStats.getFrames();
+    signalMinute(TEST_MINUTE);
+
+    // After a couple of seconds it should be back on time
+    nativeRunFor(2000);
+    ringPhaseHistogram.reset();
+    nativeRunFor(60000 - 2500 - 50);
+
+    TEST_ASSERT_EQUAL_UINT32(ringPhaseHistogram.getSamples(), ringPhaseHistogram.getCount(RING_PHASE_BUCKETS / 2));
+
+    /*
+        It caught up by skipping every other frame, so about 10 of the 20 it was
+        behind never went out. It still got done at the top of the minute.
+    */
+    nativeRunFor(100);
+    uint32_t frames = ringFrameStats.getFrames() - framesBefore;
+    TEST_ASSERT_UINT32_WITHIN(2, RING_FRAMES_PER_MINUTE - 10, frames);
+    checkRingIsFilled(colorNumber);
+}
+
+void test_high_frame_rate_runs_when_it_keeps_up()
+{
+    turnOnHighFrameRate();
+    setWallClock(TEST_MINUTE * 60, 0);
+    startRing();
+
+    uint32_t fallbacks = ringDitherStats.fallbacks;
+    uint32_t framesBefore = ringFrameStats.getFrames();
+    signalMinute(TEST_MINUTE);
+    nativeRunFor(60000 + 100);
+
+    TEST_ASSERT_TRUE(ringDitherStats.active);
+    TEST_ASSERT_EQUAL_UINT32(fallbacks, ringDitherStats.fallbacks);
+
+    // Four ticks a frame (give or take a few the host was late for and skipped)
+    TEST_ASSERT_UINT32_WITHIN(4 * RING_DITHER_TICKS_PER_FRAME, RING_FRAMES_PER_MINUTE * RING_DITHER_TICKS_PER_FRAME,
+                              ringFrameStats.getFrames() - framesBefore);
+    TEST_ASSERT_EQUAL_UINT32(RING_FRAME_PERIOD_US / RING_DITHER_TICKS_PER_FRAME, ringFrameStats.getDeadlineUs());
+}
+
+void test_high_frame_rate_falls_back_when_too_busy()
+{
+    turnOnHighFrameRate();
+    setWallClock(TEST_MINUTE * 60, 0);
+    startRing();
+
+    // Half of every tick goes to sending the frame, which is more than its share
+    nativeRmtChannel(LED_RING_RMT_CHANNEL).writeUs = RING_FRAME_PERIOD_US / RING_DITHER_TICKS_PER_FRAME / 2;
+
+    uint32_t fallbacks = ringDitherStats.fallbacks;
+    signalMinute(TEST_MINUTE);
+    nativeRunFor(1500);
+
+    TEST_ASSERT_FALSE(ringDitherStats.active);
+    TEST_ASSERT_EQUAL_UINT32(fallbacks + 1, ringDitherStats.fallbacks);
+    TEST_ASSERT_TRUE(ringDitherStats.lastBusyPercent > RING_DITHER_CPU_BUDGET_PERCENT);
+    TEST_ASSERT_EQUAL_UINT32(RING_FRAME_PERIOD_US, ringFrameStats.getDeadlineUs());
+
+    // It carries on at the normal rate and still finishes the minute on time
+    nativeRmtChannel(LED_RING_RMT_CHANNEL).writeUs = 0;
+    nativeRunFor(60000 - 1500 + 100);
+    checkRingIsFilled(colorNumber);
+}
+
+void test_high_frame_rate_falls_back_when_late_and_backs_off()
+{
+    turnOnHighFrameRate();
+    setWallClock(TEST_MINUTE * 60, 0);
+    startRing();
+    xTaskCreatePinnedToCore(hogTask, "hogTask", 4096, NULL, 1, NULL, 1);
+
+    // The ring isn't busy itself, it just keeps waking up late
+    hogging = true;
+    uint32_t fallbacks = ringDitherStats.fallbacks;
+    signalMinute(TEST_MINUTE);
+    nativeRunFor(1500);
+
+    TEST_ASSERT_FALSE(ringDitherStats.active);
+    TEST_ASSERT_EQUAL_UINT32(fallbacks + 1, ringDitherStats.fallbacks);
+    TEST_ASSERT_TRUE(ringDitherStats.lastBusyPercent <= RING_DITHER_CPU_BUDGET_PERCENT);
+
+    hogging = false;
+    nativeRunFor(60000 - 1500);
+
+    // It waits out the backoff at the normal rate, even though nothing's wrong any more
+    for (uint8_t minute = 1; minute <= RING_DITHER_BACKOFF_MINUTES; minute++)
+    {
+        signalMinute(TEST_MINUTE + minute);
+        nativeRunFor(60000);
+        TEST_ASSERT_FALSE(ringDitherStats.active);
+    }
+
+    // Then tries again
+    signalMinute(TEST_MINUTE + RING_DITHER_BACKOFF_MINUTES + 1);
+    nativeRunFor(1500);
+    TEST_ASSERT_TRUE(ringDitherStats.active);
+    TEST_ASSERT_EQUAL_UINT32(fallbacks + 1, ringDitherStats.fallbacks);
+}
+
+int main()
+{
+    getClockConfig(defaultConfig);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_waits_for_the_minute_signal);
+    RUN_TEST(test_a_minute_is_every_frame_on_time);
+    RUN_TEST(test_catches_up_after_a_late_signal);
+    RUN_TEST(test_high_frame_rate_runs_when_it_keeps_up);
+    RUN_TEST(test_high_frame_rate_falls_back_when_too_busy);
+    RUN_TEST(test_high_frame_rate_falls_back_when_late_and_backs_off);
+    return UNITY_END();
+}
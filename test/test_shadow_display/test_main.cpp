@@ -0,0 +1,88 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include "shadow_display.h"
+
+void setUp() {}
+void tearDown() {}
+
+void test_first_write_sends_everything()
+{
+    ShadowDisplay display;
+    display.print(1234);
+    display.getBus().reset();
+
+    display.writeDisplay();
+
+    TEST_ASSERT_EQUAL_UINT32(1, display.getBus().writes);
+    TEST_ASSERT_EQUAL_UINT32(SHADOW_DISPLAY_RAM_SIZE + 1, display.getBus().lastLength);
+    TEST_ASSERT_EQUAL_UINT8(0, display.getBus().last[0]);
+}
+
+void test_unchanged_frame_is_not_sent()
+{
+    ShadowDisplay display;
+    display.print(1234);
+    display.writeDisplay();
+    display.getBus().reset();
+
+    display.print(1234);
+    display.writeDisplay();
+
+    TEST_ASSERT_EQUAL_UINT32(0, display.getBus().writes);
+    TEST_ASSERT_EQUAL_UINT32(1, display.getTransactionsAvoided());
+}
+
+void test_only_the_changed_run_is_sent()
+{
+    ShadowDisplay display;
+    display.print(1234);
+    display.writeDisplay();
+    display.getBus().reset();
+
+    // Only the last digit (position 4, bytes 8 and 9 of the RAM) changes
+    display.print(1235);
+    display.writeDisplay();
+
+    TEST_ASSERT_EQUAL_UINT32(1, display.getBus().writes);
+    TEST_ASSERT_EQUAL_UINT8(8, display.getBus().last[0]);
+    TEST_ASSERT_EQUAL_UINT32(2, display.getBus().lastLength);
+}
+
+void test_brightness_is_only_sent_when_it_changes()
+{
+    ShadowDisplay display;
+    display.getBus().reset();
+
+    display.setBrightness(5);
+    display.setBrightness(5);
+    display.setBrightness(99);
+
+    // The second one was a repeat, and 99 gets clamped to 15
+    TEST_ASSERT_EQUAL_UINT32(2, display.getBus().writes);
+    TEST_ASSERT_EQUAL_UINT8(0xE0 | 15, display.getBus().last[0]);
+}
+
+void test_invalidate_sends_everything_again()
+{
+    ShadowDisplay display;
+    display.print(1234);
+    display.writeDisplay();
+    display.getBus().reset();
+
+    display.invalidate();
+    display.writeDisplay();
+
+    TEST_ASSERT_EQUAL_UINT32(SHADOW_DISPLAY_RAM_SIZE + 1, display.getBus().lastLength);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_first_write_sends_everything);
+    RUN_TEST(test_unchanged_frame_is_not_sent);
+    RUN_TEST(test_only_the_changed_run_is_sent);
+    RUN_TEST(test_brightness_is_only_sent_when_it_changes);
+    RUN_TEST(test_invalidate_sends_everything_again);
+    return UNITY_END();
+}
@@ -0,0 +1,234 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include "civil_time.h"
+#include "clock_config.h"
+#include "clock_face.h"
+#include "show_time.h"
+
+/*
+    showTimeTask, for real, on the host's scheduler
+
+    A little task stands in for the second ring and writes down every minute
+    signal it gets, and when. Time only moves when both tasks are waiting for
+    it, so the test can run through a few minutes at once.
+*/
+
+// A minute edge a while after the epoch
+#define TEST_MINUTE 28000000L
+
+// How late the minute signal is allowed to be (MINUTE_SIGNAL_LATE_US in show_time.cpp)
+#define TEST_SIGNAL_LATE_US 5000
+
+#define MAX_SIGNALS 8
+
+extern TaskHandle_t secondRingTaskHandle;
+
+static ClockConfig defaultConfig;
+
+static uint32_t signalValues[MAX_SIGNALS];
+static int64_t signalTimesUs[MAX_SIGNALS];
+static uint8_t signalCount;
+
+static portTASK_FUNCTION(signalRecorderTask, pvParameters)
+{
+    for (;;)
+    {
+        uint32_t value;
+        xTaskNotifyWait(0x00, UINT32_MAX, &value, portMAX_DELAY);
+        if (signalCount < MAX_SIGNALS)
+        {
+            signalValues[signalCount] = value;
+            signalTimesUs[signalCount] = nativeWallClockUs();
+            signalCount++;
+        }
+    }
+}
+
+static void startTasks(int64_t wallClockUs)
+{
+    nativeSetWallClockUs(wallClockUs);
+    xTaskCreatePinnedToCore(signalRecorderTask, "signalRecorderTask", 4096, NULL, 1, &secondRingTaskHandle, 1);
+    xTaskCreatePinnedToCore(showTimeTask, "showTimeTask", 4096, NULL, 1, &showTimeTaskHandler, 1);
+}
+
+/**
+ * @brief Checks that the display is showing what the clock face says it should right now
+ */
+static void checkDisplayShowsNow()
+{
+    ClockConfig config;
+    getClockConfig(config);
+
+    time_t now = nativeWallClockUs() / 1000000LL;
+    CivilTime local = toCivilTime(now);
+    ClockFace face = makeClockFace(local.hour, local.minute, local.second, config.blinkColon);
+
+    Adafruit_7segment expected;
+    expected.print(face.time);
+    expected.writeDigitRaw(2, face.colonSegments);
+
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(expected.displaybuffer, display.displaybuffer, 5);
+}
+
+void setUp()
+{
+    setClockConfig(defaultConfig);
+    display.clear();
+    signalCount = 0;
+    memset(&minuteSignalStats, 0, sizeof(minuteSignalStats));
+}
+
+void tearDown()
+{
+    nativeStopTasks();
+    secondRingTaskHandle = NULL;
+    showTimeTaskHandler = NULL;
+}
+
+void test_signals_the_ring_on_every_minute()
+{
+    startTasks(TEST_MINUTE * 60 * 1000000LL - 2500000LL);
+    nativeRunFor(3 * 60 * 1000);
+
+    TEST_ASSERT_EQUAL_UINT8(3, signalCount);
+    TEST_ASSERT_EQUAL_UINT32(3, minuteSignalStats.signals);
+
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        // The ring gets told which minute just started, right as it starts
+        int64_t edgeUs = (TEST_MINUTE + i) * 60 * 1000000LL;
+        TEST_ASSERT_EQUAL_UINT32((TEST_MINUTE + i) * 60, signalValues[i]);
+        TEST_ASSERT_TRUE(signalTimesUs[i] >= edgeUs);
+        TEST_ASSERT_TRUE(signalTimesUs[i] - edgeUs < TEST_SIGNAL_LATE_US);
+    }
+    TEST_ASSERT_TRUE(minuteSignalStats.maxLatencyUs >= 0);
+    TEST_ASSERT_TRUE(minuteSignalStats.maxLatencyUs < TEST_SIGNAL_LATE_US);
+
+    checkDisplayShowsNow();
+}
+
+void test_redraws_on_every_second_when_blinking()
+{
+    startTasks(TEST_MINUTE * 60 * 1000000LL + 100000LL);
+    nativeRunFor(10);
+    uint32_t framesBefore = displayFrameStats.getFrames();
+
+    // One redraw for every colon blink, all on time
+    nativeRunFor(10 * 1000);
+    TEST_ASSERT_EQUAL_UINT32(10, displayFrameStats.getFrames() - framesBefore);
+    checkDisplayShowsNow();
+}
+
+void test_a_notify_redraws_right_away()
+{
+    ClockConfig config = defaultConfig;
+    config.blinkColon = false;
+    setClockConfig(config);
+
+    // Without the blinking colon, nothing should happen until the next minute
+    startTasks(TEST_MINUTE * 60 * 1000000LL + 5000000LL);
+    nativeRunFor(10);
+    uint32_t framesBefore = displayFrameStats.getFrames();
+    nativeRunFor(10 * 1000);
+    TEST_ASSERT_EQUAL_UINT32(framesBefore, displayFrameStats.getFrames());
+
+    // A config change wakes it up
+    config.blinkColon = true;
+    setClockConfig(config);
+    xTaskNotifyGive(showTimeTaskHandler);
+    nativeRunFor(1);
+
+    TEST_ASSERT_EQUAL_UINT32(framesBefore + 1, displayFrameStats.getFrames());
+    checkDisplayShowsNow();
+}
+
+void test_the_ring_waits_while_the_display_is_off()
+{
+    ClockConfig config = defaultConfig;
+    config.displayOn = false;
+    setClockConfig(config);
+
+    // Two minutes go by with the display off, and the ring hears nothing
+    startTasks(TEST_MINUTE * 60 * 1000000LL - 2500000LL);
+    nativeRunFor(2 * 60 * 1000);
+    TEST_ASSERT_EQUAL_UINT8(0, signalCount);
+
+    Adafruit_7segment blank;
+    blank.print("");
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(blank.displaybuffer, display.displaybuffer, 5);
+
+    // Back on about halfway through a minute, and the ring gets told about that minute right away
+    nativeRunFor(30 * 1000);
+    config.displayOn = true;
+    setClockConfig(config);
+    xTaskNotifyGive(showTimeTaskHandler);
+    nativeRunFor(1);
+
+    TEST_ASSERT_EQUAL_UINT8(1, signalCount);
+    TEST_ASSERT_EQUAL_UINT32((TEST_MINUTE + 2) * 60, signalValues[0]);
+    checkDisplayShowsNow();
+
+    // That one was a catch up, not a late edge, so it's not in the stats
+    TEST_ASSERT_EQUAL_UINT32(0, minuteSignalStats.signals);
+
+    // And the next minute is back to normal
+    nativeRunFor(35 * 1000);
+    TEST_ASSERT_EQUAL_UINT8(2, signalCount);
+    TEST_ASSERT_EQUAL_UINT32((TEST_MINUTE + 3) * 60, signalValues[1]);
+    TEST_ASSERT_EQUAL_UINT32(1, minuteSignalStats.signals);
+    TEST_ASSERT_TRUE(minuteSignalStats.maxLatencyUs < TEST_SIGNAL_LATE_US);
+}
+
+/**
+ * @brief Checks that the display is showing one number of an IP address
+ */
+static void checkDisplayShows(int number)
+{
+    Adafruit_7segment expected;
+    expected.print(number);
+    expected.writeDigitRaw(2, 0);
+
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(expected.displaybuffer, display.displaybuffer, 5);
+}
+
+void test_showing_the_ip_address_does_not_hold_up_the_minute()
+{
+    // 3 seconds before the minute, so the edge lands in the middle of the IP address
+    startTasks(TEST_MINUTE * 60 * 1000000LL - 3000000LL);
+    nativeRunFor(10);
+
+    showIpAddress(IPAddress(192, 168, 1, 42));
+    nativeRunFor(10);
+    checkDisplayShows(192);
+
+    nativeRunFor(1500);
+    checkDisplayShows(168);
+
+    // Past the minute, and the ring heard about it right on time
+    nativeRunFor(1500 + 100);
+    checkDisplayShows(1);
+    TEST_ASSERT_EQUAL_UINT8(1, signalCount);
+    TEST_ASSERT_EQUAL_UINT32(TEST_MINUTE * 60, signalValues[0]);
+    TEST_ASSERT_TRUE(signalTimesUs[0] - TEST_MINUTE * 60 * 1000000LL < TEST_SIGNAL_LATE_US);
+
+    nativeRunFor(1500);
+    checkDisplayShows(42);
+
+    // Then it goes back to the time
+    nativeRunFor(1500);
+    checkDisplayShowsNow();
+}
+
+int main()
+{
+    getClockConfig(defaultConfig);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_signals_the_ring_on_every_minute);
+    RUN_TEST(test_redraws_on_every_second_when_blinking);
+    RUN_TEST(test_a_notify_redraws_right_away);
+    RUN_TEST(test_the_ring_waits_while_the_display_is_off);
+    RUN_TEST(test_showing_the_ip_address_does_not_hold_up_the_minute);
+    return UNITY_END();
+}
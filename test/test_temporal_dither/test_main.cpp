@@ -0,0 +1,142 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include "temporal_dither.h"
+
+/*
+    TemporalDither's error diffusion
+
+    Whatever gets rounded off one tick is carried into the next, so over N
+    ticks the bytes that went out add up to the 8.8 level times N, give or take
+    the fraction still being carried. Every tick is one of the two bytes either
+    side of the level.
+*/
+
+#define CHANNELS 6
+#define TICKS 256
+
+static TemporalDither<CHANNELS> ditherer;
+static uint8_t out[CHANNELS];
+
+void setUp()
+{
+    ditherer.reset();
+    memset(out, 0, sizeof(out));
+}
+
+void tearDown() {}
+
+/**
+ * @brief Dithers the same levels for a while and checks the average and every tick
+ */
+static void checkAverages(const uint16_t *levels, uint16_t ticks)
+{
+    uint32_t sums[CHANNELS] = {0};
+
+    for (uint16_t tick = 0; tick < ticks; tick++)
+    {
+        ditherer.render(levels, out);
+        for (uint8_t i = 0; i < CHANNELS; i++)
+        {
+            // Never more than a step away from the level
+            uint8_t below = levels[i] >> 8;
+            uint8_t above = levels[i] >= 0xFF00 ? 0xFF : below + 1;
+            TEST_ASSERT_TRUE(out[i] == below || out[i] == above);
+
+            sums[i] += out[i];
+        }
+    }
+
+    for (uint8_t i = 0; i < CHANNELS; i++)
+    {
+        // What went out, in 8.8, is what was asked for less what's still carried (under one step)
+        uint32_t wanted = (uint32_t)levels[i] * ticks;
+        uint32_t sent = sums[i] << 8;
+        if (levels[i] >= 0xFF00)
+        {
+            TEST_ASSERT_EQUAL_UINT32(0xFF * ticks, sums[i]);
+        }
+        else
+        {
+            TEST_ASSERT_TRUE(sent <= wanted);
+            TEST_ASSERT_TRUE(wanted - sent < 0x100);
+        }
+    }
+}
+
+void test_whole_levels_dont_flicker()
+{
+    const uint16_t levels[CHANNELS] = {0x0000, 0x0100, 0x0500, 0x1000, 0x8000, 0xFE00};
+    checkAverages(levels, TICKS);
+}
+
+void test_fractions_average_out()
+{
+    // Half, a quarter, three quarters, the smallest step, and a bit under a whole one
+    const uint16_t levels[CHANNELS] = {0x0080, 0x0140, 0x02C0, 0x0001, 0x03FF, 0x7F55};
+    checkAverages(levels, TICKS);
+
+    // And over a short run, too
+    ditherer.reset();
+    checkAverages(levels, 4);
+}
+
+void test_half_a_step_alternates()
+{
+    const uint16_t levels[CHANNELS] = {0x0280, 0x0280, 0x0280, 0x0280, 0x0280, 0x0280};
+
+    ditherer.render(levels, out);
+    TEST_ASSERT_EQUAL_UINT8(2, out[0]);
+    ditherer.render(levels, out);
+    TEST_ASSERT_EQUAL_UINT8(3, out[0]);
+    ditherer.render(levels, out);
+    TEST_ASSERT_EQUAL_UINT8(2, out[0]);
+}
+
+void test_full_on_does_not_carry()
+{
+    const uint16_t levels[CHANNELS] = {0xFF00, 0xFF80, 0xFFFF, 0xFFFF, 0xFF01, 0xFF00};
+    checkAverages(levels, TICKS);
+
+    // Nothing got carried, so dropping down to a whole level doesn't overshoot it
+    const uint16_t lower[CHANNELS] = {0x1000, 0x1000, 0x1000, 0x1000, 0x1000, 0x1000};
+    ditherer.render(lower, out);
+    for (uint8_t i = 0; i < CHANNELS; i++)
+    {
+        TEST_ASSERT_EQUAL_UINT8(0x10, out[i]);
+    }
+}
+
+void test_reset_forgets_the_error()
+{
+    const uint16_t levels[CHANNELS] = {0x00C0, 0x00C0, 0x00C0, 0x00C0, 0x00C0, 0x00C0};
+
+    // After one tick there's 0xC0 carried, so the next one would round up
+    ditherer.render(levels, out);
+    TEST_ASSERT_EQUAL_UINT8(0, out[0]);
+
+    ditherer.reset();
+    ditherer.render(levels, out);
+    TEST_ASSERT_EQUAL_UINT8(0, out[0]);
+}
+
+void test_truncate_drops_the_fractions()
+{
+    const uint16_t levels[CHANNELS] = {0x00FF, 0x0180, 0x02FF, 0xFF00, 0xFFFF, 0x0000};
+    TemporalDither<CHANNELS>::truncate(levels, out);
+
+    const uint8_t expected[CHANNELS] = {0x00, 0x01, 0x02, 0xFF, 0xFF, 0x00};
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, out, CHANNELS);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_whole_levels_dont_flicker);
+    RUN_TEST(test_fractions_average_out);
+    RUN_TEST(test_half_a_step_alternates);
+    RUN_TEST(test_full_on_does_not_carry);
+    RUN_TEST(test_reset_forgets_the_error);
+    RUN_TEST(test_truncate_drops_the_fractions);
+    return UNITY_END();
+}